@@ -0,0 +1,43 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   HostFileUtil.cpp
+ *
+ *   @brief  POSIX file helpers shared by the host-only storage classes.
+ *
+ ****************************************************************************/
+
+#include "HostFileUtil.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstring>
+
+bool bioloid::syncDirectory(const char* fileName) {
+    char dirName[256];
+    const char* slash = strrchr(fileName, '/');
+    if (slash == nullptr) {
+        strcpy(dirName, ".");
+    } else if (static_cast<size_t>(slash - fileName) < sizeof(dirName)) {
+        size_t len = slash == fileName ? 1 : slash - fileName;
+        memcpy(dirName, fileName, len);
+        dirName[len] = '\0';
+    } else {
+        return false;
+    }
+    int fd = open(dirName, O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        return false;
+    }
+    bool synced = fsync(fd) == 0;
+    close(fd);
+    return synced;
+}
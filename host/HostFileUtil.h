@@ -0,0 +1,31 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   HostFileUtil.h
+ *
+ *   @brief  POSIX file helpers shared by the host-only storage classes.
+ *
+ ****************************************************************************/
+
+#pragma once
+
+//! @addtogroup bioloid
+//! @{
+
+namespace bioloid {
+
+//! @brief Flushes the directory containing a file, so that renaming the file is durable.
+//! @returns true if the directory was flushed.
+bool syncDirectory(const char* fileName  //!< [in] File whose directory should be flushed.
+);
+
+}  // namespace bioloid
+
+//! @}
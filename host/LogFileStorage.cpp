@@ -0,0 +1,201 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   LogFileStorage.cpp
+ *
+ *   @brief  Log-structured control table storage, which only ever appends to its file.
+ *
+ ****************************************************************************/
+
+#include "LogFileStorage.h"
+
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+
+#include "Crc32.h"
+#include "HostFileUtil.h"
+#include "StorageUtil.h"
+
+bioloid::LogFileStorage::LogFileStorage(
+    const char* fileName,
+    SizeType numPersistentBytes,
+    uint8_t* image,
+    size_t compactThreshold)
+    : m_fileName{fileName},
+      m_numPersistentBytes{numPersistentBytes},
+      m_image{image},
+      m_compactThreshold{compactThreshold} {
+    assert(this->m_fileName != nullptr);
+    assert(this->m_image != nullptr);
+    assert(this->m_numPersistentBytes <= BIOLOID_CTL_MAX_PERSISTENT_BYTES);
+    int len = snprintf(this->m_tempName, sizeof(this->m_tempName), "%s.tmp", fileName);
+    assert(len > 0 && static_cast<size_t>(len) < sizeof(this->m_tempName));
+    (void)len;
+}
+
+bioloid::IControlTableStorage::Error bioloid::LogFileStorage::replay() {
+    this->close();
+    FILE* fs = fopen(this->m_fileName, "rb");
+    if (fs == nullptr) {
+        return Error::FAILED;
+    }
+    uint8_t header[RECORD_HEADER_BYTES];
+    uint8_t data[BIOLOID_CTL_MAX_PERSISTENT_BYTES];
+    uint8_t crc[RECORD_CRC_BYTES];
+    size_t validBytes = 0;
+    while (fread(header, sizeof(header), 1, fs) == 1) {
+        size_t offset = getLE(&header[0], 2);
+        size_t numBytes = getLE(&header[2], 2);
+        bool first = validBytes == 0;
+        if (numBytes == 0 || offset + numBytes > this->m_numPersistentBytes ||
+            (first && numBytes != this->m_numPersistentBytes) ||
+            fread(data, numBytes, 1, fs) != 1 || fread(crc, sizeof(crc), 1, fs) != 1 ||
+            getLE(crc, sizeof(crc)) != crc32(data, numBytes, crc32(header, sizeof(header)))) {
+            break;
+        }
+        memcpy(&this->m_image[offset], data, numBytes);
+        validBytes += sizeof(header) + numBytes + sizeof(crc);
+    }
+    fclose(fs);
+    if (validBytes == 0) {
+        return Error::FAILED;
+    }
+
+    // Discard anything following the last valid record, so that new records aren't
+    // appended after a torn one.
+    if (truncate(this->m_fileName, static_cast<off_t>(validBytes)) != 0) {
+        return Error::FAILED;
+    }
+    this->m_logBytes = validBytes;
+    this->m_loaded = true;
+    return Error::NONE;
+}
+
+bioloid::IControlTableStorage::Error
+bioloid::LogFileStorage::load(OffsetType offset, SizeType numBytes, void* data) {
+    if (offset + numBytes > this->m_numPersistentBytes) {
+        return Error::FAILED;
+    }
+    if (!this->m_loaded && this->replay() != Error::NONE) {
+        return Error::FAILED;
+    }
+    memcpy(data, &this->m_image[offset], numBytes);
+    return Error::NONE;
+}
+
+bioloid::IControlTableStorage::Error
+bioloid::LogFileStorage::save(OffsetType offset, SizeType numBytes, const void* data) {
+    if (numBytes == 0 || offset + numBytes > this->m_numPersistentBytes) {
+        return Error::FAILED;
+    }
+    memcpy(&this->m_image[offset], data, numBytes);
+    this->m_stats.bytesSaved += numBytes;
+
+    // If the log doesn't contain a complete image yet, then the first record needs to
+    // contain all of the persistent bytes.
+    if (!this->m_loaded || this->m_logBytes == 0) {
+        return this->compact();
+    }
+    if (!this->open()) {
+        return Error::FAILED;
+    }
+    if (!this->writeRecord(this->m_fd, offset, numBytes, this->m_image)) {
+        // Remove any partial record, so that later records can still be replayed.
+        if (ftruncate(this->m_fd, static_cast<off_t>(this->m_logBytes)) != 0) {
+            this->close();
+            this->m_loaded = false;
+        }
+        return Error::FAILED;
+    }
+    this->m_logBytes += RECORD_HEADER_BYTES + numBytes + RECORD_CRC_BYTES;
+    this->m_unsynced = true;
+    return Error::NONE;
+}
+
+bioloid::IControlTableStorage::Error bioloid::LogFileStorage::commit() {
+    if (this->m_unsynced) {
+        if (fsync(this->m_fd) != 0) {
+            return Error::FAILED;
+        }
+        this->m_unsynced = false;
+    }
+    if (this->m_logBytes > this->m_compactThreshold) {
+        // The records are already durable, so if compaction fails it's just tried again
+        // by the next commit.
+        this->compact();
+    }
+    return Error::NONE;
+}
+
+bioloid::IControlTableStorage::Error bioloid::LogFileStorage::compact() {
+    int fd = ::open(this->m_tempName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return Error::FAILED;
+    }
+    bool written =
+        this->writeRecord(fd, 0, this->m_numPersistentBytes, this->m_image) && fsync(fd) == 0;
+    written = ::close(fd) == 0 && written;
+    if (!written || rename(this->m_tempName, this->m_fileName) != 0) {
+        unlink(this->m_tempName);
+        return Error::FAILED;
+    }
+
+    // The log which was open has been replaced, so it needs to be reopened.
+    this->close();
+    this->m_logBytes = RECORD_HEADER_BYTES + this->m_numPersistentBytes + RECORD_CRC_BYTES;
+    this->m_loaded = true;
+    this->m_stats.numCompactions++;
+    return syncDirectory(this->m_fileName) ? Error::NONE : Error::FAILED;
+}
+
+void bioloid::LogFileStorage::close() {
+    if (this->m_fd >= 0) {
+        ::close(this->m_fd);
+        this->m_fd = -1;
+    }
+    this->m_unsynced = false;
+}
+
+bool bioloid::LogFileStorage::open() {
+    if (this->m_fd < 0) {
+        this->m_fd = ::open(this->m_fileName, O_WRONLY | O_APPEND);
+    }
+    return this->m_fd >= 0;
+}
+
+bool bioloid::LogFileStorage::writeRecord(
+    int fd,
+    size_t offset,
+    size_t numBytes,
+    const uint8_t* data) {
+    uint8_t header[RECORD_HEADER_BYTES];
+    putLE(&header[0], static_cast<uint32_t>(offset), 2);
+    putLE(&header[2], static_cast<uint32_t>(numBytes), 2);
+    uint8_t crc[RECORD_CRC_BYTES];
+    putLE(crc, crc32(&data[offset], numBytes, crc32(header, sizeof(header))), sizeof(crc));
+
+    struct iovec iov[] = {
+        {header, sizeof(header)},
+        {const_cast<uint8_t*>(&data[offset]), numBytes},
+        {crc, sizeof(crc)},
+    };
+    size_t recordBytes = sizeof(header) + numBytes + sizeof(crc);
+    ssize_t bytesWritten = writev(fd, iov, 3);
+    if (bytesWritten > 0) {
+        this->m_stats.bytesWritten += static_cast<size_t>(bytesWritten);
+    }
+    this->m_stats.numRecords++;
+    return bytesWritten == static_cast<ssize_t>(recordBytes);
+}
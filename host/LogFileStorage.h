@@ -0,0 +1,131 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   LogFileStorage.h
+ *
+ *   @brief  Log-structured control table storage, which only ever appends to its file.
+ *
+ ****************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "ControlTable.h"
+
+//! @addtogroup bioloid
+//! @{
+
+namespace bioloid {
+
+//! @brief Control table storage which appends each saved span to a log.
+//! @details Each record in the log contains the offset and length of a span (2 bytes each,
+//!          little endian), the bytes of the span, and the CRC-32 of everything before it
+//!          in the record. The first record always contains all of the persistent bytes.
+//!
+//!          load() replays the log into an in-memory image. Replay stops at the first
+//!          record which is truncated or has a bad CRC, and the log is truncated there, so
+//!          a torn append only loses the span that was being saved.
+//!
+//!          save() appends a record, so rewriting the same bytes repeatedly becomes a
+//!          sequence of appends rather than rewrites in place, and commit() fsyncs them.
+//!          Once the log grows past the compaction threshold, commit() replaces it with a
+//!          log containing a single record, using a temporary file and a rename.
+//!          Compaction runs synchronously within commit() rather than on a thread of its
+//!          own, since records appended while it ran would be lost by the rename. When the
+//!          table is saved by a WriteBehindSaver, commit() is called on the saver's thread,
+//!          so the control loop doesn't wait for compaction.
+//!
+//!          stats() counts the bytes saved and the bytes actually written (including
+//!          record overhead and compaction), so the write amplification can be monitored.
+class LogFileStorage : public IControlTableStorage {
+ public:
+    static constexpr size_t RECORD_HEADER_BYTES = 4;  //!< Offset and length.
+    static constexpr size_t RECORD_CRC_BYTES = 4;     //!< CRC-32 following the data.
+
+    //! @brief Statistics about the writes made to the log.
+    struct Stats {
+        uint64_t bytesSaved;      //!< Number of bytes passed to save().
+        uint64_t bytesWritten;    //!< Number of bytes written to the file.
+        uint32_t numRecords;      //!< Number of records appended.
+        uint32_t numCompactions;  //!< Number of times the log was rewritten from scratch.
+    };
+
+    //! @brief Constructor.
+    LogFileStorage(
+        const char* fileName,         //!< [in] Name of file to store the log in.
+        SizeType numPersistentBytes,  //!< [in] Number of persistent bytes.
+        uint8_t* image,               //!< [in] Storage for numPersistentBytes bytes.
+        size_t compactThreshold       //!< [in] Log size, in bytes, which triggers compaction.
+    );
+
+    //! @brief Destructor.
+    ~LogFileStorage() override { this->close(); }
+
+    LogFileStorage(const LogFileStorage&) = delete;
+    LogFileStorage& operator=(const LogFileStorage&) = delete;
+
+    //! @brief Returns the filename that was passed to the construcor.
+    //! @return const char* C string containing the filename.
+    const char* fileName() const { return this->m_fileName; }
+
+    Error load(OffsetType offset, SizeType numBytes, void* data) override;
+    Error save(OffsetType offset, SizeType numBytes, const void* data) override;
+    Error commit() override;
+
+    //! @brief Replaces the log with one containing a single record.
+    //! @returns Error::NONE if the log was compacted.
+    Error compact();
+
+    //! @brief Closes the log, if it's open.
+    void close();
+
+    //! @brief Returns the current size of the log.
+    //! @returns the number of bytes in the log.
+    size_t logBytes() const { return this->m_logBytes; }
+
+    //! @brief Returns statistics about the writes made to the log.
+    //! @returns the statistics.
+    const Stats& stats() const { return this->m_stats; }
+
+ private:
+    //! @brief Rebuilds the image by replaying the log.
+    //! @returns Error::NONE if the log contained a complete image.
+    Error replay();
+
+    //! @brief Opens the log for appending, if it isn't already open.
+    //! @returns true if the log is open.
+    bool open();
+
+    //! @brief Writes a record to a file.
+    //! @returns true if the whole record was written.
+    bool writeRecord(
+        int fd,              //!< [in] File to write to.
+        size_t offset,       //!< [in] Offset of the first byte in the record.
+        size_t numBytes,     //!< [in] Number of bytes in the record.
+        const uint8_t* data  //!< [in] Image containing the bytes to store.
+    );
+
+    char const* m_fileName;               //!< Name of the file.
+    char m_tempName[256];                 //!< Name of the file used while compacting.
+    const SizeType m_numPersistentBytes;  //!< Number of persistent bytes.
+    uint8_t* const m_image;               //!< Persistent bytes.
+    const size_t m_compactThreshold;      //!< Log size which triggers compaction.
+    int m_fd = -1;                        //!< Log opened for appending.
+    size_t m_logBytes = 0;                //!< Number of valid bytes in the log.
+    bool m_loaded = false;                //!< true if the image was replayed from the log.
+    bool m_unsynced = false;              //!< true if records were appended since commit().
+    Stats m_stats = {};                   //!< Statistics about writes.
+};
+
+}  // namespace bioloid
+
+//! @}
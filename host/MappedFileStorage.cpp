@@ -0,0 +1,119 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   MappedFileStorage.cpp
+ *
+ *   @brief  Control table storage which maps the file containing the persistent bytes.
+ *
+ ****************************************************************************/
+
+#include "MappedFileStorage.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstring>
+
+bioloid::MappedFileStorage::MappedFileStorage(const char* fileName, Sync::Type sync)
+    : m_fileName{fileName}, m_sync{sync} {
+    assert(this->m_fileName != nullptr);
+}
+
+bool bioloid::MappedFileStorage::map(
+    IControlTable::SizeType numCtlBytes,
+    IControlTable::SizeType numPersistentBytes) {
+    this->unmap();
+    if (numPersistentBytes > numCtlBytes) {
+        return false;
+    }
+    int fd = open(this->m_fileName, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || ftruncate(fd, numPersistentBytes) != 0) {
+        close(fd);
+        return false;
+    }
+    bool valid = static_cast<size_t>(st.st_size) >= numPersistentBytes;
+
+    // Reserve enough anonymous memory for the whole table, and then map the file over the
+    // start of it. The remainder of the file's last page is beyond the end of the file,
+    // so the non-persistent bytes which share that page are never written to the file.
+    auto pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t mapSize = (numCtlBytes + pageSize - 1) / pageSize * pageSize;
+    size_t fileSize = (numPersistentBytes + pageSize - 1) / pageSize * pageSize;
+    void* base =
+        mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base != MAP_FAILED && fileSize > 0 &&
+        mmap(base, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) ==
+            MAP_FAILED) {
+        munmap(base, mapSize);
+        base = MAP_FAILED;
+    }
+    close(fd);
+    if (base == MAP_FAILED) {
+        return false;
+    }
+
+    this->m_base = static_cast<uint8_t*>(base);
+    this->m_mapSize = mapSize;
+    this->m_numPersistentBytes = numPersistentBytes;
+    this->m_valid = valid;
+    return true;
+}
+
+void bioloid::MappedFileStorage::unmap() {
+    if (this->m_base == nullptr) {
+        return;
+    }
+    munmap(this->m_base, this->m_mapSize);
+    this->m_base = nullptr;
+    this->m_mapSize = 0;
+    this->m_numPersistentBytes = 0;
+    this->m_valid = false;
+}
+
+bioloid::IControlTableStorage::Error
+bioloid::MappedFileStorage::load(OffsetType offset, SizeType numBytes, void* data) {
+    if (!this->m_valid || offset + numBytes > this->m_numPersistentBytes) {
+        return Error::FAILED;
+    }
+    // When the control table lives in the mapping, the data is already there.
+    if (data != &this->m_base[offset]) {
+        memcpy(data, &this->m_base[offset], numBytes);
+    }
+    return Error::NONE;
+}
+
+bioloid::IControlTableStorage::Error
+bioloid::MappedFileStorage::save(OffsetType offset, SizeType numBytes, const void* data) {
+    if (this->m_base == nullptr || offset + numBytes > this->m_numPersistentBytes) {
+        return Error::FAILED;
+    }
+    if (data != &this->m_base[offset]) {
+        memcpy(&this->m_base[offset], data, numBytes);
+    }
+    this->m_valid = true;
+    if (this->m_sync == Sync::RELAXED || numBytes == 0) {
+        return Error::NONE;
+    }
+
+    // msync() requires a page aligned address.
+    auto pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t start = offset / pageSize * pageSize;
+    int flags = this->m_sync == Sync::SYNC ? MS_SYNC : MS_ASYNC;
+    if (msync(&this->m_base[start], offset + numBytes - start, flags) != 0) {
+        return Error::FAILED;
+    }
+    return Error::NONE;
+}
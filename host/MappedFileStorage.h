@@ -0,0 +1,103 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   MappedFileStorage.h
+ *
+ *   @brief  Control table storage which maps the file containing the persistent bytes.
+ *
+ ****************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "ControlTable.h"
+#include "Util.h"
+
+//! @addtogroup bioloid
+//! @{
+
+namespace bioloid {
+
+//! @brief Control table storage where the persistent bytes live in a memory mapped file.
+//! @details map() creates a region of memory large enough for the entire control table,
+//!          with the file mapped over its start. Passing ctlBytes() to the IControlTable
+//!          constructor means that modifying a persistent byte modifies the file's pages
+//!          directly, so load() doesn't need to copy anything, and save() only needs to
+//!          flush the dirty range (or nothing at all, using Sync::RELAXED). Note that this
+//!          also means that modifications may reach the file before save() is called.
+//!
+//!          The file contains exactly the persistent bytes, using the same layout as
+//!          FileStorage. Bytes following the persistent bytes are never written to the file.
+//!          If the file is shorter than the persistent bytes when it's mapped, then load()
+//!          fails so that the control table is set to its initial values.
+//! @code
+//!     MappedFileStorage storage{"device.ctl"};
+//!     storage.map(NUM_CTL_BYTES, NUM_PERSISTENT_BYTES);
+//!     MyControlTable ctlTable{storage.ctlBytes(), storage};
+//!     ctlTable.load();
+//! @endcode
+class MappedFileStorage : public IControlTableStorage {
+ public:
+    //! @brief How save() makes sure that modifications reach the disk.
+    struct Sync : public Bits<uint8_t> {
+        static constexpr Type SYNC = 0;     //!< Waits for the pages to be written.
+        static constexpr Type ASYNC = 1;    //!< Schedules the pages to be written.
+        static constexpr Type RELAXED = 2;  //!< Leaves writing the pages to the kernel.
+    };
+
+    //! @brief Constructor.
+    MappedFileStorage(
+        const char* fileName,         //!< [in] Name of file to store control table in.
+        Sync::Type sync = Sync::SYNC  //!< [in] How save() flushes modifications.
+    );
+
+    //! @brief Destructor.
+    ~MappedFileStorage() override { this->unmap(); }
+
+    MappedFileStorage(const MappedFileStorage&) = delete;
+    MappedFileStorage& operator=(const MappedFileStorage&) = delete;
+
+    //! @brief Returns the filename that was passed to the construcor.
+    //! @return const char* C string containing the filename.
+    const char* fileName() const { return this->m_fileName; }
+
+    //! @brief Creates the file if needed, and maps it.
+    //! @details The file is truncated or extended to contain exactly numPersistentBytes.
+    //! @returns true if the file was mapped.
+    bool map(
+        IControlTable::SizeType numCtlBytes,        //!< [in] Number of bytes in the table.
+        IControlTable::SizeType numPersistentBytes  //!< [in] Number of persistent bytes.
+    );
+
+    //! @brief Unmaps the file, if it's mapped.
+    //! @details Modifications made since the last save() may still be written to the file.
+    void unmap();
+
+    //! @brief Returns the memory to use for the control table.
+    //! @returns a pointer to the control bytes, or nullptr if map() hasn't succeeded.
+    uint8_t* ctlBytes() const { return this->m_base; }
+
+    Error load(OffsetType offset, SizeType numBytes, void* data) override;
+    Error save(OffsetType offset, SizeType numBytes, const void* data) override;
+
+ private:
+    char const* m_fileName;           //!< Name of the file.
+    const Sync::Type m_sync;          //!< How save() flushes modifications.
+    uint8_t* m_base = nullptr;        //!< Start of the mapping.
+    size_t m_mapSize = 0;             //!< Size of the mapping, in bytes.
+    size_t m_numPersistentBytes = 0;  //!< Number of bytes in the file.
+    bool m_valid = false;             //!< true if the file contains a saved table.
+};
+
+}  // namespace bioloid
+
+//! @}
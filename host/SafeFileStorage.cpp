@@ -0,0 +1,155 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   SafeFileStorage.cpp
+ *
+ *   @brief  Control table storage using a checksummed file which is replaced atomically.
+ *
+ ****************************************************************************/
+
+#include "SafeFileStorage.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+
+#include "Crc32.h"
+#include "HostFileUtil.h"
+#include "StorageUtil.h"
+
+bioloid::SafeFileStorage::SafeFileStorage(
+    const char* fileName,
+    uint16_t layoutVersion,
+    SizeType numPersistentBytes,
+    uint8_t* image)
+    : m_fileName{fileName},
+      m_layoutVersion{layoutVersion},
+      m_numPersistentBytes{numPersistentBytes},
+      m_image{image} {
+    assert(this->m_fileName != nullptr);
+    assert(this->m_image != nullptr);
+    int len = snprintf(this->m_tempName, sizeof(this->m_tempName), "%s.tmp", fileName);
+    assert(len > 0 && static_cast<size_t>(len) < sizeof(this->m_tempName));
+    (void)len;
+}
+
+bioloid::IControlTableStorage::Error bioloid::SafeFileStorage::readFile() {
+    int fd = open(this->m_fileName, O_RDONLY);
+    if (fd < 0) {
+        return Error::FAILED;
+    }
+    uint8_t header[HEADER_BYTES];
+    struct iovec iov[] = {
+        {header, sizeof(header)},
+        {this->m_image, this->m_numPersistentBytes},
+    };
+    ssize_t bytesRead = readv(fd, iov, 2);
+    close(fd);
+
+    if (bytesRead != static_cast<ssize_t>(HEADER_BYTES + this->m_numPersistentBytes) ||
+        getLE(&header[0], 4) != MAGIC || getLE(&header[4], 2) != this->m_layoutVersion ||
+        getLE(&header[6], 2) != this->m_numPersistentBytes ||
+        getLE(&header[8], 4) != crc32(this->m_image, this->m_numPersistentBytes)) {
+        return Error::FAILED;
+    }
+    this->m_loaded = true;
+    return Error::NONE;
+}
+
+bioloid::IControlTableStorage::Error
+bioloid::SafeFileStorage::load(OffsetType offset, SizeType numBytes, void* data) {
+    if (offset + numBytes > this->m_numPersistentBytes) {
+        return Error::FAILED;
+    }
+    if (!this->m_loaded && this->readFile() != Error::NONE) {
+        return Error::FAILED;
+    }
+    memcpy(data, &this->m_image[offset], numBytes);
+    return Error::NONE;
+}
+
+bioloid::IControlTableStorage::Error
+bioloid::SafeFileStorage::save(OffsetType offset, SizeType numBytes, const void* data) {
+    if (offset + numBytes > this->m_numPersistentBytes) {
+        return Error::FAILED;
+    }
+    memcpy(&this->m_image[offset], data, numBytes);
+    this->m_pending = true;
+    return Error::NONE;
+}
+
+bioloid::IControlTableStorage::Error bioloid::SafeFileStorage::commit() {
+    if (!this->m_pending) {
+        return Error::NONE;
+    }
+    uint8_t header[HEADER_BYTES];
+    putLE(&header[0], MAGIC, 4);
+    putLE(&header[4], this->m_layoutVersion, 2);
+    putLE(&header[6], this->m_numPersistentBytes, 2);
+    putLE(&header[8], crc32(this->m_image, this->m_numPersistentBytes), 4);
+
+    int fd = open(this->m_tempName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return Error::FAILED;
+    }
+    struct iovec iov[] = {
+        {header, sizeof(header)},
+        {this->m_image, this->m_numPersistentBytes},
+    };
+    bool written = writev(fd, iov, 2) ==
+                       static_cast<ssize_t>(HEADER_BYTES + this->m_numPersistentBytes) &&
+                   fsync(fd) == 0;
+    written = close(fd) == 0 && written;
+
+    // The rename replaces the file atomically, so readers see either the old or the new
+    // table. Syncing the directory makes sure that the rename itself survives power loss.
+    if (!written || rename(this->m_tempName, this->m_fileName) != 0) {
+        unlink(this->m_tempName);
+        return Error::FAILED;
+    }
+    if (!syncDirectory(this->m_fileName)) {
+        return Error::FAILED;
+    }
+    this->m_pending = false;
+    this->m_loaded = true;
+    return Error::NONE;
+}
+
+bioloid::IControlTableStorage::Error bioloid::SafeFileStorage::loadLayout(
+    uint16_t* layoutVersion,
+    void* data,
+    size_t maxBytes,
+    size_t* numBytes) {
+    int fd = open(this->m_fileName, O_RDONLY);
+    if (fd < 0) {
+        return Error::FAILED;
+    }
+    uint8_t header[HEADER_BYTES];
+    size_t length = 0;
+    bool valid = read(fd, header, sizeof(header)) == static_cast<ssize_t>(HEADER_BYTES) &&
+                 getLE(&header[0], 4) == MAGIC;
+    if (valid) {
+        length = getLE(&header[6], 2);
+        valid = length <= maxBytes && read(fd, data, length) == static_cast<ssize_t>(length) &&
+                getLE(&header[8], 4) == crc32(data, length);
+    }
+    close(fd);
+    if (!valid) {
+        return Error::FAILED;
+    }
+    *layoutVersion = static_cast<uint16_t>(getLE(&header[4], 2));
+    *numBytes = length;
+    return Error::NONE;
+}
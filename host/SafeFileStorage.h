@@ -0,0 +1,82 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   SafeFileStorage.h
+ *
+ *   @brief  Control table storage using a checksummed file which is replaced atomically.
+ *
+ ****************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "ControlTable.h"
+
+//! @addtogroup bioloid
+//! @{
+
+namespace bioloid {
+
+//! @brief Class which implements crash-safe control table storage using a file.
+//! @details The file contains a header followed by the persistent bytes. The header holds
+//!          a magic number, the layout version, the number of persistent bytes and the
+//!          CRC-32 of the persistent bytes, all stored little endian. load() reads the
+//!          whole file with a single read and fails unless all of these match, so a torn
+//!          or stale file causes the control table to be set to its initial values.
+//!
+//!          save() only updates an in-memory image of the persistent bytes. commit()
+//!          writes the image to a temporary file, fsyncs it, and renames it over the
+//!          original, so the file always contains either the old or the new table, even
+//!          if power is lost part way through.
+//!
+//!          A file saved using a different layout version fails to load, but loadLayout()
+//!          still returns its contents, so that IControlTable can migrate them.
+class SafeFileStorage : public IControlTableStorage {
+ public:
+    static constexpr uint32_t MAGIC = 0x4C544342;  //!< "BCTL" in little endian.
+    static constexpr size_t HEADER_BYTES = 12;     //!< Size of the header in the file.
+
+    //! @brief Constructor.
+    SafeFileStorage(
+        const char* fileName,         //!< [in] Name of file to store control table in.
+        uint16_t layoutVersion,       //!< [in] Version of the control table layout.
+        SizeType numPersistentBytes,  //!< [in] Number of persistent bytes.
+        uint8_t* image                //!< [in] Storage for numPersistentBytes bytes.
+    );
+
+    //! @brief Returns the filename that was passed to the construcor.
+    //! @return const char* C string containing the filename.
+    const char* fileName() const { return this->m_fileName; }
+
+    Error load(OffsetType offset, SizeType numBytes, void* data) override;
+    Error save(OffsetType offset, SizeType numBytes, const void* data) override;
+    Error commit() override;
+    Error loadLayout(uint16_t* layoutVersion, void* data, size_t maxBytes, size_t* numBytes)
+        override;
+
+ private:
+    //! @brief Reads and validates the file, storing its contents in the image.
+    //! @returns Error::NONE if the file is valid.
+    Error readFile();
+
+    char const* m_fileName;               //!< Name of the file.
+    char m_tempName[256];                 //!< Name of the temporary file.
+    const uint16_t m_layoutVersion;       //!< Version of the control table layout.
+    const SizeType m_numPersistentBytes;  //!< Number of persistent bytes.
+    uint8_t* const m_image;               //!< Persistent bytes.
+    bool m_loaded = false;                //!< true if the image was read from the file.
+    bool m_pending = false;               //!< true if save() was called since commit().
+};
+
+}  // namespace bioloid
+
+//! @}
@@ -0,0 +1,107 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   SharedTableSegment.cpp
+ *
+ *   @brief  Places a control table in POSIX shared memory so other processes can read it.
+ *
+ ****************************************************************************/
+
+#include "SharedTableSegment.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <new>
+
+bool bioloid::SharedTableSegment::create(const char* name, IControlTable::SizeType numBytes) {
+    this->close();
+    if (strlen(name) >= sizeof(this->m_name)) {
+        return false;
+    }
+
+    // Remove any stale segment, so that readers of it don't see the new table.
+    shm_unlink(name);
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    size_t size = DATA_OFFSET + numBytes;
+    void* addr = MAP_FAILED;
+    if (ftruncate(fd, static_cast<off_t>(size)) == 0) {
+        addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        shm_unlink(name);
+        return false;
+    }
+
+    this->m_header = new (addr) Header{MAGIC, VERSION, numBytes, {}};
+    this->m_size = size;
+    this->m_owner = true;
+    strcpy(this->m_name, name);
+    return true;
+}
+
+bool bioloid::SharedTableSegment::open(const char* name) {
+    this->close();
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    void* addr = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= DATA_OFFSET) {
+        addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        return false;
+    }
+
+    auto header = static_cast<Header*>(addr);
+    if (header->magic != MAGIC || header->version != VERSION ||
+        DATA_OFFSET + header->numBytes > static_cast<size_t>(st.st_size)) {
+        munmap(addr, st.st_size);
+        return false;
+    }
+    this->m_header = header;
+    this->m_size = st.st_size;
+    this->m_owner = false;
+    return true;
+}
+
+void bioloid::SharedTableSegment::close() {
+    if (this->m_header == nullptr) {
+        return;
+    }
+    munmap(this->m_header, this->m_size);
+    if (this->m_owner) {
+        shm_unlink(this->m_name);
+    }
+    this->m_header = nullptr;
+    this->m_size = 0;
+    this->m_owner = false;
+}
+
+bioloid::Error::Type bioloid::SharedTableSegment::read(
+    IControlTable::Offset::Type offset,
+    IControlTable::SizeType numBytes,
+    void* data) const {
+    if (offset + numBytes > this->m_header->numBytes) {
+        return Error::RANGE;
+    }
+    this->m_header->lock.read(this->data() + offset, numBytes, data);
+    return Error::NONE;
+}
@@ -0,0 +1,125 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   SharedTableSegment.h
+ *
+ *   @brief  Places a control table in POSIX shared memory so other processes can read it.
+ *
+ ****************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "ControlTable.h"
+#include "SeqLock.h"
+
+//! @addtogroup bioloid
+//! @{
+
+namespace bioloid {
+
+//! @brief A POSIX shared memory segment containing a SeqLock header and control bytes.
+//! @details The process which owns the control table calls create() and passes ctlBytes()
+//!          to the IControlTable constructor, and attaches seqLock() using
+//!          IControlTable::seqLock(). Other processes call open() and then use read() to
+//!          retrieve consistent values directly from the mapping, without any syscalls.
+//! @code
+//!     SharedTableSegment segment;
+//!     segment.create("/bioloid.1", NUM_CTL_BYTES);
+//!     MyControlTable ctlTable{segment.ctlBytes()};
+//!     ctlTable.seqLock(segment.seqLock());
+//! @endcode
+class SharedTableSegment {
+ public:
+    //! @brief Header stored at the beginning of the segment.
+    struct Header {
+        uint32_t magic;     //!< Always MAGIC.
+        uint16_t version;   //!< Always VERSION.
+        uint16_t numBytes;  //!< Number of control bytes (regardless of BIOLOID_CTL_ADDR_BITS).
+        SeqLock lock;       //!< Protects the control bytes.
+    };
+
+    static constexpr uint32_t MAGIC = 0x4C4F4942;  //!< "BIOL" in little endian.
+    static constexpr uint16_t VERSION = 1;         //!< Version of the segment layout.
+
+    //! Offset of the control bytes from the start of the segment.
+    static constexpr size_t DATA_OFFSET = (sizeof(Header) + 15) & ~size_t{15};
+
+    //! @brief Destructor.
+    //! @details Unmaps the segment, and removes it if it was created by this object.
+    ~SharedTableSegment() { this->close(); }
+
+    //! @brief Creates a new segment, replacing any existing segment with the same name.
+    //! @returns true if the segment was created and mapped.
+    bool create(
+        const char* name,                 //!< [in] Name of the segment (e.g. "/bioloid.1").
+        IControlTable::SizeType numBytes  //!< [in] Number of control bytes to allocate.
+    );
+
+    //! @brief Maps an existing segment read-only.
+    //! @returns true if the segment was mapped and has a valid header.
+    bool open(const char* name  //!< [in] Name of the segment.
+    );
+
+    //! @brief Unmaps the segment, and removes it if it was created by this object.
+    void close();
+
+    //! @brief Determines if a segment is mapped.
+    //! @returns true if create() or open() succeeded.
+    bool isOpen() const { return this->m_header != nullptr; }
+
+    //! @brief Returns the number of control bytes in the segment.
+    //! @returns the number of control bytes.
+    IControlTable::SizeType numBytes() const {
+        return static_cast<IControlTable::SizeType>(this->m_header->numBytes);
+    }
+
+    //! @brief Returns the control bytes, for passing to the IControlTable constructor.
+    //! @returns a pointer to the control bytes, or nullptr if the segment is read-only.
+    uint8_t* ctlBytes() { return this->m_owner ? this->data() : nullptr; }
+
+    //! @brief Returns the sequence lock protecting the control bytes.
+    //! @returns a pointer to the sequence lock, or nullptr if the segment is read-only.
+    SeqLock* seqLock() { return this->m_owner ? &this->m_header->lock : nullptr; }
+
+    //! @brief Returns the current sequence number.
+    //! @details This changes whenever the control table is modified, so readers can poll it
+    //!          to find out when something has changed.
+    //! @returns the sequence number.
+    uint32_t sequence() const { return this->m_header->lock.sequence(); }
+
+    //! @brief Copies a consistent snapshot of a range of the control bytes.
+    //! @returns Error::NONE if the data was copied.
+    //! @returns Error::RANGE if the range extends past the end of the control bytes.
+    Error::Type read(
+        IControlTable::Offset::Type offset,  //!< [in] Offset of the first byte to read.
+        IControlTable::SizeType numBytes,    //!< [in] Number of bytes to read.
+        void* data                           //!< [out] Place to store the data read.
+    ) const;
+
+ private:
+    static_assert(std::atomic<uint32_t>::is_always_lock_free);
+
+    //! @brief Returns a pointer to the control bytes within the mapping.
+    //! @returns a pointer to the control bytes.
+    uint8_t* data() const { return reinterpret_cast<uint8_t*>(this->m_header) + DATA_OFFSET; }
+
+    char m_name[64] = {};        //!< Name of the segment.
+    bool m_owner = false;        //!< true if this object created the segment.
+    Header* m_header = nullptr;  //!< Start of the mapping.
+    size_t m_size = 0;           //!< Size of the mapping, in bytes.
+};
+
+}  // namespace bioloid
+
+//! @}
@@ -0,0 +1,435 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   UringStorage.cpp
+ *
+ *   @brief  Control table storage which saves asynchronously using io_uring.
+ *
+ ****************************************************************************/
+
+#include "UringStorage.h"
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace {
+
+//! Set in the user data of the fdatasync() linked to a write.
+constexpr uint64_t SYNC_TAG = 1;
+
+}  // namespace
+
+bioloid::UringQueue::UringQueue(unsigned numEntries, IAsyncSaveObserver* observer, bool useUring)
+    : m_observer{observer} {
+    if (useUring) {
+        this->setup(numEntries);
+    }
+}
+
+bioloid::UringQueue::~UringQueue() {
+    this->flush();
+    this->teardown();
+}
+
+bool bioloid::UringQueue::setup(unsigned numEntries) {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = static_cast<int>(syscall(__NR_io_uring_setup, numEntries, &params));
+    if (fd < 0) {
+        return false;
+    }
+    // IORING_OP_WRITE needs the same kernel version (5.6) which added IORING_FEAT_RW_CUR_POS.
+    if ((params.features & IORING_FEAT_RW_CUR_POS) == 0) {
+        ::close(fd);
+        return false;
+    }
+    this->m_ringFd = fd;
+
+    this->m_sqRingBytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cqRingBytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMap) {
+        this->m_sqRingBytes = std::max(this->m_sqRingBytes, cqRingBytes);
+    }
+    void* addr = mmap(
+        nullptr, this->m_sqRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+        IORING_OFF_SQ_RING);
+    if (addr == MAP_FAILED) {
+        this->teardown();
+        return false;
+    }
+    this->m_sqRing = addr;
+    if (singleMap) {
+        this->m_cqRing = this->m_sqRing;
+    } else {
+        addr = mmap(
+            nullptr, cqRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+            IORING_OFF_CQ_RING);
+        if (addr == MAP_FAILED) {
+            this->teardown();
+            return false;
+        }
+        this->m_cqRing = addr;
+        this->m_cqRingBytes = cqRingBytes;
+    }
+    this->m_sqesBytes = params.sq_entries * sizeof(io_uring_sqe);
+    addr = mmap(
+        nullptr, this->m_sqesBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+        IORING_OFF_SQES);
+    if (addr == MAP_FAILED) {
+        this->teardown();
+        return false;
+    }
+    this->m_sqes = static_cast<io_uring_sqe*>(addr);
+
+    auto* sq = static_cast<uint8_t*>(this->m_sqRing);
+    this->m_sqHead = reinterpret_cast<unsigned*>(&sq[params.sq_off.head]);
+    this->m_sqTail = reinterpret_cast<unsigned*>(&sq[params.sq_off.tail]);
+    this->m_sqArray = reinterpret_cast<unsigned*>(&sq[params.sq_off.array]);
+    this->m_sqMask = *reinterpret_cast<unsigned*>(&sq[params.sq_off.ring_mask]);
+    this->m_sqEntries = params.sq_entries;
+    this->m_sqLocalTail = *this->m_sqTail;
+
+    auto* cq = static_cast<uint8_t*>(this->m_cqRing);
+    this->m_cqHead = reinterpret_cast<unsigned*>(&cq[params.cq_off.head]);
+    this->m_cqTail = reinterpret_cast<unsigned*>(&cq[params.cq_off.tail]);
+    this->m_cqes = reinterpret_cast<io_uring_cqe*>(&cq[params.cq_off.cqes]);
+    this->m_cqMask = *reinterpret_cast<unsigned*>(&cq[params.cq_off.ring_mask]);
+    this->m_cqEntries = params.cq_entries;
+    return true;
+}
+
+void bioloid::UringQueue::teardown() {
+    if (this->m_sqes != nullptr) {
+        munmap(this->m_sqes, this->m_sqesBytes);
+        this->m_sqes = nullptr;
+    }
+    if (this->m_cqRing != nullptr && this->m_cqRing != this->m_sqRing) {
+        munmap(this->m_cqRing, this->m_cqRingBytes);
+    }
+    this->m_cqRing = nullptr;
+    if (this->m_sqRing != nullptr) {
+        munmap(this->m_sqRing, this->m_sqRingBytes);
+        this->m_sqRing = nullptr;
+    }
+    if (this->m_ringFd >= 0) {
+        ::close(this->m_ringFd);
+        this->m_ringFd = -1;
+    }
+}
+
+void bioloid::UringQueue::enqueue(UringFileStorage* storage) {
+    storage->m_next = nullptr;
+    if (this->m_queueTail == nullptr) {
+        this->m_queueHead = storage;
+    } else {
+        this->m_queueTail->m_next = storage;
+    }
+    this->m_queueTail = storage;
+}
+
+size_t bioloid::UringQueue::submit() {
+    size_t numSubmitted = 0;
+    while (this->m_queueHead != nullptr) {
+        UringFileStorage* storage = this->m_queueHead;
+        size_t numBytes = storage->m_writeEnd - storage->m_writeStart;
+        uint8_t* data = &storage->m_writeBytes[storage->m_writeStart];
+
+        if (!this->isAsync()) {
+            memcpy(data, &storage->m_image[storage->m_writeStart], numBytes);
+            bool ok = pwrite(storage->m_fd, data, numBytes, storage->m_writeStart) ==
+                      static_cast<ssize_t>(numBytes);
+            this->m_stats.numSyscalls++;
+            if (ok && storage->m_sync) {
+                ok = fdatasync(storage->m_fd) == 0;
+                this->m_stats.numSyscalls++;
+            }
+            storage->m_failed = !ok;
+        } else {
+            unsigned numSqes = storage->m_sync ? 2 : 1;
+            // Make sure that the completions can't overflow the completion queue, and that
+            // the submission queue has room for the entries.
+            while (this->m_numPendingCqes + numSqes > this->m_cqEntries) {
+                if (!this->enter(1)) {
+                    return numSubmitted;
+                }
+                this->reap();
+            }
+            if (this->m_sqLocalTail + numSqes - __atomic_load_n(this->m_sqHead, __ATOMIC_ACQUIRE) >
+                    this->m_sqEntries &&
+                !this->enter(0)) {
+                return numSubmitted;
+            }
+            if (storage != this->m_queueHead) {
+                // Reaping completions queued another save first.
+                continue;
+            }
+            // The kernel writes from a copy, so that save() can modify the image while the
+            // write is in flight.
+            numBytes = storage->m_writeEnd - storage->m_writeStart;
+            data = &storage->m_writeBytes[storage->m_writeStart];
+            memcpy(data, &storage->m_image[storage->m_writeStart], numBytes);
+
+            io_uring_sqe* sqe = this->getSqe();
+            sqe->opcode = IORING_OP_WRITE;
+            sqe->fd = storage->m_fd;
+            sqe->addr = reinterpret_cast<uintptr_t>(data);
+            sqe->len = static_cast<uint32_t>(numBytes);
+            sqe->off = storage->m_writeStart;
+            sqe->user_data = reinterpret_cast<uintptr_t>(storage);
+            if (storage->m_sync) {
+                // The fdatasync() only runs if the write succeeds.
+                sqe->flags = IOSQE_IO_LINK;
+                sqe = this->getSqe();
+                sqe->opcode = IORING_OP_FSYNC;
+                sqe->fd = storage->m_fd;
+                sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+                sqe->user_data = reinterpret_cast<uintptr_t>(storage) | SYNC_TAG;
+            }
+            storage->m_numPendingCqes = numSqes;
+            storage->m_failed = false;
+            this->m_numPendingCqes += numSqes;
+        }
+
+        this->m_queueHead = storage->m_next;
+        if (this->m_queueHead == nullptr) {
+            this->m_queueTail = nullptr;
+        }
+        if (!this->isAsync()) {
+            // Completions are reported by complete(), just like the asynchronous case.
+            storage->m_next = nullptr;
+            if (this->m_doneTail == nullptr) {
+                this->m_doneHead = storage;
+            } else {
+                this->m_doneTail->m_next = storage;
+            }
+            this->m_doneTail = storage;
+        }
+        storage->m_queued = false;
+        storage->m_inFlight = true;
+        this->m_numInFlight++;
+        this->m_stats.numSaves++;
+        numSubmitted++;
+    }
+    if (this->m_numUnsubmitted > 0) {
+        this->enter(0);
+    }
+    return numSubmitted;
+}
+
+size_t bioloid::UringQueue::complete(bool wait) {
+    if (!this->isAsync()) {
+        size_t numCompleted = 0;
+        while (this->m_doneHead != nullptr) {
+            UringFileStorage* storage = this->m_doneHead;
+            this->m_doneHead = storage->m_next;
+            if (this->m_doneHead == nullptr) {
+                this->m_doneTail = nullptr;
+            }
+            this->finished(storage, storage->m_failed ? IControlTableStorage::Error::FAILED
+                                                      : IControlTableStorage::Error::NONE);
+            numCompleted++;
+        }
+        return numCompleted;
+    }
+
+    size_t numCompleted = this->reap();
+    while (numCompleted == 0 && wait && this->m_numInFlight > 0) {
+        if (!this->enter(1)) {
+            break;
+        }
+        numCompleted = this->reap();
+    }
+    return numCompleted;
+}
+
+void bioloid::UringQueue::flush() {
+    do {
+        this->submit();
+        while (this->m_numInFlight > 0) {
+            if (this->complete(true) == 0) {
+                return;
+            }
+        }
+    } while (this->m_queueHead != nullptr);
+}
+
+io_uring_sqe* bioloid::UringQueue::getSqe() {
+    io_uring_sqe* sqe = &this->m_sqes[this->m_sqLocalTail & this->m_sqMask];
+    memset(sqe, 0, sizeof(*sqe));
+    this->m_sqArray[this->m_sqLocalTail & this->m_sqMask] = this->m_sqLocalTail & this->m_sqMask;
+    this->m_sqLocalTail++;
+    this->m_numUnsubmitted++;
+    return sqe;
+}
+
+bool bioloid::UringQueue::enter(unsigned minComplete) {
+    // Publish the entries filled in by getSqe() to the kernel.
+    __atomic_store_n(this->m_sqTail, this->m_sqLocalTail, __ATOMIC_RELEASE);
+    for (;;) {
+        this->m_stats.numSyscalls++;
+        long rc = syscall(
+            __NR_io_uring_enter, this->m_ringFd, this->m_numUnsubmitted, minComplete,
+            minComplete > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+        if (rc >= 0) {
+            this->m_numUnsubmitted -= static_cast<unsigned>(rc);
+            return true;
+        }
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+}
+
+size_t bioloid::UringQueue::reap() {
+    size_t numCompleted = 0;
+    unsigned head = *this->m_cqHead;
+    while (head != __atomic_load_n(this->m_cqTail, __ATOMIC_ACQUIRE)) {
+        const io_uring_cqe& cqe = this->m_cqes[head & this->m_cqMask];
+        auto* storage = reinterpret_cast<UringFileStorage*>(cqe.user_data & ~SYNC_TAG);
+        bool isWrite = (cqe.user_data & SYNC_TAG) == 0;
+        if (cqe.res < 0 || (isWrite && static_cast<size_t>(cqe.res) !=
+                                           storage->m_writeEnd - storage->m_writeStart)) {
+            storage->m_failed = true;
+        }
+        __atomic_store_n(this->m_cqHead, ++head, __ATOMIC_RELEASE);
+        this->m_numPendingCqes--;
+        if (--storage->m_numPendingCqes == 0) {
+            this->finished(storage, storage->m_failed ? IControlTableStorage::Error::FAILED
+                                                      : IControlTableStorage::Error::NONE);
+            numCompleted++;
+        }
+        // The observer may have submitted more saves, which can process completions.
+        head = *this->m_cqHead;
+    }
+    return numCompleted;
+}
+
+void bioloid::UringQueue::finished(UringFileStorage* storage, IControlTableStorage::Error error) {
+    storage->m_inFlight = false;
+    this->m_numInFlight--;
+    if (error != IControlTableStorage::Error::NONE) {
+        // Write the bytes again on the next commit().
+        this->m_stats.numFailures++;
+        storage->m_dirtyStart = std::min(storage->m_dirtyStart, storage->m_writeStart);
+        storage->m_dirtyEnd = std::max(storage->m_dirtyEnd, storage->m_writeEnd);
+    }
+    if (storage->m_commitPending) {
+        storage->m_commitPending = false;
+        storage->queueWrite();
+    }
+    if (this->m_observer != nullptr) {
+        this->m_observer->saveCompleted(*storage, error);
+    }
+}
+
+bioloid::UringFileStorage::UringFileStorage(
+    UringQueue& queue,
+    const char* fileName,
+    SizeType numPersistentBytes,
+    uint8_t* image,
+    bool sync)
+    : m_queue{queue},
+      m_fileName{fileName},
+      m_numPersistentBytes{numPersistentBytes},
+      m_image{image},
+      m_sync{sync},
+      m_dirtyStart{numPersistentBytes} {
+    assert(this->m_fileName != nullptr);
+    assert(this->m_image != nullptr);
+    assert(this->m_numPersistentBytes <= BIOLOID_CTL_MAX_PERSISTENT_BYTES);
+}
+
+bioloid::IControlTableStorage::Error
+bioloid::UringFileStorage::load(OffsetType offset, SizeType numBytes, void* data) {
+    if (offset + numBytes > this->m_numPersistentBytes) {
+        return Error::FAILED;
+    }
+    if (this->isBusy()) {
+        // Don't read into the image while the kernel may be writing from it.
+        this->m_queue.flush();
+    }
+    int fd = ::open(this->m_fileName, O_RDONLY);
+    if (fd < 0) {
+        return Error::FAILED;
+    }
+    ssize_t result = pread(fd, &this->m_image[offset], numBytes, offset);
+    ::close(fd);
+    if (result != numBytes) {
+        return Error::FAILED;
+    }
+    memcpy(data, &this->m_image[offset], numBytes);
+    return Error::NONE;
+}
+
+bioloid::IControlTableStorage::Error
+bioloid::UringFileStorage::save(OffsetType offset, SizeType numBytes, const void* data) {
+    if (offset + numBytes > this->m_numPersistentBytes) {
+        return Error::FAILED;
+    }
+    memcpy(&this->m_image[offset], data, numBytes);
+    this->m_dirtyStart = std::min<size_t>(this->m_dirtyStart, offset);
+    this->m_dirtyEnd = std::max<size_t>(this->m_dirtyEnd, offset + numBytes);
+    return Error::NONE;
+}
+
+bioloid::IControlTableStorage::Error bioloid::UringFileStorage::commit() {
+    if (this->m_dirtyStart >= this->m_dirtyEnd) {
+        return Error::NONE;
+    }
+    if (this->m_inFlight) {
+        // Only one write is in flight at a time, so this is queued when it completes.
+        this->m_commitPending = true;
+        return Error::NONE;
+    }
+    if (this->m_fd < 0) {
+        this->m_fd = ::open(this->m_fileName, O_RDWR | O_CREAT, 0644);
+        if (this->m_fd < 0) {
+            return Error::FAILED;
+        }
+    }
+    this->queueWrite();
+    return Error::NONE;
+}
+
+void bioloid::UringFileStorage::close() {
+    if (this->isBusy()) {
+        this->m_queue.flush();
+    }
+    if (this->m_fd >= 0) {
+        ::close(this->m_fd);
+        this->m_fd = -1;
+    }
+}
+
+void bioloid::UringFileStorage::queueWrite() {
+    if (this->m_dirtyStart >= this->m_dirtyEnd) {
+        return;
+    }
+    if (this->m_queued) {
+        // The write hasn't been submitted yet, so it can be extended.
+        this->m_writeStart = std::min(this->m_writeStart, this->m_dirtyStart);
+        this->m_writeEnd = std::max(this->m_writeEnd, this->m_dirtyEnd);
+    } else {
+        this->m_writeStart = this->m_dirtyStart;
+        this->m_writeEnd = this->m_dirtyEnd;
+        this->m_queued = true;
+        this->m_queue.enqueue(this);
+    }
+    this->m_dirtyStart = this->m_numPersistentBytes;
+    this->m_dirtyEnd = 0;
+}
@@ -0,0 +1,252 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   UringStorage.h
+ *
+ *   @brief  Control table storage which saves asynchronously using io_uring.
+ *
+ ****************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "ControlTable.h"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+//! @addtogroup bioloid
+//! @{
+
+namespace bioloid {
+
+class UringFileStorage;
+
+//! @brief Notified when an asynchronous save completes.
+class IAsyncSaveObserver {
+ public:
+    //! @brief Destructor.
+    //! @details This class contains virtual methods, so a virtual destructor is declared.
+    virtual ~IAsyncSaveObserver() = default;
+
+    //! @brief Called from UringQueue::complete() once a save has completed.
+    //! @details If the save failed, the bytes are saved again by the next commit().
+    virtual void saveCompleted(
+        UringFileStorage& storage,         //!< [in] Storage which was saved.
+        IControlTableStorage::Error error  //!< [in] Error::NONE if the save succeeded.
+    ) = 0;
+};
+
+//! @brief Submits the saves of many UringFileStorage objects in batches.
+//! @details The queue owns an io_uring instance, which is set up using the raw system calls,
+//!          so liburing isn't needed. UringFileStorage::commit() only queues a save, and
+//!          submit() hands every queued save to the kernel with a single io_uring_enter()
+//!          (or a few, if there are more saves than ring entries). complete() then reports
+//!          the completed saves to the observer.
+//!
+//!          If io_uring isn't available (an old kernel, or blocked by a seccomp filter),
+//!          the queue falls back to performing each save with pwrite() from within
+//!          submit(), and complete() reports them in the same way.
+//!
+//!          The queue isn't thread safe, so it and its storage objects must all be used
+//!          from the same thread.
+class UringQueue {
+ public:
+    //! @brief Statistics about the saves.
+    struct Stats {
+        uint32_t numSaves;     //!< Number of saves submitted.
+        uint32_t numFailures;  //!< Number of saves which failed.
+        uint32_t numSyscalls;  //!< Number of system calls made to submit and complete saves.
+    };
+
+    //! @brief Constructor.
+    UringQueue(
+        unsigned numEntries,           //!< [in] Number of submission queue entries.
+        IAsyncSaveObserver* observer,  //!< [in] Notified of completed saves (may be nullptr).
+        bool useUring = true           //!< [in] false to always use the synchronous fallback.
+    );
+
+    //! @brief Destructor.
+    //! @details Waits for any saves which are in flight.
+    ~UringQueue();
+
+    UringQueue(const UringQueue&) = delete;
+    UringQueue& operator=(const UringQueue&) = delete;
+
+    //! @brief Determines if saves are performed asynchronously.
+    //! @returns true if io_uring is being used.
+    bool isAsync() const { return this->m_ringFd >= 0; }
+
+    //! @brief Submits all of the queued saves.
+    //! @details If the completion queue fills up, this waits for some of the saves in flight
+    //!          to complete, and reports them to the observer.
+    //! @returns the number of saves submitted.
+    size_t submit();
+
+    //! @brief Reports completed saves to the observer.
+    //! @returns the number of saves which completed.
+    size_t complete(bool wait  //!< [in] true to wait for at least one save, if any are in flight.
+    );
+
+    //! @brief Submits all of the queued saves, and waits for every save to complete.
+    void flush();
+
+    //! @brief Returns the number of saves which have been submitted but not completed.
+    //! @returns the number of saves in flight.
+    size_t numInFlight() const { return this->m_numInFlight; }
+
+    //! @brief Returns statistics about the saves.
+    //! @returns the statistics.
+    const Stats& stats() const { return this->m_stats; }
+
+ private:
+    friend class UringFileStorage;
+
+    //! @brief Adds a storage object to the end of the list of queued saves.
+    void enqueue(UringFileStorage* storage  //!< [in] Storage with a save to submit.
+    );
+
+    //! @brief Creates the io_uring instance and maps its rings.
+    //! @returns true if io_uring can be used.
+    bool setup(unsigned numEntries  //!< [in] Number of submission queue entries.
+    );
+
+    //! @brief Unmaps the rings and closes the io_uring instance.
+    void teardown();
+
+    //! @brief Gets the next free submission queue entry, which is cleared.
+    //! @details The caller must make sure that the submission queue isn't full.
+    //! @returns the entry.
+    io_uring_sqe* getSqe();
+
+    //! @brief Submits the entries added by getSqe(), and optionally waits for completions.
+    //! @returns true if the system call succeeded.
+    bool enter(unsigned minComplete  //!< [in] Number of completions to wait for.
+    );
+
+    //! @brief Processes the entries in the completion queue.
+    //! @returns the number of saves which completed.
+    size_t reap();
+
+    //! @brief Marks a save as complete, and reports it to the observer.
+    void finished(
+        UringFileStorage* storage,         //!< [in] Storage which was saved.
+        IControlTableStorage::Error error  //!< [in] Result of the save.
+    );
+
+    IAsyncSaveObserver* const m_observer;     //!< Notified of completed saves.
+    int m_ringFd = -1;                        //!< io_uring instance, or -1 for the fallback.
+    void* m_sqRing = nullptr;                 //!< Mapped submission queue ring.
+    size_t m_sqRingBytes = 0;                 //!< Size of m_sqRing.
+    void* m_cqRing = nullptr;                 //!< Mapped completion queue ring.
+    size_t m_cqRingBytes = 0;                 //!< Size of m_cqRing (0 if shared with m_sqRing).
+    io_uring_sqe* m_sqes = nullptr;           //!< Mapped submission queue entries.
+    size_t m_sqesBytes = 0;                   //!< Size of m_sqes.
+    unsigned* m_sqHead = nullptr;             //!< Next entry to be consumed by the kernel.
+    unsigned* m_sqTail = nullptr;             //!< Tail published to the kernel.
+    unsigned* m_sqArray = nullptr;            //!< Indirection array of the submission queue.
+    unsigned m_sqMask = 0;                    //!< Mask applied to submission queue indices.
+    unsigned m_sqEntries = 0;                 //!< Number of submission queue entries.
+    unsigned m_sqLocalTail = 0;               //!< Tail including unpublished entries.
+    unsigned* m_cqHead = nullptr;             //!< Next completion to be processed.
+    unsigned* m_cqTail = nullptr;             //!< Next completion to be filled in by the kernel.
+    io_uring_cqe* m_cqes = nullptr;           //!< Completion queue entries.
+    unsigned m_cqMask = 0;                    //!< Mask applied to completion queue indices.
+    unsigned m_cqEntries = 0;                 //!< Number of completion queue entries.
+    unsigned m_numUnsubmitted = 0;            //!< Entries filled in but not yet submitted.
+    unsigned m_numPendingCqes = 0;            //!< Completions which haven't been processed.
+    UringFileStorage* m_queueHead = nullptr;  //!< First queued save.
+    UringFileStorage* m_queueTail = nullptr;  //!< Last queued save.
+    UringFileStorage* m_doneHead = nullptr;   //!< First save completed by the fallback.
+    UringFileStorage* m_doneTail = nullptr;   //!< Last save completed by the fallback.
+    size_t m_numInFlight = 0;                 //!< Number of saves in flight.
+    Stats m_stats = {};                       //!< Statistics about the saves.
+};
+
+//! @brief Control table storage which saves asynchronously using a UringQueue.
+//! @details save() copies the bytes into an image and records the modified range, and
+//!          commit() queues a single write of that range, which is submitted along with the
+//!          saves of other devices by UringQueue::submit(). When sync is true, the write is
+//!          linked to an fdatasync() so that the save only completes once the bytes are
+//!          durable. The file has the same layout as FileStorage uses.
+//!
+//!          The range being written is copied out of the image when it's submitted, so
+//!          save() can modify the image while the kernel is still writing the copy. If bytes
+//!          are saved while a write is in flight, they're written by another write which is
+//!          queued once the first completes, so there's never more than one write in flight
+//!          for a file. load() is synchronous, and waits for any saves in flight.
+class UringFileStorage : public IControlTableStorage {
+ public:
+    //! @brief Constructor.
+    UringFileStorage(
+        UringQueue& queue,            //!< [in] Queue used to submit saves.
+        const char* fileName,         //!< [in] Name of file to store control table in.
+        SizeType numPersistentBytes,  //!< [in] Number of persistent bytes.
+        uint8_t* image,               //!< [in] Storage for numPersistentBytes bytes.
+        bool sync = false             //!< [in] true to fdatasync() after each write.
+    );
+
+    //! @brief Destructor.
+    //! @details Waits for any saves which are queued or in flight.
+    ~UringFileStorage() override { this->close(); }
+
+    UringFileStorage(const UringFileStorage&) = delete;
+    UringFileStorage& operator=(const UringFileStorage&) = delete;
+
+    //! @brief Returns the filename that was passed to the construcor.
+    //! @return const char* C string containing the filename.
+    const char* fileName() const { return this->m_fileName; }
+
+    Error load(OffsetType offset, SizeType numBytes, void* data) override;
+    Error save(OffsetType offset, SizeType numBytes, const void* data) override;
+
+    //! @brief Queues a write of the bytes saved since the last commit().
+    //! @details The write is performed asynchronously, and its result is reported to the
+    //!          queue's observer.
+    //! @returns Error::FAILED if the file couldn't be opened.
+    Error commit() override;
+
+    //! @brief Waits for any saves which are queued or in flight, and closes the file.
+    void close();
+
+    //! @brief Determines if a save is queued or in flight.
+    //! @returns true if a save hasn't completed yet.
+    bool isBusy() const { return this->m_queued || this->m_inFlight; }
+
+ private:
+    friend class UringQueue;
+
+    //! @brief Queues a write of the modified range.
+    void queueWrite();
+
+    UringQueue& m_queue;                  //!< Queue used to submit saves.
+    char const* m_fileName;               //!< Name of the file.
+    const SizeType m_numPersistentBytes;  //!< Number of persistent bytes.
+    uint8_t* const m_image;               //!< Persistent bytes.
+    const bool m_sync;                    //!< true to fdatasync() after each write.
+    int m_fd = -1;                        //!< File opened for writing.
+    size_t m_dirtyStart;                  //!< Start of the range saved since the last write.
+    size_t m_dirtyEnd = 0;                //!< End of the range saved since the last write.
+    size_t m_writeStart = 0;              //!< Start of the range being written.
+    size_t m_writeEnd = 0;                //!< End of the range being written.
+    uint8_t m_writeBytes[BIOLOID_CTL_MAX_PERSISTENT_BYTES];  //!< Copy of the bytes being written.
+    bool m_queued = false;                //!< true if a write is waiting to be submitted.
+    bool m_inFlight = false;              //!< true if a write has been submitted.
+    bool m_commitPending = false;         //!< true if commit() was called while in flight.
+    unsigned m_numPendingCqes = 0;        //!< Completions still expected for the write.
+    bool m_failed = false;                //!< true if part of the write failed.
+    UringFileStorage* m_next = nullptr;   //!< Next storage in the queue's list.
+};
+
+}  // namespace bioloid
+
+//! @}
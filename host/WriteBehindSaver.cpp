@@ -0,0 +1,104 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   WriteBehindSaver.cpp
+ *
+ *   @brief  Saves a control table from a background thread.
+ *
+ ****************************************************************************/
+
+#include "WriteBehindSaver.h"
+
+#include <algorithm>
+
+bioloid::WriteBehindSaver::WriteBehindSaver(IControlTable& ctlTable, const Config& config)
+    : m_ctlTable{ctlTable}, m_config{config} {
+    this->m_ctlTable.saveScheduler(this);
+    this->m_thread = std::thread(&WriteBehindSaver::run, this);
+}
+
+bioloid::WriteBehindSaver::~WriteBehindSaver() {
+    {
+        std::lock_guard<std::mutex> lock(this->m_lock);
+        this->m_stop = true;
+    }
+    this->m_cv.notify_one();
+    this->m_thread.join();
+
+    if (this->m_ctlTable.isDirty()) {
+        this->save();
+    }
+    this->m_ctlTable.saveScheduler(nullptr);
+}
+
+void bioloid::WriteBehindSaver::persistentModified() {
+    auto now = Clock::now();
+    std::lock_guard<std::mutex> lock(this->m_lock);
+    this->m_lastModified = now;
+    if (!this->m_pending) {
+        this->m_pending = true;
+        this->m_firstModified = now;
+        this->m_cv.notify_one();
+    }
+}
+
+bioloid::IControlTableStorage::Error bioloid::WriteBehindSaver::flush() {
+    {
+        std::lock_guard<std::mutex> lock(this->m_lock);
+        this->m_pending = false;
+    }
+    return this->save();
+}
+
+uint32_t bioloid::WriteBehindSaver::numSaves() const {
+    std::lock_guard<std::mutex> lock(this->m_lock);
+    return this->m_numSaves;
+}
+
+void bioloid::WriteBehindSaver::run() {
+    std::unique_lock<std::mutex> lock(this->m_lock);
+    while (!this->m_stop) {
+        if (!this->m_pending) {
+            this->m_cv.wait(lock);
+            continue;
+        }
+        auto due = std::min(
+            this->m_lastModified + this->m_config.quietPeriod,
+            this->m_firstModified + this->m_config.maxDelay);
+        if (Clock::now() < due) {
+            // Modifications made while we're waiting push out the quiet period, so we
+            // recalculate the due time each time we wake up.
+            this->m_cv.wait_until(lock, due);
+            continue;
+        }
+        this->m_pending = false;
+
+        lock.unlock();
+        auto rc = this->save();
+        lock.lock();
+
+        if (rc != IControlTableStorage::Error::NONE && !this->m_pending) {
+            // Try again once the quiet period has elapsed.
+            this->m_pending = true;
+            this->m_firstModified = this->m_lastModified = Clock::now();
+        }
+    }
+}
+
+bioloid::IControlTableStorage::Error bioloid::WriteBehindSaver::save() {
+    IControlTableStorage::Error rc;
+    {
+        std::lock_guard<std::mutex> tableLock(this->m_tableMutex);
+        rc = this->m_ctlTable.save();
+    }
+    std::lock_guard<std::mutex> lock(this->m_lock);
+    this->m_numSaves++;
+    return rc;
+}
@@ -0,0 +1,105 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   WriteBehindSaver.h
+ *
+ *   @brief  Saves a control table from a background thread.
+ *
+ ****************************************************************************/
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "ControlTable.h"
+
+//! @addtogroup bioloid
+//! @{
+
+namespace bioloid {
+
+//! @brief Coalesces modifications to persistent control table bytes into a single save.
+//! @details Once a persistent byte is modified, a background thread saves the control table
+//!          after no further modifications have been made for the quiet period, or once the
+//!          maximum delay has elapsed since the first unsaved modification, whichever comes
+//!          first.
+//!
+//!          The background thread holds tableMutex() while it saves, so any thread which
+//!          modifies the control table needs to hold tableMutex() while doing so.
+class WriteBehindSaver : public ISaveScheduler {
+ public:
+    //! @brief Timing parameters for the saver.
+    struct Config {
+        std::chrono::milliseconds quietPeriod{100};  //!< Time without modifications to wait.
+        std::chrono::milliseconds maxDelay{1000};    //!< Longest time a modification can wait.
+    };
+
+    //! @brief Constructor.
+    //! @details Registers the saver with the control table and starts the background thread.
+    WriteBehindSaver(
+        IControlTable& ctlTable,  //!< [in] Control table to save.
+        const Config& config      //!< [in] Timing parameters.
+    );
+
+    //! @brief Destructor.
+    //! @details Stops the background thread, and saves any modifications which haven't
+    //!          been saved yet.
+    ~WriteBehindSaver() override;
+
+    //! @brief Schedules a save of the control table.
+    void persistentModified() override;
+
+    //! @brief Saves the control table immediately.
+    //! @note This acquires tableMutex(), so it must not be called while holding it.
+    //! @returns IControlTableStorage::Error::NONE if the control table was saved successfully.
+    //! @returns IControlTableStorage::Error::FAILED if the control table could not be saved.
+    IControlTableStorage::Error flush();
+
+    //! @brief Returns the mutex which protects the control table.
+    //! @returns a reference to the mutex.
+    std::mutex& tableMutex() { return this->m_tableMutex; }
+
+    //! @brief Returns the number of times the control table has been saved.
+    //! @returns the number of times that IControlTable::save() was called.
+    uint32_t numSaves() const;
+
+ private:
+    using Clock = std::chrono::steady_clock;  //!< Clock used for scheduling saves.
+
+    //! @brief Body of the background thread.
+    void run();
+
+    //! @brief Saves the control table while holding tableMutex().
+    //! @returns the result of IControlTable::save().
+    IControlTableStorage::Error save();
+
+    IControlTable& m_ctlTable;  //!< Control table being saved.
+    const Config m_config;      //!< Timing parameters.
+
+    std::mutex m_tableMutex;  //!< Protects the control table.
+
+    mutable std::mutex m_lock;     //!< Protects the scheduling state below.
+    std::condition_variable m_cv;  //!< Wakes up the background thread.
+    bool m_pending = false;        //!< Set when there are modifications waiting to be saved.
+    bool m_stop = false;           //!< Set to make the background thread exit.
+    Clock::time_point m_firstModified;  //!< Time of the first unsaved modification.
+    Clock::time_point m_lastModified;   //!< Time of the most recent modification.
+    uint32_t m_numSaves = 0;            //!< Number of times the control table was saved.
+
+    std::thread m_thread;  //!< Background thread.
+};
+
+}  // namespace bioloid
+
+//! @}
@@ -0,0 +1,8 @@
+SOURCES_CPP += \
+    HostFileUtil.cpp \
+    LogFileStorage.cpp \
+    MappedFileStorage.cpp \
+    SafeFileStorage.cpp \
+    SharedTableSegment.cpp \
+    UringStorage.cpp \
+    WriteBehindSaver.cpp
@@ -0,0 +1,12 @@
+# Adds the host-only sources to builds which run on a host, such as the tests.
+#
+# The sources in this directory use threads, POSIX files, mmap and so on, which aren't
+# available on the Arduino targets. The Arduino IDE compiles every file under src, so these
+# live outside of it, and are only added to builds which include this file.
+
+HOST_DIR := $(patsubst %/,%,$(dir $(lastword $(MAKEFILE_LIST))))
+
+include $(HOST_DIR)/files.mk
+
+CPPFLAGS += -I$(HOST_DIR)
+vpath %.cpp $(HOST_DIR)
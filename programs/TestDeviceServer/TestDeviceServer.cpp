@@ -31,12 +31,65 @@
 #include <sys/unistd.h>
 #include <termios.h>
 
+#include "ControlTable.h"
+#include "Device.h"
 #include "DumpMem.h"
 #include "LinuxColorLog.h"
 #include "Log.h"
+#include "Packet.h"
+#include "SharedTableSegment.h"
+#include "Util.h"
 
 static constexpr in_port_t DEFAULT_PORT = 8888;
 
+//! @brief Storage used by the emulated device, which doesn't persist anything.
+class NullStorage : public bioloid::IControlTableStorage {
+ public:
+    Error load(OffsetType offset, SizeType numBytes, void* data) override {
+        (void)offset;
+        (void)numBytes;
+        (void)data;
+        return Error::FAILED;
+    }
+
+    Error save(OffsetType offset, SizeType numBytes, const void* data) override {
+        (void)offset;
+        (void)numBytes;
+        (void)data;
+        return Error::NONE;
+    }
+};
+
+//! @brief Port used by the emulated device.
+//! @details Status packets are sent back over the socket by main(), so this doesn't
+//!          need to do anything.
+class NullPort : public bioloid::IPort {
+ public:
+    uint8_t available() override { return 0; }
+
+    uint8_t readByte() override { return 0xff; }
+
+    void writePacket(bioloid::Packet const& pkt) override { (void)pkt; }
+};
+
+//! @brief Control table for the emulated device (laid out like an AX-12).
+class EmulatedControlTable : public bioloid::IControlTable {
+ public:
+    static constexpr uint8_t NUM_CTL_BYTES = 0x32;         //!< Number of control bytes.
+    static constexpr uint8_t NUM_PERSISTENT_BYTES = 0x18;  //!< Number of persistent bytes.
+    static constexpr uint8_t DEVICE_ID = 0x01;             //!< ID of the emulated device.
+
+    EmulatedControlTable(
+        uint8_t* ctlBytes,                       //!< [in] Memory used to store the control bytes.
+        bioloid::IControlTableStorage& storage,  //!< [in] Class which persists the data.
+        bioloid::IPort* port                     //!< [in] Port associated with the device.
+        )
+        : IControlTable(NUM_CTL_BYTES, NUM_PERSISTENT_BYTES, ctlBytes, storage, port) {
+        this->load();
+        this->set(Offset::ID, DEVICE_ID);
+    }
+};
+
 enum {
     // Options assigned a single character code can use that charater code
     // as a short option.
@@ -49,6 +102,8 @@ enum {
     // Options from this point onwards don't have any short option equivalents
 
     OPT_FIRST_LONG_OPT = 0x80,
+
+    OPT_SHM,
 };
 
 static const char* g_pgm_name;
@@ -60,6 +115,7 @@ struct option g_long_option[] = {
     {"debug",       no_argument,        nullptr,    OPT_DEBUG},
     {"help",        no_argument,        nullptr,    OPT_HELP},
     {"port",        required_argument,  nullptr,    OPT_PORT},
+    {"shm",         required_argument,  nullptr,    OPT_SHM},
     {"verbose",     no_argument,        nullptr,    OPT_VERBOSE},
     {},
     // clang-format on
@@ -83,6 +139,7 @@ int main(
     auto log = LinuxColorLog(stdout);
 
     in_port_t port = DEFAULT_PORT;
+    const char* shm_name = nullptr;
 
     // Figure out which directory our executable came from
 
@@ -126,6 +183,11 @@ int main(
                 break;
             }
 
+            case OPT_SHM: {
+                shm_name = optarg;
+                break;
+            }
+
             case OPT_VERBOSE: {
                 g_verbose = true;
                 break;
@@ -180,16 +242,61 @@ int main(
     }
     printf("Accepted connection from %s:%d", inet_ntoa(client.sin_addr), ntohs(client.sin_port));
 
+    // Optionally export the control table so that other processes can read it directly.
+    bioloid::SharedTableSegment segment;
+    if (shm_name != nullptr &&
+        !segment.create(shm_name, EmulatedControlTable::NUM_CTL_BYTES)) {
+        Log::error("Failed to create shared memory segment '%s'", shm_name);
+        exit(1);
+    }
+    uint8_t ctlBytes[EmulatedControlTable::NUM_CTL_BYTES];
+    NullStorage storage;
+    NullPort nullPort;
+    EmulatedControlTable ctlTable{
+        segment.ctlBytes() != nullptr ? segment.ctlBytes() : ctlBytes, storage, &nullPort};
+    ctlTable.seqLock(segment.seqLock());
+    bioloid::Device device{ctlTable};
+#if BIOLOID_CTL_HEATMAP
+    uint32_t reads[EmulatedControlTable::NUM_CTL_BYTES];
+    uint32_t writes[EmulatedControlTable::NUM_CTL_BYTES];
+    bioloid::AccessHeatmap heatmap{EmulatedControlTable::NUM_CTL_BYTES, reads, writes};
+    ctlTable.heatmap(&heatmap);
+#endif
+
+    uint8_t cmdParams[64];
+    uint8_t rspParams[64];
+    bioloid::Packet cmd{LEN(cmdParams), cmdParams};
+    bioloid::Packet rsp{LEN(rspParams), rspParams};
+
     ssize_t bytesRcvd;
     uint8_t buf[1024];
     while ((bytesRcvd = recv(socket, buf, sizeof(buf), 0)) > 0) {
         DumpMem("R", 0, buf, bytesRcvd);
-        // gadget.ProcessBytes(buf, bytesRcvd);
+        for (ssize_t idx = 0; idx < bytesRcvd; idx++) {
+            if (cmd.processByte(buf[idx]) != bioloid::Error::NONE ||
+                !device.processPacket(cmd, &rsp)) {
+                continue;
+            }
+            uint8_t rspBytes[LEN(rspParams) + 6];
+            size_t rspLen = rsp.data(sizeof(rspBytes), rspBytes);
+            DumpMem("S", 0, rspBytes, rspLen);
+            if (send(socket, rspBytes, rspLen, 0) < 0) {
+                Log::error("Failed to send status packet: %s", strerror(errno));
+            }
+        }
     }
 
+#if BIOLOID_CTL_HEATMAP
+    // Show which fields the master accessed the most.
+    heatmap.dump();
+#endif
+
     close(socket);
     close(listen_socket);
 
+    // exit() doesn't run the destructor, so remove the shared memory segment explicitly.
+    segment.close();
+
     if (g_verbose) {
         Log::debug("Done");
     }
@@ -206,5 +313,6 @@ void usage() {
     Log::info("%s", "");
     Log::info("  -d, --debug       Turn on debug output");
     Log::info("  -h, --help        Display this message");
+    Log::info("  --shm NAME        Export the control table as shared memory segment NAME");
     Log::info("  -v, --verbose     Turn on verbose messages");
 }
@@ -0,0 +1,45 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   AccessHeatmap.cpp
+ *
+ *   @brief  Counts how often each byte of a control table is read and written.
+ *
+ ****************************************************************************/
+
+#include "AccessHeatmap.h"
+
+#include <cinttypes>
+#include <cstring>
+
+#include "Log.h"
+
+bioloid::AccessHeatmap::AccessHeatmap(size_t numCtlBytes, uint32_t* reads, uint32_t* writes)
+    : m_numCtlBytes{numCtlBytes}, m_reads{reads}, m_writes{writes} {
+    assert(this->m_reads != nullptr);
+    assert(this->m_writes != nullptr);
+    this->reset();
+}
+
+void bioloid::AccessHeatmap::reset() {
+    memset(this->m_reads, 0, this->m_numCtlBytes * sizeof(uint32_t));
+    memset(this->m_writes, 0, this->m_numCtlBytes * sizeof(uint32_t));
+}
+
+void bioloid::AccessHeatmap::dump() const {
+    Log::info("Offset      Reads     Writes");
+    for (size_t idx = 0; idx < this->m_numCtlBytes; idx++) {
+        if (this->m_reads[idx] == 0 && this->m_writes[idx] == 0) {
+            continue;
+        }
+        Log::info(
+            "0x%04zx %10" PRIu32 " %10" PRIu32, idx, this->m_reads[idx], this->m_writes[idx]);
+    }
+}
@@ -0,0 +1,103 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   AccessHeatmap.h
+ *
+ *   @brief  Counts how often each byte of a control table is read and written.
+ *
+ ****************************************************************************/
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+//! @brief Enables counting of control table accesses.
+//! @details When this is 0 (the default) IControlTable doesn't contain any of the
+//!          instrumentation, so it costs nothing. Define it as 1 and attach an
+//!          AccessHeatmap using IControlTable::heatmap() to find out which fields are
+//!          accessed the most.
+#if !defined(BIOLOID_CTL_HEATMAP)
+#define BIOLOID_CTL_HEATMAP 0
+#endif
+
+//! @addtogroup bioloid
+//! @{
+
+namespace bioloid {
+
+//! @brief Counts the number of reads and writes of each byte of a control table.
+//! @details Each byte covered by a get(), set(), read() or write() is counted once, so a
+//!          2 byte field which is retrieved using get_u16() counts 1 read for each byte.
+class AccessHeatmap {
+ public:
+    //! @brief Constructor.
+    AccessHeatmap(
+        size_t numCtlBytes,  //!< [in] Number of bytes in the control table.
+        uint32_t* reads,     //!< [in] Storage for one read count per control table byte.
+        uint32_t* writes     //!< [in] Storage for one write count per control table byte.
+    );
+
+    //! @brief Counts a read of a range of bytes.
+    void recordRead(
+        size_t offset,   //!< [in] Offset of the first byte read.
+        size_t numBytes  //!< [in] Number of bytes read.
+    ) {
+        record(this->m_reads, offset, numBytes);
+    }
+
+    //! @brief Counts a write of a range of bytes.
+    void recordWrite(
+        size_t offset,   //!< [in] Offset of the first byte written.
+        size_t numBytes  //!< [in] Number of bytes written.
+    ) {
+        record(this->m_writes, offset, numBytes);
+    }
+
+    //! @brief Returns the number of bytes in the control table.
+    //! @returns the number of entries in reads() and writes().
+    size_t numCtlBytes() const { return this->m_numCtlBytes; }
+
+    //! @brief Returns the read counts.
+    //! @returns a pointer to one read count per control table byte.
+    const uint32_t* reads() const { return this->m_reads; }
+
+    //! @brief Returns the write counts.
+    //! @returns a pointer to one write count per control table byte.
+    const uint32_t* writes() const { return this->m_writes; }
+
+    //! @brief Sets all of the counts back to zero.
+    void reset();
+
+    //! @brief Logs the counts for each byte which has been accessed.
+    void dump() const;
+
+ private:
+    //! @brief Increments the counts for a range of bytes.
+    void record(
+        uint32_t* counts,  //!< [in] Counts to increment.
+        size_t offset,     //!< [in] Offset of the first byte accessed.
+        size_t numBytes    //!< [in] Number of bytes accessed.
+    ) {
+        assert(offset + numBytes <= this->m_numCtlBytes);
+        for (size_t idx = offset; idx < offset + numBytes; idx++) {
+            counts[idx]++;
+        }
+    }
+
+    const size_t m_numCtlBytes;  //!< Number of bytes in the control table.
+    uint32_t* const m_reads;     //!< Number of reads of each byte.
+    uint32_t* const m_writes;    //!< Number of writes of each byte.
+};
+
+}  // namespace bioloid
+
+//! @}
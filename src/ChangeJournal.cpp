@@ -0,0 +1,129 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   ChangeJournal.cpp
+ *
+ *   @brief  Ring of control table modifications, used to replicate a control table.
+ *
+ ****************************************************************************/
+
+#include "ChangeJournal.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+bioloid::ChangeJournal::ChangeJournal(Entry* entries, size_t numEntries)
+    : m_entries{entries}, m_mask{numEntries - 1} {
+    assert(entries != nullptr);
+    assert(numEntries != 0 && (numEntries & (numEntries - 1)) == 0);
+}
+
+void bioloid::ChangeJournal::append(
+    IControlTable::Offset::Type offset,
+    IControlTable::SizeType numBytes,
+    const uint8_t* data) {
+    uint32_t sequence = this->m_head.load(std::memory_order_relaxed);
+    size_t done = 0;
+    while (done < numBytes) {
+        size_t len = std::min<size_t>(numBytes - done, MAX_CHANGE_BYTES);
+        sequence++;
+        Entry& entry = this->m_entries[sequence & this->m_mask];
+
+        // Changing the slot's sequence number before the data means that a reader of the
+        // change being overwritten will notice, just like SeqLock.
+        entry.sequence.store(sequence, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        entry.offset = static_cast<IControlTable::Offset::Type>(offset + done);
+        entry.numBytes = static_cast<IControlTable::SizeType>(len);
+        memcpy(entry.data, &data[done], len);
+
+        // Publishing the head makes the change visible to readers.
+        this->m_head.store(sequence, std::memory_order_release);
+        done += len;
+    }
+}
+
+void bioloid::ChangeJournal::entriesChanged(
+    const IControlTable& ctlTable,
+    IControlTable::Offset::Type offset,
+    IControlTable::SizeType numBytes) {
+    this->append(offset, numBytes, &ctlTable.ctlBytes()[offset]);
+}
+
+bioloid::ChangeJournal::Result::Type bioloid::ChangeJournal::read(
+    uint32_t sequence,
+    Change* change) const {
+    // The subtraction wraps, so this works across the sequence number wrapping around.
+    auto behind = static_cast<int32_t>(this->head() - sequence);
+    if (behind < 0) {
+        return Result::EMPTY;
+    }
+    if (static_cast<size_t>(behind) > this->m_mask) {
+        return Result::OVERRUN;
+    }
+
+    const Entry& entry = this->m_entries[sequence & this->m_mask];
+    if (entry.sequence.load(std::memory_order_acquire) != sequence) {
+        return Result::OVERRUN;
+    }
+    change->sequence = sequence;
+    change->offset = entry.offset;
+    change->numBytes = std::min<IControlTable::SizeType>(entry.numBytes, MAX_CHANGE_BYTES);
+    memcpy(change->data, entry.data, change->numBytes);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (entry.sequence.load(std::memory_order_relaxed) != sequence) {
+        return Result::OVERRUN;
+    }
+    return Result::CHANGE;
+}
+
+bioloid::JournalReplica::JournalReplica(
+    const ChangeJournal& journal,
+    uint8_t* ctlBytes,
+    size_t numCtlBytes)
+    : m_journal{journal}, m_ctlBytes{ctlBytes}, m_numCtlBytes{numCtlBytes} {}
+
+size_t bioloid::JournalReplica::sync(const IControlTable& source) {
+    if (this->m_numSnapshots == 0) {
+        this->snapshot(source);
+    }
+    size_t numApplied = 0;
+    ChangeJournal::Change change;
+    while (true) {
+        switch (this->m_journal.read(this->m_next, &change)) {
+            case ChangeJournal::Result::CHANGE: {
+                if (change.offset + change.numBytes <= this->m_numCtlBytes) {
+                    memcpy(&this->m_ctlBytes[change.offset], change.data, change.numBytes);
+                }
+                this->m_next++;
+                numApplied++;
+                break;
+            }
+            case ChangeJournal::Result::OVERRUN: {
+                this->snapshot(source);
+                break;
+            }
+            default: {
+                return numApplied;
+            }
+        }
+    }
+}
+
+void bioloid::JournalReplica::snapshot(const IControlTable& source) {
+    // Any change recorded after reading the head is also replayed after the snapshot.
+    // Replaying a change which the snapshot already contains is harmless, since the
+    // changes are applied in order.
+    this->m_next = this->m_journal.head() + 1;
+    source.readSnapshot(
+        0, static_cast<IControlTable::SizeType>(this->m_numCtlBytes), this->m_ctlBytes);
+    this->m_numSnapshots++;
+}
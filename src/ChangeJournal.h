@@ -0,0 +1,164 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   ChangeJournal.h
+ *
+ *   @brief  Ring of control table modifications, used to replicate a control table.
+ *
+ ****************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "ControlTable.h"
+#include "ControlTableObservers.h"
+#include "Util.h"
+
+//! @addtogroup bioloid
+//! @{
+
+namespace bioloid {
+
+//! @brief Fixed size lock-free ring containing the most recent control table modifications.
+//! @details The journal is an observer, so subscribing it to the whole control table
+//!          records every set(), write() and load(), along with the sampled values which
+//!          populateEntry() reports using IControlTable::sampled(), as one or more changes.
+//!          Each change is assigned the next sequence number (starting at 1) and contains a
+//!          copy of the modified bytes.
+//!
+//!          There is a single writer (the thread which modifies the control table), and
+//!          readers never block it. Once a reader falls more than numEntries changes
+//!          behind, the oldest changes are overwritten and read() reports
+//!          Result::OVERRUN, at which point the reader needs to start again from a full
+//!          snapshot (see JournalReplica).
+//! @code
+//!     ChangeJournal::Entry entries[64];
+//!     ChangeJournal journal{entries, LEN(entries)};
+//!     registry.subscribe(&journal, 0, NUM_CTL_BYTES);
+//! @endcode
+class ChangeJournal : public IControlTableObserver {
+ public:
+    //! Maximum number of bytes in a single change. Larger modifications are split.
+    static constexpr size_t MAX_CHANGE_BYTES = 16;
+
+    //! @brief A slot in the ring.
+    struct Entry {
+        std::atomic<uint32_t> sequence{0};   //!< Sequence number of the change in the slot.
+        IControlTable::Offset::Type offset;  //!< Offset of the first modified byte.
+        IControlTable::SizeType numBytes;    //!< Number of modified bytes.
+        uint8_t data[MAX_CHANGE_BYTES];      //!< Modified bytes.
+    };
+
+    //! @brief A change copied out of the ring by read().
+    struct Change {
+        uint32_t sequence;                   //!< Sequence number of the change.
+        IControlTable::Offset::Type offset;  //!< Offset of the first modified byte.
+        IControlTable::SizeType numBytes;    //!< Number of modified bytes.
+        uint8_t data[MAX_CHANGE_BYTES];      //!< Modified bytes.
+    };
+
+    //! @brief Values returned from read().
+    struct Result : public Bits<uint8_t> {
+        static constexpr Type CHANGE = 0;   //!< The change was copied.
+        static constexpr Type EMPTY = 1;    //!< The change hasn't been recorded yet.
+        static constexpr Type OVERRUN = 2;  //!< The change has been overwritten.
+    };
+
+    //! @brief Constructor.
+    ChangeJournal(
+        Entry* entries,    //!< [in] Storage for the ring.
+        size_t numEntries  //!< [in] Number of entries (must be a power of 2).
+    );
+
+    //! @brief Records a change.
+    //! @details Changes with more than MAX_CHANGE_BYTES bytes are recorded as several
+    //!          consecutive changes.
+    void append(
+        IControlTable::Offset::Type offset,  //!< [in] Offset of the first modified byte.
+        IControlTable::SizeType numBytes,    //!< [in] Number of modified bytes.
+        const uint8_t* data                  //!< [in] Modified bytes.
+    );
+
+    //! @brief Records the bytes which were modified in the control table.
+    void entriesChanged(
+        const IControlTable& ctlTable,       //!< [in] Control table which was modified.
+        IControlTable::Offset::Type offset,  //!< [in] Offset of the first modified byte.
+        IControlTable::SizeType numBytes     //!< [in] Number of modified bytes.
+        ) override;
+
+    //! @brief Returns the sequence number of the most recently recorded change.
+    //! @returns the sequence number, or 0 if nothing has been recorded.
+    uint32_t head() const { return this->m_head.load(std::memory_order_acquire); }
+
+    //! @brief Returns the number of changes that the ring can hold.
+    //! @returns the number of entries.
+    size_t numEntries() const { return this->m_mask + 1; }
+
+    //! @brief Copies a change out of the ring.
+    //! @returns Result::CHANGE if the change was copied into `change`.
+    //! @returns Result::EMPTY if the change hasn't been recorded yet.
+    //! @returns Result::OVERRUN if the change has already been overwritten.
+    Result::Type read(
+        uint32_t sequence,  //!< [in] Sequence number of the change to read.
+        Change* change      //!< [out] Place to store the change.
+    ) const;
+
+ private:
+    Entry* const m_entries;           //!< Storage for the ring.
+    const size_t m_mask;              //!< numEntries - 1
+    std::atomic<uint32_t> m_head{0};  //!< Sequence number of the last recorded change.
+};
+
+//! @brief Copy of a control table which is kept up to date by replaying a ChangeJournal.
+//! @details sync() applies each change recorded since the previous sync(). If the
+//!          journal has overwritten changes which haven't been applied yet, the replica is
+//!          reloaded from a snapshot of the source table, and replay continues from there.
+//!          The source table should have a SeqLock attached, since the snapshot is taken
+//!          from a different thread than the one modifying the table.
+class JournalReplica {
+ public:
+    //! @brief Constructor.
+    JournalReplica(
+        const ChangeJournal& journal,  //!< [in] Journal of changes to the source table.
+        uint8_t* ctlBytes,             //!< [in] Storage for the replica.
+        size_t numCtlBytes             //!< [in] Number of bytes in the replica.
+    );
+
+    //! @brief Applies the outstanding changes to the replica.
+    //! @returns the number of changes applied.
+    size_t sync(const IControlTable& source  //!< [in] Table to take snapshots from.
+    );
+
+    //! @brief Returns the sequence number of the next change to apply.
+    //! @returns the sequence number, or 0 if no snapshot has been taken yet.
+    uint32_t next() const { return this->m_next; }
+
+    //! @brief Returns the number of times the replica was reloaded from a snapshot.
+    //! @returns the number of snapshots, including the initial one.
+    size_t numSnapshots() const { return this->m_numSnapshots; }
+
+ private:
+    //! @brief Reloads the replica from the source table.
+    void snapshot(const IControlTable& source  //!< [in] Table to take the snapshot from.
+    );
+
+    const ChangeJournal& m_journal;  //!< Journal of changes to the source table.
+    uint8_t* const m_ctlBytes;       //!< Storage for the replica.
+    const size_t m_numCtlBytes;      //!< Number of bytes in the replica.
+    uint32_t m_next = 0;             //!< Sequence number of the next change to apply.
+    size_t m_numSnapshots = 0;       //!< Number of snapshots taken.
+};
+
+}  // namespace bioloid
+
+//! @}
@@ -0,0 +1,85 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   ColumnStore.cpp
+ *
+ *   @brief  Keeps selected fields from the control tables of many devices in columns.
+ *
+ ****************************************************************************/
+
+#include "ColumnStore.h"
+
+#include <cassert>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+bioloid::ColumnStore::ColumnStore(
+    const ColumnDesc* columns,
+    size_t numColumns,
+    size_t numDevices,
+    uint16_t* values)
+    : m_columns{columns}, m_numColumns{numColumns}, m_numDevices{numDevices}, m_values{values} {
+    assert(this->m_values != nullptr);
+    for (size_t col = 0; col < this->m_numColumns; col++) {
+        assert(this->m_columns[col].numBytes == 1 || this->m_columns[col].numBytes == 2);
+    }
+    memset(this->m_values, 0, this->m_numColumns * this->m_numDevices * sizeof(uint16_t));
+}
+
+size_t bioloid::ColumnStore::update(
+    size_t device,
+    IControlTable::Offset::Type offset,
+    const uint8_t* data,
+    IControlTable::SizeType numBytes) {
+    assert(device < this->m_numDevices);
+    size_t numUpdated = 0;
+    for (size_t col = 0; col < this->m_numColumns; col++) {
+        const ColumnDesc& column = this->m_columns[col];
+        if (column.offset < offset || column.offset + column.numBytes > offset + numBytes) {
+            continue;
+        }
+        const uint8_t* bytes = &data[column.offset - offset];
+        uint16_t val = bytes[0];
+        if (column.numBytes == 2) {
+            val |= static_cast<uint16_t>(bytes[1] << 8);
+        }
+        this->m_values[col * this->m_numDevices + device] = val;
+        numUpdated++;
+    }
+    return numUpdated;
+}
+
+void bioloid::convertColumn(
+    const uint16_t* src,
+    size_t numValues,
+    float zero,
+    float scale,
+    float* dst) {
+    size_t idx = 0;
+#if defined(__SSE2__)
+    const __m128i zeroBits = _mm_setzero_si128();
+    const __m128 zero4 = _mm_set1_ps(zero);
+    const __m128 scale4 = _mm_set1_ps(scale);
+    for (; idx + 8 <= numValues; idx += 8) {
+        __m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[idx]));
+        __m128 lo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(raw, zeroBits));
+        __m128 hi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(raw, zeroBits));
+        _mm_storeu_ps(&dst[idx], _mm_mul_ps(_mm_sub_ps(lo, zero4), scale4));
+        _mm_storeu_ps(&dst[idx + 4], _mm_mul_ps(_mm_sub_ps(hi, zero4), scale4));
+    }
+#endif
+    // Whatever is left over (or everything, if there's no SIMD support).
+    for (; idx < numValues; idx++) {
+        dst[idx] = (static_cast<float>(src[idx]) - zero) * scale;
+    }
+}
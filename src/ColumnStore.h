@@ -0,0 +1,111 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   ColumnStore.h
+ *
+ *   @brief  Keeps selected fields from the control tables of many devices in columns.
+ *
+ ****************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "ControlTable.h"
+
+//! @addtogroup bioloid
+//! @{
+
+namespace bioloid {
+
+//! @brief Describes a control table field which is stored as a column.
+struct ColumnDesc {
+    IControlTable::Offset::Type offset;  //!< Offset of the field within the control table.
+    uint8_t numBytes;                    //!< Size of the field, in bytes (1 or 2).
+};
+
+//! @brief Stores "hot" fields from the control tables of many devices in column-major order.
+//! @details This is intended to be used on the master, which needs things like the
+//!          present position of every servo as a dense array each cycle. Rather than
+//!          gathering a field from each device's control table, the column for the field
+//!          is updated as each READ reply arrives, and can then be used directly.
+//! @code
+//!     static constexpr ColumnDesc COLUMNS[] = {
+//!         {Offset::PRESENT_POSITION, 2},
+//!         {Offset::PRESENT_LOAD, 2},
+//!     };
+//!     uint16_t values[LEN(COLUMNS) * NUM_SERVOS];
+//!     ColumnStore store{COLUMNS, LEN(COLUMNS), NUM_SERVOS, values};
+//! @endcode
+class ColumnStore {
+ public:
+    //! @brief Constructor.
+    ColumnStore(
+        const ColumnDesc* columns,  //!< [in] Fields to store in columns.
+        size_t numColumns,          //!< [in] Number of entries in `columns`.
+        size_t numDevices,          //!< [in] Number of devices stored.
+        uint16_t* values            //!< [in] Storage for numColumns * numDevices values.
+    );
+
+    //! @brief Returns the number of devices stored.
+    //! @returns the number of entries in each column.
+    size_t numDevices() const { return this->m_numDevices; }
+
+    //! @brief Returns the values of a column, one per device.
+    //! @returns a pointer to numDevices() contiguous values.
+    const uint16_t* column(size_t col  //!< [in] Index of the column to return.
+    ) const {
+        return &this->m_values[col * this->m_numDevices];
+    }
+
+    //! @brief Returns the value of a field for a single device.
+    //! @returns the value last stored for the device.
+    uint16_t value(
+        size_t col,    //!< [in] Index of the column.
+        size_t device  //!< [in] Index of the device.
+    ) const {
+        return this->column(col)[device];
+    }
+
+    //! @brief Updates the columns from a range of control table bytes read from a device.
+    //! @details Typically called with the parameters of the status packet from a READ
+    //!          instruction. Only columns whose field lies entirely within the range are
+    //!          updated.
+    //! @returns the number of columns which were updated.
+    size_t update(
+        size_t device,                       //!< [in] Index of the device the data is from.
+        IControlTable::Offset::Type offset,  //!< [in] Offset of the first byte of data.
+        const uint8_t* data,                 //!< [in] Control table bytes.
+        IControlTable::SizeType numBytes     //!< [in] Number of bytes of data.
+    );
+
+ private:
+    const ColumnDesc* m_columns;  //!< Fields stored in columns.
+    const size_t m_numColumns;    //!< Number of entries in m_columns.
+    const size_t m_numDevices;    //!< Number of devices stored.
+    uint16_t* const m_values;     //!< Column-major values.
+};
+
+//! @brief Converts a column of raw unsigned values to floating point.
+//! @details Computes `dst[i] = (src[i] - zero) * scale` for every entry, which converts
+//!          (for example) position ticks to radians. When SSE2 is available 8 values are
+//!          converted at a time.
+void convertColumn(
+    const uint16_t* src,  //!< [in] Raw values.
+    size_t numValues,     //!< [in] Number of values to convert.
+    float zero,           //!< [in] Raw value which corresponds to 0.0.
+    float scale,          //!< [in] Amount to multiply each raw value by.
+    float* dst            //!< [out] Place to store the converted values.
+);
+
+}  // namespace bioloid
+
+//! @}
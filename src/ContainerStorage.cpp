@@ -0,0 +1,179 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   ContainerStorage.cpp
+ *
+ *   @brief  Stores the control tables of many devices in a single file.
+ *
+ ****************************************************************************/
+
+#include "ContainerStorage.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstring>
+
+#include "Crc32.h"
+#include "StorageUtil.h"
+
+bioloid::ContainerStorage::ContainerStorage(
+    const char* fileName,
+    size_t numSlots,
+    size_t slotBytes,
+    uint8_t* image)
+    : m_fileName{fileName}, m_numSlots{numSlots}, m_slotBytes{slotBytes}, m_image{image} {
+    assert(this->m_fileName != nullptr);
+    assert(this->m_image != nullptr);
+    assert(this->m_numSlots <= 0xFFFF);
+    assert(this->m_slotBytes > SLOT_HEADER_BYTES && this->m_slotBytes % SLOT_ALIGN == 0);
+}
+
+bool bioloid::ContainerStorage::open() {
+    this->close();
+    this->m_fd = ::open(this->m_fileName, O_RDWR | O_CREAT, 0644);
+    if (this->m_fd < 0) {
+        return false;
+    }
+    size_t numBytes = imageBytes(this->m_numSlots, this->m_slotBytes);
+    ssize_t bytesRead = pread(this->m_fd, this->m_image, numBytes, 0);
+    if (bytesRead == 0) {
+        // A new container, so write an empty index and empty slots.
+        memset(this->m_image, 0, numBytes);
+        putLE(&this->m_image[0], MAGIC, 4);
+        putLE(&this->m_image[4], VERSION, 2);
+        putLE(&this->m_image[6], static_cast<uint32_t>(this->m_numSlots), 2);
+        putLE(&this->m_image[8], static_cast<uint32_t>(this->m_slotBytes), 4);
+        if (pwrite(this->m_fd, this->m_image, numBytes, 0) != static_cast<ssize_t>(numBytes)) {
+            this->close();
+            return false;
+        }
+        return true;
+    }
+
+    // Don't touch a file with a different layout, since it may belong to something else.
+    if (bytesRead != static_cast<ssize_t>(numBytes) || getLE(&this->m_image[0], 4) != MAGIC ||
+        getLE(&this->m_image[4], 2) != VERSION ||
+        getLE(&this->m_image[6], 2) != this->m_numSlots ||
+        getLE(&this->m_image[8], 4) != this->m_slotBytes) {
+        this->close();
+        return false;
+    }
+    return true;
+}
+
+void bioloid::ContainerStorage::close() {
+    if (this->m_fd >= 0) {
+        ::close(this->m_fd);
+        this->m_fd = -1;
+    }
+}
+
+size_t bioloid::ContainerStorage::find(uint32_t key) const {
+    if (this->m_fd < 0) {
+        return NO_SLOT;
+    }
+    for (size_t slot = 0; slot < this->m_numSlots; slot++) {
+        const uint8_t* entry = this->indexEntry(slot);
+        if ((getLE(&entry[4], 4) & IN_USE) != 0 && getLE(&entry[0], 4) == key) {
+            return slot;
+        }
+    }
+    return NO_SLOT;
+}
+
+size_t bioloid::ContainerStorage::allocate(uint32_t key) {
+    if (this->m_fd < 0) {
+        return NO_SLOT;
+    }
+    size_t slot = this->find(key);
+    if (slot != NO_SLOT) {
+        return slot;
+    }
+    for (slot = 0; slot < this->m_numSlots; slot++) {
+        uint8_t* entry = this->indexEntry(slot);
+        if ((getLE(&entry[4], 4) & IN_USE) != 0) {
+            continue;
+        }
+        // The slot's CRC won't match until the slot is written, so writing the index entry
+        // first is safe.
+        putLE(&entry[0], key, 4);
+        putLE(&entry[4], IN_USE, 4);
+        auto offset = static_cast<off_t>(entry - this->m_image);
+        if (pwrite(this->m_fd, entry, INDEX_ENTRY_BYTES, offset) !=
+            static_cast<ssize_t>(INDEX_ENTRY_BYTES)) {
+            memset(entry, 0, INDEX_ENTRY_BYTES);
+            return NO_SLOT;
+        }
+        return slot;
+    }
+    return NO_SLOT;
+}
+
+bool bioloid::ContainerStorage::isValid(size_t slot) const {
+    const uint8_t* start = this->slotStart(slot);
+    return getLE(&start[4], 4) == getLE(this->indexEntry(slot), 4) &&
+           getLE(&start[0], 4) == crc32(&start[4], this->m_slotBytes - 4);
+}
+
+bool bioloid::ContainerStorage::writeSlot(size_t slot) {
+    if (this->m_fd < 0) {
+        return false;
+    }
+    uint8_t* start = this->slotStart(slot);
+    putLE(&start[4], getLE(this->indexEntry(slot), 4), 4);
+    putLE(&start[0], crc32(&start[4], this->m_slotBytes - 4), 4);
+    auto offset = static_cast<off_t>(start - this->m_image);
+    return pwrite(this->m_fd, start, this->m_slotBytes, offset) ==
+           static_cast<ssize_t>(this->m_slotBytes);
+}
+
+bioloid::ContainerSlot::ContainerSlot(ContainerStorage& container, uint32_t key)
+    : m_container{container}, m_key{key} {}
+
+bioloid::IControlTableStorage::Error
+bioloid::ContainerSlot::load(OffsetType offset, SizeType numBytes, void* data) {
+    if (this->m_slot == ContainerStorage::NO_SLOT) {
+        this->m_slot = this->m_container.find(this->m_key);
+    }
+    if (this->m_slot == ContainerStorage::NO_SLOT ||
+        offset + numBytes > this->m_container.slotCapacity() ||
+        !this->m_container.isValid(this->m_slot)) {
+        return Error::FAILED;
+    }
+    memcpy(data, &this->m_container.slotData(this->m_slot)[offset], numBytes);
+    return Error::NONE;
+}
+
+bioloid::IControlTableStorage::Error
+bioloid::ContainerSlot::save(OffsetType offset, SizeType numBytes, const void* data) {
+    if (offset + numBytes > this->m_container.slotCapacity()) {
+        return Error::FAILED;
+    }
+    if (this->m_slot == ContainerStorage::NO_SLOT) {
+        this->m_slot = this->m_container.allocate(this->m_key);
+        if (this->m_slot == ContainerStorage::NO_SLOT) {
+            return Error::FAILED;
+        }
+    }
+    memcpy(&this->m_container.slotData(this->m_slot)[offset], data, numBytes);
+    this->m_pending = true;
+    return Error::NONE;
+}
+
+bioloid::IControlTableStorage::Error bioloid::ContainerSlot::commit() {
+    if (this->m_pending) {
+        if (!this->m_container.writeSlot(this->m_slot)) {
+            return Error::FAILED;
+        }
+        this->m_pending = false;
+    }
+    return Error::NONE;
+}
@@ -0,0 +1,194 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   ContainerStorage.h
+ *
+ *   @brief  Stores the control tables of many devices in a single file.
+ *
+ ****************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "ControlTable.h"
+
+//! @addtogroup bioloid
+//! @{
+
+namespace bioloid {
+
+//! @brief A single file containing the persistent bytes of many control tables.
+//! @details The file starts with a header, followed by a fixed size index with one entry
+//!          per slot, followed by the slots themselves. Each slot starts at a multiple of
+//!          SLOT_ALIGN bytes and contains the CRC-32 and key of the slot, followed by the
+//!          persistent bytes of one control table. Index entries contain the key (e.g. a
+//!          device ID or serial number) of the table stored in the slot.
+//!
+//!          open() reads the entire file with a single read into an image supplied by the
+//!          caller, and each device uses a ContainerSlot to access its slot in the image.
+//!          A slot whose CRC doesn't match fails to load, so only that device is set to
+//!          its initial values.
+//! @code
+//!     static constexpr size_t SLOT_BYTES = ContainerStorage::slotBytes(NUM_PERSISTENT_BYTES);
+//!     static uint8_t image[ContainerStorage::imageBytes(NUM_DEVICES, SLOT_BYTES)];
+//!     ContainerStorage container{"fleet.ctl", NUM_DEVICES, SLOT_BYTES, image};
+//!     container.open();
+//!     ContainerSlot storage{container, deviceId};
+//! @endcode
+class ContainerStorage {
+ public:
+    static constexpr uint32_t MAGIC = 0x4E544342;   //!< "BCTN" in little endian.
+    static constexpr uint16_t VERSION = 1;          //!< Version of the file layout.
+    static constexpr size_t HEADER_BYTES = 12;      //!< Size of the file header.
+    static constexpr size_t INDEX_ENTRY_BYTES = 8;  //!< Size of each index entry.
+    static constexpr size_t SLOT_HEADER_BYTES = 8;  //!< CRC-32 and key of each slot.
+    static constexpr size_t SLOT_ALIGN = 64;        //!< Alignment of each slot.
+    static constexpr size_t NO_SLOT = ~size_t{0};   //!< Returned by find() on failure.
+
+    //! @brief Determines the size of the slots needed to store a control table.
+    //! @returns the number of bytes in each slot.
+    static constexpr size_t slotBytes(
+        size_t numPersistentBytes  //!< [in] Number of persistent bytes in the table.
+    ) {
+        return align(SLOT_HEADER_BYTES + numPersistentBytes);
+    }
+
+    //! @brief Determines the offset of the first slot in the file.
+    //! @returns the offset of the first slot.
+    static constexpr size_t slotsOffset(size_t numSlots  //!< [in] Number of slots.
+    ) {
+        return align(HEADER_BYTES + numSlots * INDEX_ENTRY_BYTES);
+    }
+
+    //! @brief Determines the size of the image (and the file).
+    //! @returns the number of bytes in the image.
+    static constexpr size_t imageBytes(
+        size_t numSlots,  //!< [in] Number of slots.
+        size_t slotBytes  //!< [in] Number of bytes in each slot.
+    ) {
+        return slotsOffset(numSlots) + numSlots * slotBytes;
+    }
+
+    //! @brief Constructor.
+    ContainerStorage(
+        const char* fileName,  //!< [in] Name of the container file.
+        size_t numSlots,       //!< [in] Number of slots in the container.
+        size_t slotBytes,      //!< [in] Number of bytes in each slot (from slotBytes()).
+        uint8_t* image         //!< [in] Storage for imageBytes(numSlots, slotBytes) bytes.
+    );
+
+    //! @brief Destructor.
+    ~ContainerStorage() { this->close(); }
+
+    ContainerStorage(const ContainerStorage&) = delete;
+    ContainerStorage& operator=(const ContainerStorage&) = delete;
+
+    //! @brief Opens the container, creating it if it doesn't exist.
+    //! @returns true if the container was opened.
+    //! @returns false if the file couldn't be opened, or has a different layout.
+    bool open();
+
+    //! @brief Closes the container.
+    void close();
+
+    //! @brief Returns the number of bytes available for a table in each slot.
+    //! @returns the number of persistent bytes that each slot can hold.
+    size_t slotCapacity() const { return this->m_slotBytes - SLOT_HEADER_BYTES; }
+
+    //! @brief Finds the slot used by a key.
+    //! @returns the index of the slot, or NO_SLOT if the key doesn't have a slot.
+    size_t find(uint32_t key  //!< [in] Key to find.
+    ) const;
+
+    //! @brief Assigns an unused slot to a key.
+    //! @returns the index of the slot, or NO_SLOT if the container is full.
+    size_t allocate(uint32_t key  //!< [in] Key to assign a slot to.
+    );
+
+    //! @brief Determines if a slot contains a valid table.
+    //! @returns true if the slot's CRC and key match.
+    bool isValid(size_t slot  //!< [in] Index of the slot.
+    ) const;
+
+    //! @brief Returns the persistent bytes stored in a slot.
+    //! @returns a pointer to the slot's bytes within the image.
+    uint8_t* slotData(size_t slot  //!< [in] Index of the slot.
+    ) {
+        return &this->slotStart(slot)[SLOT_HEADER_BYTES];
+    }
+
+    //! @brief Updates the CRC of a slot, and writes the slot to the file.
+    //! @returns true if the slot was written.
+    bool writeSlot(size_t slot  //!< [in] Index of the slot.
+    );
+
+ private:
+    //! @brief Rounds a size up to a multiple of SLOT_ALIGN.
+    //! @returns the rounded size.
+    static constexpr size_t align(size_t numBytes  //!< [in] Size to round up.
+    ) {
+        return (numBytes + SLOT_ALIGN - 1) / SLOT_ALIGN * SLOT_ALIGN;
+    }
+
+    //! @brief Returns the start of a slot within the image.
+    //! @returns a pointer to the slot's header.
+    uint8_t* slotStart(size_t slot  //!< [in] Index of the slot.
+    ) const {
+        return &this->m_image[slotsOffset(this->m_numSlots) + slot * this->m_slotBytes];
+    }
+
+    //! @brief Returns the index entry for a slot within the image.
+    //! @returns a pointer to the index entry.
+    uint8_t* indexEntry(size_t slot  //!< [in] Index of the slot.
+    ) const {
+        return &this->m_image[HEADER_BYTES + slot * INDEX_ENTRY_BYTES];
+    }
+
+    //! @brief Index entry flag indicating that the slot has been assigned to a key.
+    static constexpr uint32_t IN_USE = 0x01;
+
+    char const* m_fileName;    //!< Name of the container file.
+    const size_t m_numSlots;   //!< Number of slots.
+    const size_t m_slotBytes;  //!< Number of bytes in each slot.
+    uint8_t* const m_image;    //!< Contents of the file.
+    int m_fd = -1;             //!< Container file, or -1 if not open.
+};
+
+//! @brief Control table storage which uses one slot of a ContainerStorage.
+//! @details The slot is found (or assigned) using the key on first use. save() only
+//!          updates the image, and commit() writes the whole slot with a single write.
+class ContainerSlot : public IControlTableStorage {
+ public:
+    //! @brief Constructor.
+    ContainerSlot(
+        ContainerStorage& container,  //!< [in] Container holding the slot.
+        uint32_t key                  //!< [in] Key identifying the slot (e.g. device ID).
+    );
+
+    //! @brief Returns the key passed to the constructor.
+    //! @returns the key.
+    uint32_t key() const { return this->m_key; }
+
+    Error load(OffsetType offset, SizeType numBytes, void* data) override;
+    Error save(OffsetType offset, SizeType numBytes, const void* data) override;
+    Error commit() override;
+
+ private:
+    ContainerStorage& m_container;              //!< Container holding the slot.
+    const uint32_t m_key;                       //!< Key identifying the slot.
+    size_t m_slot = ContainerStorage::NO_SLOT;  //!< Index of the slot.
+    bool m_pending = false;                     //!< true if save() was called since commit().
+};
+
+}  // namespace bioloid
+
+//! @}
@@ -16,50 +16,341 @@
 
 #include "ControlTable.h"
 
+#include <algorithm>
+#include <cstring>
+
+#include "ControlTableObservers.h"
+#include "ControlTableSchema.h"
+#include "IndirectMap.h"
+#include "LayoutMigration.h"
+
 bioloid::IControlTable::IControlTable(
-    uint8_t numCtlBytes,
-    uint8_t numPersistentBytes,
+    SizeType numCtlBytes,
+    SizeType numPersistentBytes,
     uint8_t* ctlBytes,
     IControlTableStorage& storage,
-    IPort* port)
+    IPort* port,
+    const FieldSchema* schema)
     : m_numCtlBytes{numCtlBytes},
       m_numPersistentBytes{numPersistentBytes},
       m_ctlBytes{ctlBytes},
       m_storage{storage},
-      m_port{port} {
+      m_port{port},
+      m_schema{schema} {
     assert(this->m_ctlBytes != nullptr);
+    assert(this->m_numPersistentBytes <= MAX_PERSISTENT_BYTES);
+    assert(this->m_schema == nullptr || this->m_schema->numCtlBytes() == this->m_numCtlBytes);
+    assert(
+        this->m_schema == nullptr || this->m_schema->persistsPrefix(this->m_numPersistentBytes));
 }
 
 void bioloid::IControlTable::load() {
-    memset(this->m_ctlBytes, 0, this->m_numCtlBytes);
+    if (this->m_seqLock != nullptr) {
+        this->m_seqLock->writeBegin();
+    }
+    memset(
+        &this->m_ctlBytes[this->m_numPersistentBytes], 0,
+        this->m_numCtlBytes - this->m_numPersistentBytes);
     auto rc = this->m_storage.load(0, this->m_numPersistentBytes, &this->m_ctlBytes[0]);
+    if (this->m_seqLock != nullptr) {
+        this->m_seqLock->writeEnd();
+    }
     if (rc == IControlTableStorage::Error::NONE) {
+        this->clearDirty(0, this->m_numPersistentBytes);
+        if (this->m_indirect != nullptr) {
+            this->m_indirect->update(this->m_ctlBytes, this->m_numCtlBytes);
+        }
+        if (this->m_observers != nullptr) {
+            this->m_observers->notify(*this, 0, this->m_numCtlBytes);
+        }
         return;
     }
+    if (this->m_migrations != nullptr && this->migrate()) {
+        return;
+    }
+
+    this->setToInitialValues();
+}
+
+bool bioloid::IControlTable::migrate() {
+    uint16_t version;
+    uint8_t oldBytes[MAX_PERSISTENT_BYTES];
+    size_t numOldBytes;
+    if (this->m_storage.loadLayout(&version, oldBytes, sizeof(oldBytes), &numOldBytes) !=
+            IControlTableStorage::Error::NONE ||
+        version > this->m_migrations->version() ||
+        !this->m_migrations->canMigrate(version, numOldBytes) ||
+        this->m_numPersistentBytes != this->m_migrations->numBytes()) {
+        return false;
+    }
 
+    // Bytes which are new in the current layout keep their initial values, so the stored
+    // bytes are migrated over a copy of them.
     this->setToInitialValues();
+    uint8_t newBytes[MAX_PERSISTENT_BYTES];
+    memcpy(newBytes, this->m_ctlBytes, this->m_numPersistentBytes);
+    if (!this->m_migrations->migrate(
+            version, oldBytes, numOldBytes, newBytes, this->m_numPersistentBytes)) {
+        return false;
+    }
+
+    if (this->m_seqLock != nullptr) {
+        this->m_seqLock->writeBegin();
+    }
+    memcpy(this->m_ctlBytes, newBytes, this->m_numPersistentBytes);
+    if (this->m_seqLock != nullptr) {
+        this->m_seqLock->writeEnd();
+    }
+    this->modified(0, this->m_numPersistentBytes);
+    return true;
 }
 
 bioloid::IControlTableStorage::Error bioloid::IControlTable::save() {
-    return this->m_storage.save(0, this->m_numPersistentBytes, &this->m_ctlBytes[0]);
+    size_t numWords = (this->m_numPersistentBytes + DIRTY_WORD_BITS - 1) / DIRTY_WORD_BITS;
+    size_t idx = 0;
+    while (idx < this->m_numPersistentBytes) {
+        // Find the first dirty byte at or after idx.
+        size_t word = idx / DIRTY_WORD_BITS;
+        uint32_t bits = this->m_dirty[word] & (~uint32_t{0} << (idx % DIRTY_WORD_BITS));
+        while (bits == 0 && ++word < numWords) {
+            bits = this->m_dirty[word];
+        }
+        if (bits == 0) {
+            break;
+        }
+        size_t start = word * DIRTY_WORD_BITS + __builtin_ctz(bits);
+
+        // Find the first clean byte after start.
+        bits = ~this->m_dirty[word] & (~uint32_t{0} << (start % DIRTY_WORD_BITS));
+        while (bits == 0 && ++word < numWords) {
+            bits = ~this->m_dirty[word];
+        }
+        size_t end = bits == 0 ? this->m_numPersistentBytes
+                               : word * DIRTY_WORD_BITS + __builtin_ctz(bits);
+        if (end > this->m_numPersistentBytes) {
+            end = this->m_numPersistentBytes;
+        }
+
+        auto numBytes = static_cast<SizeType>(end - start);
+        auto offset = static_cast<Offset::Type>(start);
+        if (this->m_storage.save(offset, numBytes, &this->m_ctlBytes[start]) !=
+            IControlTableStorage::Error::NONE) {
+            // Committing now would publish a partially saved table, so nothing is committed
+            // and all of the spans stay marked as dirty, so that the next save retries them.
+            return IControlTableStorage::Error::FAILED;
+        }
+        idx = end;
+    }
+    if (this->m_storage.commit() != IControlTableStorage::Error::NONE) {
+        this->markDirty(0, this->m_numPersistentBytes);
+        return IControlTableStorage::Error::FAILED;
+    }
+    this->clearDirty(0, this->m_numPersistentBytes);
+    return IControlTableStorage::Error::NONE;
+}
+
+bool bioloid::IControlTable::isDirty() const {
+    for (auto bits : this->m_dirty) {
+        if (bits != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void bioloid::IControlTable::markDirty(Offset::Type offset, SizeType numBytes) {
+    size_t end = std::min<size_t>(offset + numBytes, this->m_numPersistentBytes);
+    for (size_t idx = offset; idx < end; idx++) {
+        this->m_dirty[idx / DIRTY_WORD_BITS] |= uint32_t{1} << (idx % DIRTY_WORD_BITS);
+    }
+    if (offset < end && this->m_saveScheduler != nullptr) {
+        this->m_saveScheduler->persistentModified();
+    }
+}
+
+void bioloid::IControlTable::clearDirty(Offset::Type offset, SizeType numBytes) {
+    size_t end = std::min<size_t>(offset + numBytes, this->m_numPersistentBytes);
+    for (size_t idx = offset; idx < end; idx++) {
+        this->m_dirty[idx / DIRTY_WORD_BITS] &= ~(uint32_t{1} << (idx % DIRTY_WORD_BITS));
+    }
+}
+
+bioloid::Error::Type bioloid::IControlTable::validateWrite(
+    Offset::Type offset,
+    SizeType numBytes,
+    const void* data) const {
+    if (offset + numBytes > this->m_numCtlBytes) {
+        return Error::RANGE;
+    }
+    if (this->m_schema == nullptr) {
+        return Error::NONE;
+    }
+    return this->m_schema->validateWrite(
+        offset, numBytes, static_cast<const uint8_t*>(data), this->m_ctlBytes);
 }
 
 void bioloid::IControlTable::setToInitialValues() {
-    memset(this->m_ctlBytes, 0, this->m_numCtlBytes);
+    if (this->m_seqLock != nullptr) {
+        this->m_seqLock->writeBegin();
+    }
+    if (this->m_schema != nullptr) {
+        memcpy(this->m_ctlBytes, this->m_schema->defaults(), this->m_numCtlBytes);
+    } else {
+        memset(this->m_ctlBytes, 0, this->m_numCtlBytes);
+        this->m_ctlBytes[Offset::ID] = DEFAULT_DEVICE_ID;
+        this->m_ctlBytes[Offset::BAUD] = DEFAULT_BAUD;
+        this->m_ctlBytes[Offset::RDT] = DEFAULT_RDT;
+    }
+    if (this->m_seqLock != nullptr) {
+        this->m_seqLock->writeEnd();
+    }
+
+    // The entire table changed, so everything is notified at once.
+    this->modified(0, this->m_numCtlBytes);
+}
+
+bioloid::Error::Type bioloid::IControlTable::read(
+    Offset::Type offset,
+    SizeType numBytes,
+    void* data) const {
+    if (offset + numBytes > this->m_numCtlBytes) {
+        return Error::RANGE;
+    }
+    auto readSegment = [this, data](Offset::Type src, SizeType bufOffset, SizeType len) {
+        this->countRead(src, len);
+        this->populate(src, len);
+        memcpy(static_cast<uint8_t*>(data) + bufOffset, &this->m_ctlBytes[src], len);
+        return true;
+    };
+    if (this->m_indirect != nullptr) {
+        this->m_indirect->forEachSegment(offset, numBytes, readSegment);
+    } else {
+        readSegment(offset, 0, numBytes);
+    }
+    return Error::NONE;
+}
+
+bioloid::Error::Type bioloid::IControlTable::readSnapshot(
+    Offset::Type offset,
+    SizeType numBytes,
+    void* data) const {
+    if (offset + numBytes > this->m_numCtlBytes) {
+        return Error::RANGE;
+    }
+    if (this->m_seqLock != nullptr) {
+        this->m_seqLock->read(&this->m_ctlBytes[offset], numBytes, data);
+    } else {
+        memcpy(data, &this->m_ctlBytes[offset], numBytes);
+    }
+    return Error::NONE;
+}
 
-    this->set(Offset::ID, DEFAULT_DEVICE_ID);
-    this->set(Offset::BAUD, DEFAULT_BAUD);
-    this->set(Offset::RDT, DEFAULT_RDT);
+bioloid::Error::Type bioloid::IControlTable::write(
+    Offset::Type offset,
+    const void* data,
+    SizeType numBytes) {
+    if (this->m_indirect == nullptr) {
+        if (auto err = this->validateWrite(offset, numBytes, data); err != Error::NONE) {
+            return err;
+        }
+        this->store(offset, data, numBytes);
+        return Error::NONE;
+    }
+
+    // Validate all of the segments before storing any of them.
+    if (offset + numBytes > this->m_numCtlBytes) {
+        return Error::RANGE;
+    }
+    auto bytes = static_cast<const uint8_t*>(data);
+    Error::Type err = Error::NONE;
+    this->m_indirect->forEachSegment(
+        offset, numBytes, [this, bytes, &err](Offset::Type dst, SizeType bufOffset, SizeType len) {
+            err = this->validateWrite(dst, len, bytes + bufOffset);
+            return err == Error::NONE;
+        });
+    if (err != Error::NONE) {
+        return err;
+    }
+
+    // The gather table is only rebuilt once every segment has been stored, so that all of
+    // the segments are stored using the same table that was used to validate them.
+    bool addrModified = false;
+    this->m_deferIndirect = true;
+    this->m_indirect->forEachSegment(
+        offset, numBytes,
+        [this, bytes, &addrModified](Offset::Type dst, SizeType bufOffset, SizeType len) {
+            this->store(dst, bytes + bufOffset, len);
+            addrModified |= overlaps(
+                dst, len, this->m_indirect->addrOffset(), this->m_indirect->addrBytes());
+            return true;
+        });
+    this->m_deferIndirect = false;
+    if (addrModified) {
+        this->m_indirect->update(this->m_ctlBytes, this->m_numCtlBytes);
+    }
+    return Error::NONE;
+}
+
+void bioloid::IControlTable::store(Offset::Type offset, const void* data, SizeType numBytes) {
+    if (this->m_seqLock != nullptr) {
+        this->m_seqLock->writeBegin();
+    }
+    memcpy(&this->m_ctlBytes[offset], data, numBytes);
+    if (this->m_seqLock != nullptr) {
+        this->m_seqLock->writeEnd();
+    }
+    this->countWrite(offset, numBytes);
+    this->modified(offset, numBytes);
+}
+
+void bioloid::IControlTable::indirect(IndirectMap* map) {
+    this->m_indirect = map;
+    if (this->m_indirect != nullptr) {
+        this->m_indirect->update(this->m_ctlBytes, this->m_numCtlBytes);
+    }
+}
+
+void bioloid::IControlTable::populate(Offset::Type offset, SizeType numBytes) const {
+    // populateEntry() may store freshly sampled values into the control table.
+    if (this->m_seqLock != nullptr) {
+        this->m_seqLock->writeBegin();
+        this->populateEntry(offset, numBytes);
+        this->m_seqLock->writeEnd();
+    } else {
+        this->populateEntry(offset, numBytes);
+    }
+}
+
+void bioloid::IControlTable::modified(Offset::Type offset, SizeType numBytes) {
+    if (offset < this->m_numPersistentBytes) {
+        this->markDirty(offset, numBytes);
+    }
+    if (this->m_indirect != nullptr && !this->m_deferIndirect &&
+        overlaps(offset, numBytes, this->m_indirect->addrOffset(), this->m_indirect->addrBytes())) {
+        this->m_indirect->update(this->m_ctlBytes, this->m_numCtlBytes);
+    }
+    this->entryModified(offset, numBytes);
+    if (this->m_observers != nullptr) {
+        this->m_observers->notify(*this, offset, numBytes);
+    }
+}
+
+void bioloid::IControlTable::sampled(Offset::Type offset, SizeType numBytes) const {
+    if (this->m_observers != nullptr) {
+        this->m_observers->notify(*this, offset, numBytes);
+    }
 }
 
-void bioloid::IControlTable::populateEntry(Offset::Type offset) const {
+void bioloid::IControlTable::populateEntry(Offset::Type offset, SizeType numBytes) const {
     // Currently nothing to do
     (void)offset;
+    (void)numBytes;
 }
 
-void bioloid::IControlTable::entryModified(Offset::Type offset) {
-    if (offset == Offset::BAUD) {
-        uint32_t val = this->get_u8(Offset::BAUD) + 1;
+void bioloid::IControlTable::entryModified(Offset::Type offset, SizeType numBytes) {
+    if (overlaps(offset, numBytes, Offset::BAUD)) {
+        // Read directly, so that this isn't counted as a read in the heatmap.
+        uint32_t val = this->m_ctlBytes[Offset::BAUD] + 1;
         uint32_t baudRate = 2'000'000 / val;
         this->m_port->setBaudRate(baudRate);
     }
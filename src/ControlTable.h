@@ -17,18 +17,46 @@
 #pragma once
 
 #include <cassert>
+#include <cstddef>
 #include <cstdint>
 #include <type_traits>
 
+#include "AccessHeatmap.h"
 #include "Port.h"
+#include "SeqLock.h"
 #include "Util.h"
 
+//! @brief Number of bits used to address the bytes within a control table (8 or 16).
+//! @details With the default of 8, offsets and lengths are stored in a single byte, which
+//!          limits a control table to 255 bytes. Defining this as 16 allows for larger
+//!          control tables, at the cost of 2-byte offsets and lengths everywhere.
+#if !defined(BIOLOID_CTL_ADDR_BITS)
+#define BIOLOID_CTL_ADDR_BITS 8
+#endif
+
+//! @brief Maximum number of persistent bytes that a control table can contain.
+//! @details This determines the size of the dirty bitmap kept by each control table.
+#if !defined(BIOLOID_CTL_MAX_PERSISTENT_BYTES)
+#if BIOLOID_CTL_ADDR_BITS == 8
+#define BIOLOID_CTL_MAX_PERSISTENT_BYTES 256
+#else
+#define BIOLOID_CTL_MAX_PERSISTENT_BYTES 1024
+#endif
+#endif
+
+static_assert(BIOLOID_CTL_ADDR_BITS == 8 || BIOLOID_CTL_ADDR_BITS == 16);
+static_assert(BIOLOID_CTL_MAX_PERSISTENT_BYTES % 32 == 0);
+
 //! @addtogroup bioloid
 //! @{
 
 namespace bioloid {
 
 class IControlTable;  // forward declartion.
+class FieldSchema;    // forward declartion.
+class IndirectMap;    // forward declartion.
+class LayoutMigrations;  // forward declartion.
+class ObserverRegistry;  // forward declartion.
 
 //! @brief Abstracts the storage method used for storing the control table data.
 //! @details Derived class could use EEPROM, flash, or evan a file to store the control data.
@@ -38,7 +66,10 @@ class IControlTableStorage {
     //! @details We can't use Offset::Type because it hasn't been declared yet, so we
     //!          create another typename with the same type, and static assert that
     //!           OffsetType and Offset::Type are the same.
-    using OffsetType = uint8_t;
+    using OffsetType = std::conditional_t<BIOLOID_CTL_ADDR_BITS == 8, uint8_t, uint16_t>;
+
+    //! @brief Type used to store the number of bytes in a range of the control table.
+    using SizeType = OffsetType;
 
     //! @brief Error code which indicates whether a storage operation was successful or not.
     enum class Error {
@@ -55,7 +86,7 @@ class IControlTableStorage {
     //! @returns Error::FAILED if an erroor occurred while loading the control table.
     virtual Error load(
         OffsetType offset,  //!< [in] offset of the first byte to load.
-        uint8_t numBytes,   //!< [in] Number of bytes to load.
+        SizeType numBytes,  //!< [in] Number of bytes to load.
         void* data          //!< [out] Place to store data loaded.
         ) = 0;
 
@@ -64,9 +95,52 @@ class IControlTableStorage {
     //! @returns Error::FAILED if an error occurred while saving the control table.
     virtual Error save(
         OffsetType offset,  //!< [in] offset of the first byte to save.
-        uint8_t numBytes,   //!< [in] Number of bytes to save.
+        SizeType numBytes,  //!< [in] Number of bytes to save.
         const void* data    //!< [in] Data to save.
         ) = 0;
+
+    //! @brief Makes the spans passed to save() durable.
+    //! @details IControlTable::save() calls this once after saving all of the modified
+    //!          spans, which allows storage that can only update the whole table at once
+    //!          to do so. The default implementation does nothing.
+    //! @returns Error::NONE if the saved spans were committed successfully.
+    //! @returns Error::FAILED if an error occurred while committing the saved spans.
+    virtual Error commit() { return Error::NONE; }
+
+    //! @brief Loads persistent bytes along with the layout version they were saved with.
+    //! @details IControlTable::load() calls this when load() fails and the control table has
+    //!          LayoutMigrations, so that bytes saved using an older layout can be migrated.
+    //!          Only storage which records the layout version (such as SafeFileStorage)
+    //!          implements this. The default implementation always fails.
+    //! @returns Error::NONE if the stored bytes were loaded.
+    //! @returns Error::FAILED if nothing valid is stored, or it doesn't fit in maxBytes.
+    virtual Error loadLayout(
+        uint16_t* layoutVersion,  //!< [out] Layout version of the stored bytes.
+        void* data,               //!< [out] Place to store the bytes.
+        size_t maxBytes,          //!< [in] Size of data, in bytes.
+        size_t* numBytes          //!< [out] Number of bytes stored.
+    ) {
+        (void)layoutVersion;
+        (void)data;
+        (void)maxBytes;
+        (void)numBytes;
+        return Error::FAILED;
+    }
+};
+
+//! @brief Notified whenever persistent bytes of a control table are modified.
+//! @details This allows the decision of when to call IControlTable::save() to be made
+//!          separately from the code which modifies the control table.
+class ISaveScheduler {
+ public:
+    //! @brief Destructor.
+    //! @details This class contains virtual methods, so a virtual destructor is declared.
+    virtual ~ISaveScheduler() = default;
+
+    //! @brief Called whenever one or more persistent bytes have been modified.
+    //! @details This is called from within IControlTable::set() and IControlTable::write(),
+    //!          so it should return quickly.
+    virtual void persistentModified() = 0;
 };
 
 //! @brief The ControlTable contains informaton in the status and opeatation of the device.
@@ -76,7 +150,7 @@ class IControlTable {
  public:
     //! @brief Offsets for common fields within control table.
     //! @details Devices can derive from this to add their own offsets.
-    struct Offset : public Bits<uint8_t> {
+    struct Offset : public Bits<IControlTableStorage::OffsetType> {
         static constexpr Type MODEL = 0x00;    //!< 2-byte Model Number LSB, MSB in 0x01
         static constexpr Type VERSION = 0x02;  //!< Firmware Version
         static constexpr Type ID = 0x03;       //!< Device ID
@@ -85,18 +159,21 @@ class IControlTable {
         static constexpr Type LED = 0x19;      //!< Status LED
     };
 
+    //! @brief Type used to store the number of bytes in a range of the control table.
+    using SizeType = IControlTableStorage::SizeType;
+
     static constexpr uint8_t DEFAULT_DEVICE_ID = 0x00;  //!< Initial device ID
     static constexpr uint8_t DEFAULT_BAUD = 0x01;       //!< Corresponds to 1 Mbit/sec
     static constexpr uint8_t DEFAULT_RDT = 250;         //!< Corresponds to 500 usec
 
     //! @brief Constructor.
     IControlTable(
-        uint8_t numCtlBytes,            //!< [in] Number of bytes in the control table.
-        uint8_t numPersistentBytes,     //!< [in] Number of persistent bytes.
-        uint8_t* ctlBytes,              //!< [in] Underlying memory used to store the control bytes.
-        IControlTableStorage& storage,  //!< [in] Class which actually persists the data.
-        IPort* port                     //!< [in] Port associated with the device.
-
+        SizeType numCtlBytes,                //!< [in] Number of bytes in the control table.
+        SizeType numPersistentBytes,         //!< [in] Number of persistent bytes.
+        uint8_t* ctlBytes,                   //!< [in] Memory used to store the control bytes.
+        IControlTableStorage& storage,       //!< [in] Class which actually persists the data.
+        IPort* port,                         //!< [in] Port associated with the device.
+        const FieldSchema* schema = nullptr  //!< [in] Describes the fields in the table.
     );
 
     //! @brief Destructor.
@@ -183,7 +260,8 @@ class IControlTable {
         static_assert(std::is_integral_v<T>);
         assert(offset + sizeof(T) <= this->m_numCtlBytes);
 
-        this->populateEntry(offset);
+        this->countRead(offset, sizeof(T));
+        this->populate(offset, sizeof(T));
         if constexpr (sizeof(T) == 1) {
             *val = static_cast<T>(this->m_ctlBytes[offset]);
         } else if constexpr (sizeof(T) == 2) {
@@ -211,55 +289,316 @@ class IControlTable {
         static_assert(std::is_integral_v<T>);
         assert(offset + sizeof(T) <= this->m_numCtlBytes);
 
+        if (this->m_seqLock != nullptr) {
+            this->m_seqLock->writeBegin();
+        }
+        uint8_t* bytes = &this->m_ctlBytes[offset];
         if constexpr (sizeof(T) == 1) {
-            this->m_ctlBytes[offset] = static_cast<T>(val);
+            bytes[0] = static_cast<T>(val);
         } else if constexpr (sizeof(T) == 2) {
-            this->m_ctlBytes[offset++] = val & 0xff;
+            bytes[0] = val & 0xff;
             val >>= 8;
-            this->m_ctlBytes[offset++] = val & 0xff;
+            bytes[1] = val & 0xff;
         } else {
-            this->m_ctlBytes[offset++] = val & 0xff;
+            bytes[0] = val & 0xff;
             for (uint_fast8_t i = 1; i < sizeof(T); i++) {
                 val >>= 8;
-                this->m_ctlBytes[offset++] = val & 0xff;
+                bytes[i] = val & 0xff;
             }
         }
-        this->entryModified(offset);
+        if (this->m_seqLock != nullptr) {
+            this->m_seqLock->writeEnd();
+        }
+        this->countWrite(offset, sizeof(T));
+        this->modified(offset, sizeof(T));
     }
 
+    //! @brief Reads a range of bytes from the control table.
+    //! @details This is what a READ instruction uses. The bounds are checked once and
+    //!          populateEntry() is called once for the entire range.
+    //! @returns Error::NONE if the data was read successfully.
+    //! @returns Error::RANGE if the range extends past the end of the control table.
+    Error::Type read(
+        Offset::Type offset,  //!< [in] Offset of the first byte to read.
+        SizeType numBytes,    //!< [in] Number of bytes to read.
+        void* data            //!< [out] Place to store the data read.
+    ) const;
+
+    //! @brief Copies a consistent snapshot of a range of bytes from the control table.
+    //! @details This is intended to be called from threads other than the one which
+    //!          processes packets. It doesn't call populateEntry(), and if a SeqLock has
+    //!          been attached using seqLock(), the copy is retried until it wasn't torn by a
+    //!          concurrent modification. Without a SeqLock, this is a plain copy.
+    //! @returns Error::NONE if the data was read successfully.
+    //! @returns Error::RANGE if the range extends past the end of the control table.
+    Error::Type readSnapshot(
+        Offset::Type offset,  //!< [in] Offset of the first byte to read.
+        SizeType numBytes,    //!< [in] Number of bytes to read.
+        void* data            //!< [out] Place to store the data read.
+    ) const;
+
+    //! @brief Writes a range of bytes to the control table.
+    //! @details This is what a WRITE instruction uses. The data is validated using
+    //!          validateWrite() before the control table is modified, and entryModified()
+    //!          is called once for the entire range.
+    //! @returns Error::NONE if the data was written successfully.
+    //! @returns the error from validateWrite() if the data was rejected.
+    Error::Type write(
+        Offset::Type offset,  //!< [in] Offset of the first byte to write.
+        const void* data,     //!< [in] Data to write.
+        SizeType numBytes     //!< [in] Number of bytes to write.
+    );
+
     //! @brief Sets the initial values of the control table.
-    //! @details This is done anytime
+    //! @details If the control table has a FieldSchema, then the table is copied from the
+    //!          default image built from FieldDesc::defaultValue at compile time. Otherwise
+    //!          the table is cleared and the ID, BAUD and RDT fields are set to their
+    //!          defaults. Either way, modified() is called once for the entire table.
     virtual void setToInitialValues();
 
     //! @brief Loads the control table from storage.
     //! @details If loading from storage fails, then the control table will be set to
     //!          its initial valie using setToInitialValue()
+    //!
+    //!          If the control table has LayoutMigrations and the storage holds bytes saved
+    //!          using an older layout version, the table is set to its initial values and
+    //!          the stored bytes are then migrated over it, so values such as calibration
+    //!          survive a change of layout. All of the persistent bytes are marked as
+    //!          modified, so that the next save() stores them using the current layout.
+    //!          Bytes saved using a newer layout, or which fail to migrate, are rejected
+    //!          and the table is set to its initial values, just as when nothing is stored.
+    //!          Every persistent byte is then modified, so the next save() writes a complete
+    //!          image using the current layout, which replaces the rejected bytes.
+    //!
+    //!          Only the non-persistent bytes are cleared before loading, so the persistent
+    //!          bytes may live in memory owned by the storage (see MappedFileStorage).
+    //!          Observers are notified once for the entire table.
     void load();
 
     //! @brief Saves the control table to storage.
+    //! @details Only the persistent bytes which have been modified since the last successful
+    //!          save are written, using one call to IControlTableStorage::save() for each
+    //!          contiguous span of modified bytes, followed by one call to
+    //!          IControlTableStorage::commit(). If saving a span fails, commit() isn't called
+    //!          and the modified bytes stay marked as modified, so that the next save retries
+    //!          them. If the commit fails, all of the persistent bytes are marked as modified.
     //! @returns IControlTableStorage::Error::NONE if the control table was saved successfully.
     //! @returns IControlTableStorage::Error::FAILED if the control table could not be saved.
     IControlTableStorage::Error save();
 
+    //! @brief Sets the object which decides when the control table should be saved.
+    void saveScheduler(ISaveScheduler* scheduler  //!< [in] Scheduler to notify (may be nullptr).
+    ) {
+        this->m_saveScheduler = scheduler;
+    }
+
+    //! @brief Sets the registry of observers to notify when the control table is modified.
+    void observers(ObserverRegistry* registry  //!< [in] Registry to notify (may be nullptr).
+    ) {
+        this->m_observers = registry;
+    }
+
+    //! @brief Attaches a sequence lock which is updated whenever the control table is modified.
+    //! @details This allows other threads to use readSnapshot() to retrieve consistent
+    //!          multi-byte values without blocking the thread which modifies the table.
+    void seqLock(SeqLock* lock  //!< [in] Sequence lock to use (may be nullptr).
+    ) {
+        this->m_seqLock = lock;
+    }
+
+#if BIOLOID_CTL_HEATMAP
+    //! @brief Attaches a heatmap which counts the accesses to each byte of the table.
+    void heatmap(AccessHeatmap* heatmap  //!< [in] Heatmap to update (may be nullptr).
+    ) {
+        assert(heatmap == nullptr || heatmap->numCtlBytes() == this->m_numCtlBytes);
+        this->m_heatmap = heatmap;
+    }
+
+    //! @brief Returns the heatmap attached to the control table.
+    //! @returns the heatmap, or nullptr if none is attached.
+    const AccessHeatmap* heatmap() const { return this->m_heatmap; }
+#endif
+
+    //! @brief Attaches a mapping which redirects reads and writes of a data window.
+    //! @details The gather table is rebuilt immediately, and again whenever the address
+    //!          region of the mapping is modified.
+    void indirect(IndirectMap* map  //!< [in] Mapping to use (may be nullptr).
+    );
+
+    //! @brief Sets the migrations used to load bytes saved using older layouts.
+    //! @details The storage must save the current layout version, LayoutMigrations::version().
+    void migrations(const LayoutMigrations* migrations  //!< [in] Migrations (may be nullptr).
+    ) {
+        this->m_migrations = migrations;
+    }
+
+    //! @brief Determines if any persistent bytes have been modified since the last save.
+    //! @returns true if save() has something to write.
+    bool isDirty() const;
+
+    //! @brief Checks whether data from a WRITE instruction may be written to the control table.
+    //! @details If the control table has a FieldSchema, then all of the bytes being written
+    //!          are validated against the schema, otherwise only the bounds are checked.
+    //!          The control table itself isn't modified.
+    //! @returns Error::NONE if the data may be written.
+    //! @returns Error::RANGE (or some other limit error) if the data may not be written.
+    Error::Type validateWrite(
+        Offset::Type offset,  //!< [in] Offset of the first byte to write.
+        SizeType numBytes,    //!< [in] Number of bytes to write.
+        const void* data      //!< [in] Data to be written.
+    ) const;
+
+    //! @brief Returns the schema describing the fields of the control table.
+    //! @returns a pointer to the schema, or nullptr if the control table doesn't have one.
+    const FieldSchema* schema() const { return this->m_schema; }
+
+    //! @brief Returns the number of bytes in the control table.
+    //! @returns the number of bytes in the control table.
+    SizeType numCtlBytes() const { return this->m_numCtlBytes; }
+
+    //! @brief Returns the number of persistent bytes in the control table.
+    //! @returns the number of persistent bytes.
+    SizeType numPersistentBytes() const { return this->m_numPersistentBytes; }
+
     //! @brief Returns a pointer to the underlying control bytes.
     //! @returns a pointer to the underlying control bytes.
     const uint8_t* ctlBytes() const { return this->m_ctlBytes; }
 
+    //! @brief Determines if a range of bytes overlaps a field.
+    //! @returns true if any byte of the field lies within the range.
+    static constexpr bool overlaps(
+        Offset::Type offset,       //!< [in] Offset of the first byte in the range.
+        SizeType numBytes,         //!< [in] Number of bytes in the range.
+        Offset::Type fieldOffset,  //!< [in] Offset of the field.
+        SizeType fieldBytes = 1    //!< [in] Size of the field, in bytes.
+    ) {
+        return fieldOffset < offset + numBytes && offset < fieldOffset + fieldBytes;
+    }
+
  protected:
-    //! @brief Called to populate a control table entry just before retrieving its value.
+    //! @brief Called to populate control table entries just before retrieving their values.
+    //! @details This is called once for each get() or read(), and covers all of the bytes
+    //!          being retrieved, which may span several fields. Values stored here bypass
+    //!          set(), so implementations should call sampled() for the bytes they store.
     virtual void populateEntry(
-        Offset::Type offset  //!< [in] Offset of the field that is being retrieved.
+        Offset::Type offset,  //!< [in] Offset of the first byte being retrieved.
+        SizeType numBytes     //!< [in] Number of bytes being retrieved.
+    ) const;
+
+    //! @brief Called whenever control table entries are modified.
+    //! @details This is called once for each set() or write(), and covers all of the bytes
+    //!          which were modified, which may span several fields.
+    virtual void entryModified(
+        Offset::Type offset,  //!< [in] Offset of the first byte that was modified.
+        SizeType numBytes     //!< [in] Number of bytes that were modified.
+    );
+
+    //! @brief Notifies observers of sampled values stored by populateEntry().
+    //! @details This lets observers (such as a ChangeJournal) see sampled fields. The bytes
+    //!          aren't marked as dirty and entryModified() isn't called, since the values
+    //!          came from the device rather than from the master.
+    void sampled(
+        Offset::Type offset,  //!< [in] Offset of the first byte stored.
+        SizeType numBytes     //!< [in] Number of bytes stored.
     ) const;
 
-    //! @brief Called whenever one of the control table entries is modified.
-    virtual void entryModified(Offset::Type offset  //!< [in] Offset of the field that was modified.
+    //! @brief Calls populateEntry(), holding the sequence lock for writing (if attached).
+    void populate(
+        Offset::Type offset,  //!< [in] Offset of the first byte being retrieved.
+        SizeType numBytes     //!< [in] Number of bytes being retrieved.
+    ) const;
+
+    //! @brief Counts a read in the heatmap (only when BIOLOID_CTL_HEATMAP is enabled).
+    void countRead(
+        Offset::Type offset,  //!< [in] Offset of the first byte read.
+        SizeType numBytes     //!< [in] Number of bytes read.
+    ) const {
+#if BIOLOID_CTL_HEATMAP
+        if (this->m_heatmap != nullptr) {
+            this->m_heatmap->recordRead(offset, numBytes);
+        }
+#else
+        (void)offset;
+        (void)numBytes;
+#endif
+    }
+
+    //! @brief Counts a write in the heatmap (only when BIOLOID_CTL_HEATMAP is enabled).
+    void countWrite(
+        Offset::Type offset,  //!< [in] Offset of the first byte written.
+        SizeType numBytes     //!< [in] Number of bytes written.
+    ) {
+#if BIOLOID_CTL_HEATMAP
+        if (this->m_heatmap != nullptr) {
+            this->m_heatmap->recordWrite(offset, numBytes);
+        }
+#else
+        (void)offset;
+        (void)numBytes;
+#endif
+    }
+
+    //! @brief Stores bytes into the control table, without validating them.
+    //! @details This holds the sequence lock (if attached) while copying, and then calls
+    //!          modified().
+    void store(
+        Offset::Type offset,  //!< [in] Offset of the first byte to store.
+        const void* data,     //!< [in] Data to store.
+        SizeType numBytes     //!< [in] Number of bytes to store.
+    );
+
+    //! @brief Performs all of the bookkeeping needed after control table bytes are modified.
+    //! @details Marks persistent bytes as dirty, calls entryModified() and notifies any
+    //!          observers. set() and write() call this once for all of the bytes modified.
+    void modified(
+        Offset::Type offset,  //!< [in] Offset of the first modified byte.
+        SizeType numBytes     //!< [in] Number of modified bytes.
+    );
+
+    //! @brief Migrates bytes saved using an older layout into the control table.
+    //! @returns true if the control table was migrated.
+    //! @returns false if nothing could be migrated, in which case load() sets the control
+    //!          table to its initial values.
+    bool migrate();
+
+    //! @brief Marks persistent bytes as needing to be saved.
+    //! @details Any bytes beyond the persistent portion of the control table are ignored.
+    void markDirty(
+        Offset::Type offset,  //!< [in] Offset of the first modified byte.
+        SizeType numBytes     //!< [in] Number of modified bytes.
+    );
+
+    //! @brief Marks persistent bytes as having been saved.
+    void clearDirty(
+        Offset::Type offset,  //!< [in] Offset of the first saved byte.
+        SizeType numBytes     //!< [in] Number of saved bytes.
     );
 
-    const uint8_t m_numCtlBytes;         //!< Number of bytes in the control table.
-    const uint8_t m_numPersistentBytes;  //!< Number of persistent bytes.
-    uint8_t* const m_ctlBytes;           //!< Pointer to the actual control bytes.
-    IControlTableStorage& m_storage;     //!< Object which actually persists the control table.
-    IPort* m_port;                       //!< Port associated with the device.
+    //! Maximum number of persistent bytes that a control table can contain.
+    static constexpr size_t MAX_PERSISTENT_BYTES = BIOLOID_CTL_MAX_PERSISTENT_BYTES;
+
+    //! Number of bits in each word of m_dirty.
+    static constexpr size_t DIRTY_WORD_BITS = 32;
+
+    const SizeType m_numCtlBytes;         //!< Number of bytes in the control table.
+    const SizeType m_numPersistentBytes;  //!< Number of persistent bytes.
+    uint8_t* const m_ctlBytes;            //!< Pointer to the actual control bytes.
+    IControlTableStorage& m_storage;      //!< Object which actually persists the control table.
+    IPort* m_port;                        //!< Port associated with the device.
+    const FieldSchema* m_schema;          //!< Describes the fields (may be nullptr).
+
+    ISaveScheduler* m_saveScheduler = nullptr;       //!< Notified when persistent bytes change.
+    ObserverRegistry* m_observers = nullptr;         //!< Notified when any bytes change.
+    SeqLock* m_seqLock = nullptr;                    //!< Updated when any bytes change.
+    IndirectMap* m_indirect = nullptr;               //!< Redirects accesses to the data window.
+    bool m_deferIndirect = false;                    //!< true while write() stores segments.
+    const LayoutMigrations* m_migrations = nullptr;  //!< Migrates older layouts on load.
+#if BIOLOID_CTL_HEATMAP
+    AccessHeatmap* m_heatmap = nullptr;              //!< Counts accesses to each byte.
+#endif
+
+    //! One bit for each persistent byte which has been modified since the last save.
+    uint32_t m_dirty[MAX_PERSISTENT_BYTES / DIRTY_WORD_BITS] = {};
 };
 
 static_assert(std::is_same_v<IControlTableStorage::OffsetType, IControlTable::Offset::Type>);
@@ -0,0 +1,95 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   ControlTableDiff.cpp
+ *
+ *   @brief  Captures snapshots of a control table and finds what changed between them.
+ *
+ ****************************************************************************/
+
+#include "ControlTableDiff.h"
+
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+//! @brief Finds the first byte at or after idx which differs between two snapshots.
+//! @returns the offset of the first differing byte, or numBytes if there isn't one.
+static size_t findDifference(
+    const uint8_t* prev,
+    const uint8_t* curr,
+    size_t idx,
+    size_t numBytes) {
+#if defined(__SSE2__)
+    for (; idx + 16 <= numBytes; idx += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&prev[idx]));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&curr[idx]));
+        auto equal = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)));
+        if (equal != 0xFFFF) {
+            return idx + __builtin_ctz(~equal);
+        }
+    }
+#endif
+    for (; idx + sizeof(uint64_t) <= numBytes; idx += sizeof(uint64_t)) {
+        uint64_t a;
+        uint64_t b;
+        memcpy(&a, &prev[idx], sizeof(a));
+        memcpy(&b, &curr[idx], sizeof(b));
+        if (a != b) {
+            break;
+        }
+    }
+    for (; idx < numBytes; idx++) {
+        if (prev[idx] != curr[idx]) {
+            break;
+        }
+    }
+    return idx;
+}
+
+bioloid::Error::Type bioloid::captureSnapshot(
+    const IControlTable& ctlTable,
+    uint8_t* snapshot,
+    size_t snapshotSize) {
+    if (snapshotSize < ctlTable.numCtlBytes()) {
+        return Error::RANGE;
+    }
+    return ctlTable.readSnapshot(0, ctlTable.numCtlBytes(), snapshot);
+}
+
+size_t bioloid::diffSnapshots(
+    const uint8_t* prev,
+    const uint8_t* curr,
+    size_t numBytes,
+    ChangedRun* runs,
+    size_t maxRuns) {
+    size_t numRuns = 0;
+    size_t idx = findDifference(prev, curr, 0, numBytes);
+    while (idx < numBytes && maxRuns > 0) {
+        // Changed runs are normally short, so they're scanned a byte at a time.
+        size_t end = idx + 1;
+        while (end < numBytes && prev[end] != curr[end]) {
+            end++;
+        }
+        if (numRuns < maxRuns) {
+            runs[numRuns++] = {
+                static_cast<IControlTable::Offset::Type>(idx),
+                static_cast<IControlTable::SizeType>(end - idx)};
+        } else {
+            // Out of runs, so the last one grows to include this one.
+            ChangedRun& last = runs[numRuns - 1];
+            last.numBytes = static_cast<IControlTable::SizeType>(end - last.offset);
+        }
+        idx = findDifference(prev, curr, end, numBytes);
+    }
+    return numRuns;
+}
@@ -0,0 +1,69 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   ControlTableDiff.h
+ *
+ *   @brief  Captures snapshots of a control table and finds what changed between them.
+ *
+ ****************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Bioloid.h"
+#include "ControlTable.h"
+
+//! @addtogroup bioloid
+//! @{
+
+namespace bioloid {
+
+//! @brief A contiguous range of bytes which differ between two snapshots.
+struct ChangedRun {
+    IControlTable::Offset::Type offset;  //!< Offset of the first changed byte.
+    IControlTable::SizeType numBytes;    //!< Number of bytes in the run.
+
+    //! @brief Compares two runs.
+    //! @returns true if the runs are the same.
+    bool operator==(const ChangedRun& rhs) const {
+        return this->offset == rhs.offset && this->numBytes == rhs.numBytes;
+    }
+};
+
+//! @brief Copies the entire control table into a caller-provided buffer.
+//! @details The copy is made using IControlTable::readSnapshot(), so it's consistent if
+//!          the control table has a SeqLock attached.
+//! @returns Error::NONE if the snapshot was captured.
+//! @returns Error::RANGE if the buffer is smaller than the control table.
+Error::Type captureSnapshot(
+    const IControlTable& ctlTable,  //!< [in] Control table to capture.
+    uint8_t* snapshot,              //!< [out] Place to store the snapshot.
+    size_t snapshotSize             //!< [in] Size of the snapshot buffer, in bytes.
+);
+
+//! @brief Finds the runs of bytes which differ between two snapshots.
+//! @details Unchanged regions are skipped 16 bytes at a time using SSE2 (or 8 bytes at a
+//!          time without it), so the cost is mostly proportional to the amount of change.
+//!          If there are more than maxRuns runs, the last run is extended to cover all of
+//!          the remaining changes, so that applying the runs always reproduces `curr`.
+//! @returns the number of runs stored in `runs`.
+size_t diffSnapshots(
+    const uint8_t* prev,  //!< [in] Earlier snapshot.
+    const uint8_t* curr,  //!< [in] Later snapshot.
+    size_t numBytes,      //!< [in] Number of bytes in each snapshot.
+    ChangedRun* runs,     //!< [out] Place to store the changed runs.
+    size_t maxRuns        //!< [in] Maximum number of runs to store.
+);
+
+}  // namespace bioloid
+
+//! @}
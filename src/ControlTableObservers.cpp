@@ -0,0 +1,89 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   ControlTableObservers.cpp
+ *
+ *   @brief  Notifies application code when ranges of a control table change.
+ *
+ ****************************************************************************/
+
+#include "ControlTableObservers.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+bioloid::ObserverRegistry::ObserverRegistry(size_t numCtlBytes, Mask* masks)
+    : m_numCtlBytes{numCtlBytes}, m_masks{masks} {
+    assert(this->m_masks != nullptr);
+    memset(this->m_masks, 0, this->m_numCtlBytes * sizeof(Mask));
+}
+
+bool bioloid::ObserverRegistry::subscribe(
+    IControlTableObserver* observer,
+    IControlTable::Offset::Type offset,
+    IControlTable::SizeType numBytes) {
+    if (observer == nullptr || numBytes == 0 || offset + numBytes > this->m_numCtlBytes) {
+        return false;
+    }
+    Mask available = ~this->m_inUse;
+    if (available == 0) {
+        return false;
+    }
+    auto idx = static_cast<size_t>(__builtin_ctz(available));
+    Mask bit = Mask{1} << idx;
+
+    this->m_subscriptions[idx] = {observer, offset, numBytes};
+    this->m_inUse |= bit;
+    for (size_t byte = offset; byte < offset + numBytes; byte++) {
+        this->m_masks[byte] |= bit;
+    }
+    return true;
+}
+
+void bioloid::ObserverRegistry::unsubscribe(IControlTableObserver* observer) {
+    for (size_t idx = 0; idx < MAX_SUBSCRIPTIONS; idx++) {
+        Mask bit = Mask{1} << idx;
+        const Subscription& sub = this->m_subscriptions[idx];
+        if ((this->m_inUse & bit) == 0 || sub.observer != observer) {
+            continue;
+        }
+        for (size_t byte = sub.offset; byte < sub.offset + sub.numBytes; byte++) {
+            this->m_masks[byte] &= ~bit;
+        }
+        this->m_inUse &= ~bit;
+    }
+}
+
+void bioloid::ObserverRegistry::notify(
+    const IControlTable& ctlTable,
+    IControlTable::Offset::Type offset,
+    IControlTable::SizeType numBytes) const {
+    if (this->m_inUse == 0) {
+        return;
+    }
+    Mask interested = 0;
+    size_t end = std::min<size_t>(offset + numBytes, this->m_numCtlBytes);
+    for (size_t byte = offset; byte < end; byte++) {
+        interested |= this->m_masks[byte];
+    }
+    while (interested != 0) {
+        auto idx = static_cast<size_t>(__builtin_ctz(interested));
+        interested &= interested - 1;
+
+        // Only report the portion of the modification which the observer asked for.
+        const Subscription& sub = this->m_subscriptions[idx];
+        size_t first = std::max<size_t>(offset, sub.offset);
+        size_t last = std::min<size_t>(end, sub.offset + sub.numBytes);
+        sub.observer->entriesChanged(
+            ctlTable, static_cast<IControlTable::Offset::Type>(first),
+            static_cast<IControlTable::SizeType>(last - first));
+    }
+}
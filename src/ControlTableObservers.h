@@ -0,0 +1,104 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   ControlTableObservers.h
+ *
+ *   @brief  Notifies application code when ranges of a control table change.
+ *
+ ****************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "ControlTable.h"
+
+//! @addtogroup bioloid
+//! @{
+
+namespace bioloid {
+
+//! @brief Interface for classes which want to be told when control table fields change.
+class IControlTableObserver {
+ public:
+    //! @brief Destructor.
+    //! @details This class contains virtual methods, so a virtual destructor is declared.
+    virtual ~IControlTableObserver() = default;
+
+    //! @brief Called when bytes within a subscribed range have been modified.
+    //! @details This is called once per set() or write(), and only covers the portion of
+    //!          the modification which overlaps the subscribed range.
+    virtual void entriesChanged(
+        const IControlTable& ctlTable,       //!< [in] Control table which was modified.
+        IControlTable::Offset::Type offset,  //!< [in] Offset of the first modified byte.
+        IControlTable::SizeType numBytes     //!< [in] Number of modified bytes.
+        ) = 0;
+};
+
+//! @brief Keeps track of which observers are interested in which control table bytes.
+//! @details Each subscription is assigned a bit, and a per-offset mask records which
+//!          subscriptions cover each byte of the control table, so finding the observers
+//!          interested in a modification only needs the masks of the bytes modified.
+class ObserverRegistry {
+ public:
+    //! Type used for the per-offset masks.
+    using Mask = uint32_t;
+
+    //! Maximum number of subscriptions which can be registered.
+    static constexpr size_t MAX_SUBSCRIPTIONS = sizeof(Mask) * 8;
+
+    //! @brief Constructor.
+    ObserverRegistry(
+        size_t numCtlBytes,  //!< [in] Number of bytes in the control table.
+        Mask* masks          //!< [in] Storage for one Mask per control table byte.
+    );
+
+    //! @brief Subscribes an observer to a range of control table bytes.
+    //! @details An observer may subscribe to more than one range, in which case it will be
+    //!          notified once for each subscribed range which is modified.
+    //! @returns true if the subscription was registered.
+    //! @returns false if the range is invalid or all of the subscriptions are in use.
+    bool subscribe(
+        IControlTableObserver* observer,     //!< [in] Observer to notify.
+        IControlTable::Offset::Type offset,  //!< [in] Offset of the first byte to observe.
+        IControlTable::SizeType numBytes     //!< [in] Number of bytes to observe.
+    );
+
+    //! @brief Removes all of the subscriptions for an observer.
+    void unsubscribe(IControlTableObserver* observer  //!< [in] Observer to remove.
+    );
+
+    //! @brief Notifies the observers interested in a modification.
+    void notify(
+        const IControlTable& ctlTable,       //!< [in] Control table which was modified.
+        IControlTable::Offset::Type offset,  //!< [in] Offset of the first modified byte.
+        IControlTable::SizeType numBytes     //!< [in] Number of modified bytes.
+    ) const;
+
+ private:
+    //! @brief A range of bytes that an observer is interested in.
+    struct Subscription {
+        IControlTableObserver* observer;     //!< Observer to notify.
+        IControlTable::Offset::Type offset;  //!< Offset of the first byte observed.
+        IControlTable::SizeType numBytes;    //!< Number of bytes observed.
+    };
+
+    const size_t m_numCtlBytes;  //!< Number of bytes in the control table.
+    Mask* const m_masks;         //!< Subscriptions covering each byte.
+    Mask m_inUse = 0;            //!< Subscriptions which are in use.
+
+    //! Registered subscriptions, indexed by bit number.
+    Subscription m_subscriptions[MAX_SUBSCRIPTIONS] = {};
+};
+
+}  // namespace bioloid
+
+//! @}
@@ -0,0 +1,76 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   ControlTableSchema.cpp
+ *
+ *   @brief  Describes the fields contained in a control table.
+ *
+ ****************************************************************************/
+
+#include "ControlTableSchema.h"
+
+bioloid::Error::Type bioloid::FieldSchema::validateWrite(
+    IControlTable::Offset::Type offset,
+    size_t numBytes,
+    const uint8_t* data,
+    const uint8_t* ctlBytes) const {
+    size_t end = offset + numBytes;
+    if (end > this->m_numCtlBytes) {
+        return Error::RANGE;
+    }
+
+    Error::Type err = Error::NONE;
+    size_t idx = offset;
+    while (idx < end) {
+        ByteFlags::Type flags = this->m_byteFlags[idx];
+        if ((flags & ByteFlags::WRITABLE) == 0) {
+            err |= Error::RANGE;
+            idx++;
+            continue;
+        }
+
+        // Every byte of a field shares the same flags, so the whole field is dealt with
+        // at once and we skip to the first byte after the field.
+        const FieldDesc& field = this->m_fields[this->m_byteField[idx]];
+        size_t fieldEnd = field.offset + field.numBytes;
+        if ((flags & ByteFlags::LIMITED) != 0) {
+            // Assemble the little endian value using the new data for the bytes being
+            // written, and the current table contents for the remainder.
+            uint64_t uval = 0;
+            for (size_t byte = fieldEnd; byte > field.offset; byte--) {
+                size_t i = byte - 1;
+                uval <<= 8;
+                uval |= (i >= offset && i < end) ? data[i - offset] : ctlBytes[i];
+            }
+            int64_t val = static_cast<int64_t>(uval);
+            if ((field.flags & FieldDesc::Flags::SIGNED) != 0 && field.numBytes < sizeof(uval)) {
+                uint64_t signBit = uint64_t{1} << (field.numBytes * 8 - 1);
+                val = static_cast<int64_t>((uval ^ signBit) - signBit);
+            }
+            if (val < field.minValue || val > field.maxValue) {
+                err |= field.limitError;
+            }
+        }
+        idx = fieldEnd;
+    }
+    return err;
+}
+
+bool bioloid::FieldSchema::persistsPrefix(size_t numPersistentBytes) const {
+    for (size_t idx = 0; idx < this->m_numFields; idx++) {
+        const FieldDesc& field = this->m_fields[idx];
+        bool persistent = (field.flags & FieldDesc::Flags::PERSISTENT) != 0;
+        if (persistent ? field.offset + field.numBytes > numPersistentBytes
+                       : field.offset < numPersistentBytes) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,226 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   ControlTableSchema.h
+ *
+ *   @brief  Describes the fields contained in a control table.
+ *
+ ****************************************************************************/
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include "Bioloid.h"
+#include "ControlTable.h"
+
+//! @addtogroup bioloid
+//! @{
+
+namespace bioloid {
+
+//! @brief Describes a single field within a control table.
+//! @details Fields are normally declared in a constexpr array, one entry per field:
+//! @code
+//!     static constexpr FieldDesc FIELDS[] = {
+//!         // offset        size  flags                 min  max   error         default
+//!         {Offset::ID,     1,    FieldDesc::RW_PERSIST, 0,   0xFD, Error::RANGE, 1},
+//!         {Offset::LED,    1,    FieldDesc::WRITABLE,   0,   1},
+//!     };
+//! @endcode
+//! A field whose maxValue is less than its minValue has no limits.
+struct FieldDesc {
+    //! @brief Flags describing how a field may be accessed.
+    struct Flags : public Bits<uint8_t> {
+        static constexpr Type READ_ONLY = 0x00;   //!< Field can't be written by a WRITE.
+        static constexpr Type WRITABLE = 0x01;    //!< Field can be written by a WRITE.
+        static constexpr Type PERSISTENT = 0x02;  //!< Field is saved to storage.
+        static constexpr Type SIGNED = 0x04;      //!< Field contains a signed value.
+    };
+
+    //! Convenience alias for a writable field which is also persisted.
+    static constexpr Flags::Type RW_PERSIST = Flags::WRITABLE | Flags::PERSISTENT;
+
+    //! Convenience alias for a read-only field which is also persisted.
+    static constexpr Flags::Type RO_PERSIST = Flags::READ_ONLY | Flags::PERSISTENT;
+
+    //! Convenience alias for a writable field.
+    static constexpr Flags::Type WRITABLE = Flags::WRITABLE;
+
+    //! Convenience alias for a read-only field.
+    static constexpr Flags::Type READ_ONLY = Flags::READ_ONLY;
+
+    IControlTable::Offset::Type offset;     //!< Offset of the field within the control table.
+    uint8_t numBytes;                       //!< Size of the field, in bytes.
+    Flags::Type flags = Flags::READ_ONLY;   //!< Access flags.
+    int64_t minValue = 0;                   //!< Minimum value which may be written.
+    int64_t maxValue = -1;                  //!< Maximum value which may be written.
+    Error::Type limitError = Error::RANGE;  //!< Error reported when a limit is exceeded.
+    int64_t defaultValue = 0;               //!< Value used by IControlTable::setToInitialValues.
+
+    //! @brief Determines if the field has limits which need to be checked.
+    //! @returns true if the field has a minimum and maximum value.
+    constexpr bool hasLimits() const { return this->maxValue >= this->minValue; }
+};
+
+//! @brief Flags stored in the per-byte lookup array of a FieldTable.
+struct ByteFlags : public Bits<uint8_t> {
+    static constexpr Type WRITABLE = FieldDesc::Flags::WRITABLE;      //!< Byte is writable.
+    static constexpr Type PERSISTENT = FieldDesc::Flags::PERSISTENT;  //!< Byte is persisted.
+    static constexpr Type LIMITED = 0x40;   //!< Byte belongs to a field with limits.
+    static constexpr Type IN_FIELD = 0x80;  //!< Byte belongs to a field.
+};
+
+class FieldSchema;  // forward declaration.
+
+//! @brief Precomputed per-byte lookup arrays for a constexpr array of FieldDesc.
+//! @details This is intended to be constructed as a static constexpr member of a control
+//!          table, so that all of the lookup arrays (and the image of the default values)
+//!          wind up in read-only memory.
+//! @tparam NUM_CTL_BYTES - total number of bytes in the control table.
+//! @tparam NUM_FIELDS - number of fields described.
+template <size_t NUM_CTL_BYTES, size_t NUM_FIELDS>
+class FieldTable {
+ public:
+    //! @brief Constructor.
+    constexpr FieldTable(const FieldDesc (&fields)[NUM_FIELDS]  //!< [in] Fields to describe.
+                         )
+        : m_fields{}, m_byteFlags{}, m_byteField{}, m_defaults{} {
+        static_assert(NUM_FIELDS < 0xff);
+        for (size_t idx = 0; idx < NUM_FIELDS; idx++) {
+            const FieldDesc& field = fields[idx];
+            assert(field.numBytes > 0);
+            assert(field.offset + field.numBytes <= NUM_CTL_BYTES);
+            assert(!field.hasLimits() ||
+                   (field.defaultValue >= field.minValue && field.defaultValue <= field.maxValue));
+
+            ByteFlags::Type flags = ByteFlags::IN_FIELD |
+                                    (field.flags & (ByteFlags::WRITABLE | ByteFlags::PERSISTENT));
+            if (field.hasLimits()) {
+                flags |= ByteFlags::LIMITED;
+            }
+            this->m_fields[idx] = field;
+            for (size_t byte = field.offset; byte < field.offset + field.numBytes; byte++) {
+                // Fields aren't allowed to overlap.
+                assert(this->m_byteFlags[byte] == 0);
+                this->m_byteFlags[byte] = flags;
+                this->m_byteField[byte] = static_cast<uint8_t>(idx);
+
+                // Default values are stored in little endian byte order.
+                size_t shift = 8 * (byte - field.offset);
+                this->m_defaults[byte] =
+                    static_cast<uint8_t>(static_cast<uint64_t>(field.defaultValue) >> shift);
+            }
+        }
+    }
+
+    //! @brief Returns the descriptor for a field.
+    //! @returns a reference to the indicated field descriptor.
+    constexpr const FieldDesc& field(size_t idx  //!< [in] Index of the field to return.
+    ) const {
+        return this->m_fields[idx];
+    }
+
+ private:
+    friend class FieldSchema;
+
+    FieldDesc m_fields[NUM_FIELDS];      //!< Copy of the field descriptors.
+    uint8_t m_byteFlags[NUM_CTL_BYTES];  //!< ByteFlags for each byte of the control table.
+    uint8_t m_byteField[NUM_CTL_BYTES];  //!< Index of the field each byte belongs to.
+    uint8_t m_defaults[NUM_CTL_BYTES];   //!< Default value of each byte of the control table.
+};
+
+//! @brief Describes all of the fields within a control table.
+//! @details A FieldSchema is a non-templated view onto a FieldTable, which allows
+//!          IControlTable to use it without knowing its size at compile time.
+//! @code
+//!     static constexpr FieldDesc FIELDS[] = { ... };
+//!     static constexpr FieldTable<NUM_CTL_BYTES, LEN(FIELDS)> FIELD_TABLE{FIELDS};
+//!     static constexpr FieldSchema SCHEMA{FIELD_TABLE};
+//! @endcode
+class FieldSchema {
+ public:
+    //! @brief Constructor.
+    template <size_t NUM_CTL_BYTES, size_t NUM_FIELDS>
+    constexpr FieldSchema(const FieldTable<NUM_CTL_BYTES, NUM_FIELDS>& table  //!< [in] Fields.
+                          )
+        : m_numCtlBytes{NUM_CTL_BYTES},
+          m_numFields{NUM_FIELDS},
+          m_fields{table.m_fields},
+          m_byteFlags{table.m_byteFlags},
+          m_byteField{table.m_byteField},
+          m_defaults{table.m_defaults} {}
+
+    //! @brief Returns the number of bytes in the control table described by this schema.
+    //! @returns the number of bytes in the control table.
+    constexpr size_t numCtlBytes() const { return this->m_numCtlBytes; }
+
+    //! @brief Returns the number of fields in the schema.
+    //! @returns the number of fields in the schema.
+    constexpr size_t numFields() const { return this->m_numFields; }
+
+    //! @brief Returns one of the field descriptors.
+    //! @returns a reference to the indicated field descriptor.
+    constexpr const FieldDesc& field(size_t idx  //!< [in] Index of the field to return.
+    ) const {
+        return this->m_fields[idx];
+    }
+
+    //! @brief Returns the ByteFlags for a single byte of the control table.
+    //! @returns the ByteFlags associated with the byte at the indicated offset.
+    constexpr ByteFlags::Type byteFlags(
+        IControlTable::Offset::Type offset  //!< [in] Offset of the byte within the control table.
+    ) const {
+        return this->m_byteFlags[offset];
+    }
+
+    //! @brief Returns the image of the control table with every field set to its default.
+    //! @details Bytes which don't belong to any field are zero.
+    //! @returns a pointer to numCtlBytes() bytes.
+    constexpr const uint8_t* defaults() const { return this->m_defaults; }
+
+    //! @brief Validates the data from a WRITE instruction.
+    //! @details All of the bytes covered by the write are checked in a single pass. Any field
+    //!          which is only partially covered by the write is checked using the current
+    //!          contents of the control table for the bytes which aren't being written.
+    //! @returns Error::NONE if the data may be written to the control table.
+    //! @returns Error::RANGE if the write extends past the end of the table, or if a byte
+    //!          which isn't writable is covered by the write.
+    //! @returns FieldDesc::limitError for each field whose value is out of limits.
+    Error::Type validateWrite(
+        IControlTable::Offset::Type offset,  //!< [in] Offset of the first byte to write.
+        size_t numBytes,                     //!< [in] Number of bytes to write.
+        const uint8_t* data,                 //!< [in] Data that will be written.
+        const uint8_t* ctlBytes              //!< [in] Current contents of the control table.
+    ) const;
+
+    //! @brief Determines if the persistent fields are exactly those within a prefix of the table.
+    //! @details IControlTable only persists the first numPersistentBytes bytes of the control
+    //!          table, so every field within that prefix must be marked as persistent, and no
+    //!          field which extends past it may be. Bytes which don't belong to any field are
+    //!          ignored.
+    //! @returns true if the persistent fields match the prefix.
+    bool persistsPrefix(size_t numPersistentBytes  //!< [in] Number of persistent bytes.
+    ) const;
+
+ private:
+    size_t m_numCtlBytes;        //!< Number of bytes in the control table.
+    size_t m_numFields;          //!< Number of fields in m_fields.
+    const FieldDesc* m_fields;   //!< Field descriptors.
+    const uint8_t* m_byteFlags;  //!< ByteFlags for each byte of the control table.
+    const uint8_t* m_byteField;  //!< Index of the field each byte belongs to.
+    const uint8_t* m_defaults;   //!< Default value of each byte of the control table.
+};
+
+}  // namespace bioloid
+
+//! @}
@@ -0,0 +1,48 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   Crc32.cpp
+ *
+ *   @brief  CRC-32 (as used by zlib and Ethernet) for validating stored data.
+ *
+ ****************************************************************************/
+
+#include "Crc32.h"
+
+namespace {
+
+//! @brief Lookup table containing the CRC of each byte value.
+struct Crc32Table {
+    //! @brief Constructor which calculates the table.
+    constexpr Crc32Table() {
+        for (uint32_t byte = 0; byte < 256; byte++) {
+            uint32_t crc = byte;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc & 1) != 0 ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+            }
+            this->entries[byte] = crc;
+        }
+    }
+
+    uint32_t entries[256] = {};  //!< CRC of each byte value.
+};
+
+constexpr Crc32Table CRC32_TABLE;  //!< Built at compile time.
+
+}  // namespace
+
+uint32_t bioloid::crc32(const void* data, size_t numBytes, uint32_t crc) {
+    auto bytes = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    for (size_t idx = 0; idx < numBytes; idx++) {
+        crc = CRC32_TABLE.entries[(crc ^ bytes[idx]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
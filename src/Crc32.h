@@ -0,0 +1,40 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   Crc32.h
+ *
+ *   @brief  CRC-32 (as used by zlib and Ethernet) for validating stored data.
+ *
+ ****************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+//! @addtogroup bioloid
+//! @{
+
+namespace bioloid {
+
+//! @brief Calculates the CRC-32 of some data.
+//! @details Uses the reflected polynomial 0xEDB88320, with the table generated at compile
+//!          time. A CRC can be calculated in pieces by passing the result of the previous
+//!          call as `crc`.
+//! @returns the CRC-32 of the data.
+uint32_t crc32(
+    const void* data,  //!< [in] Data to calculate the CRC of.
+    size_t numBytes,   //!< [in] Number of bytes of data.
+    uint32_t crc = 0   //!< [in] CRC of the preceding data.
+);
+
+}  // namespace bioloid
+
+//! @}
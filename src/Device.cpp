@@ -0,0 +1,94 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   Device.cpp
+ *
+ *   @brief  Dispatches instruction packets to a device's control table.
+ *
+ ****************************************************************************/
+
+#include "Device.h"
+
+bioloid::Device::Device(IControlTable& ctlTable) : m_ctlTable{ctlTable} {}
+
+bool bioloid::Device::processPacket(const Packet& cmd, Packet* rsp) {
+    ID::Type id = this->id();
+    if (cmd.id() != id && cmd.id() != ID::BROADCAST) {
+        return false;
+    }
+
+    rsp->params(0);
+
+    Error::Type err;
+    switch (cmd.command()) {
+        case Command::PING: {
+            err = Error::NONE;
+            break;
+        }
+        case Command::READ: {
+            err = this->read(cmd, rsp);
+            break;
+        }
+        case Command::WRITE: {
+            err = this->write(cmd);
+            break;
+        }
+        case Command::RESET: {
+            this->m_ctlTable.setToInitialValues();
+            err = Error::NONE;
+            break;
+        }
+        default: {
+            err = Error::INSTRUCTION;
+            break;
+        }
+    }
+
+    if (cmd.id() == ID::BROADCAST) {
+        return false;
+    }
+    rsp->id(id);
+    rsp->errorCode(err);
+    rsp->update_checksum();
+    return true;
+}
+
+bioloid::IControlTable::SizeType bioloid::Device::decodeAddr(const uint8_t* params) {
+    IControlTable::SizeType val = params[0];
+    if constexpr (ADDR_BYTES > 1) {
+        val |= static_cast<IControlTable::SizeType>(params[1] << 8);
+    }
+    return val;
+}
+
+bioloid::Error::Type bioloid::Device::read(const Packet& cmd, Packet* rsp) {
+    if (cmd.numParams() != 2 * ADDR_BYTES) {
+        return Error::INSTRUCTION;
+    }
+    IControlTable::Offset::Type offset = decodeAddr(&cmd.params()[0]);
+    IControlTable::SizeType numBytes = decodeAddr(&cmd.params()[ADDR_BYTES]);
+    if (numBytes > rsp->maxParams()) {
+        return Error::RANGE;
+    }
+    Error::Type err = this->m_ctlTable.read(offset, numBytes, rsp->params());
+    if (err == Error::NONE) {
+        rsp->params(numBytes);
+    }
+    return err;
+}
+
+bioloid::Error::Type bioloid::Device::write(const Packet& cmd) {
+    if (cmd.numParams() <= ADDR_BYTES) {
+        return Error::INSTRUCTION;
+    }
+    IControlTable::Offset::Type offset = decodeAddr(&cmd.params()[0]);
+    return this->m_ctlTable.write(
+        offset, &cmd.params()[ADDR_BYTES], cmd.numParams() - ADDR_BYTES);
+}
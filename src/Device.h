@@ -0,0 +1,83 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   Device.h
+ *
+ *   @brief  Dispatches instruction packets to a device's control table.
+ *
+ ****************************************************************************/
+
+#pragma once
+
+#include "Bioloid.h"
+#include "ControlTable.h"
+#include "Packet.h"
+
+//! @addtogroup bioloid
+//! @{
+
+namespace bioloid {
+
+//! @brief Processes the instruction packets sent to a device.
+class Device {
+ public:
+    //! @brief Constructor.
+    Device(IControlTable& ctlTable  //!< [in] Control table for the device.
+    );
+
+    //! @brief Returns the control table associated with the device.
+    //! @returns a reference to the control table.
+    IControlTable& ctlTable() { return this->m_ctlTable; }
+
+    //! @brief Returns the ID of the device.
+    //! @details The ID is read directly from the control bytes, so that checking the ID of
+    //!          every packet isn't counted as a read in the heatmap.
+    //! @returns the ID stored in the control table.
+    ID::Type id() const { return this->m_ctlTable.ctlBytes()[IControlTable::Offset::ID]; }
+
+    //! @brief Processes an instruction packet.
+    //! @details Packets which aren't addressed to this device are ignored. The status
+    //!          packet is filled in using the ID the instruction was addressed to.
+    //! @returns true if a status packet should be sent.
+    //! @returns false if no reply should be sent.
+    bool processPacket(
+        const Packet& cmd,  //!< [in] Instruction packet to process.
+        Packet* rsp         //!< [out] Status packet.
+    );
+
+ private:
+    //! @brief Number of bytes used to encode offsets and lengths in READ and WRITE packets.
+    //! @details This follows the address width of the control table, so devices with
+    //!          tables larger than 255 bytes use 2-byte, little endian offsets and lengths.
+    static constexpr uint8_t ADDR_BYTES = sizeof(IControlTable::Offset::Type);
+
+    //! @brief Decodes a little endian offset or length from the parameters of a packet.
+    //! @returns the decoded value.
+    static IControlTable::SizeType decodeAddr(const uint8_t* params  //!< [in] Encoded value.
+    );
+
+    //! @brief Handles a READ instruction.
+    //! @returns the error code to return in the status packet.
+    Error::Type read(
+        const Packet& cmd,  //!< [in] Instruction packet to process.
+        Packet* rsp         //!< [out] Status packet to store the data in.
+    );
+
+    //! @brief Handles a WRITE instruction.
+    //! @returns the error code to return in the status packet.
+    Error::Type write(const Packet& cmd  //!< [in] Instruction packet to process.
+    );
+
+    IControlTable& m_ctlTable;  //!< Control table for the device.
+};
+
+}  // namespace bioloid
+
+//! @}
@@ -0,0 +1,66 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   FieldCache.cpp
+ *
+ *   @brief  Keeps track of when sampled control table fields need refreshing.
+ *
+ ****************************************************************************/
+
+#include "FieldCache.h"
+
+#include <cassert>
+
+bioloid::FieldCache::FieldCache(const SampledField* fields, size_t numFields)
+    : m_fields{fields}, m_numFields{numFields} {
+    assert(this->m_numFields <= MAX_FIELDS);
+}
+
+uint32_t bioloid::FieldCache::staleFields(
+    IControlTable::Offset::Type offset,
+    IControlTable::SizeType numBytes,
+    uint32_t nowUsec) const {
+    uint32_t stale = 0;
+    for (size_t idx = 0; idx < this->m_numFields; idx++) {
+        const SampledField& field = this->m_fields[idx];
+        if (!IControlTable::overlaps(offset, numBytes, field.offset, field.numBytes)) {
+            continue;
+        }
+        uint32_t bit = uint32_t{1} << idx;
+        if ((this->m_valid & bit) == 0) {
+            stale |= bit;
+            continue;
+        }
+        switch (field.refresh) {
+            case RefreshPolicy::ALWAYS: {
+                stale |= bit;
+                break;
+            }
+            case RefreshPolicy::TTL: {
+                // Unsigned subtraction handles the microsecond counter wrapping.
+                if (nowUsec - this->m_sampledUsec[idx] >= field.ttlUsec) {
+                    stale |= bit;
+                }
+                break;
+            }
+            case RefreshPolicy::ON_DEMAND: {
+                break;
+            }
+        }
+    }
+    return stale;
+}
+
+void bioloid::FieldCache::sampled(uint32_t fields, uint32_t nowUsec) {
+    this->m_valid |= fields;
+    for (; fields != 0; fields &= fields - 1) {
+        this->m_sampledUsec[__builtin_ctz(fields)] = nowUsec;
+    }
+}
@@ -0,0 +1,118 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   FieldCache.h
+ *
+ *   @brief  Keeps track of when sampled control table fields need refreshing.
+ *
+ ****************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "ControlTable.h"
+
+//! @addtogroup bioloid
+//! @{
+
+namespace bioloid {
+
+//! @brief Determines when a sampled field needs to be sampled again.
+enum class RefreshPolicy : uint8_t {
+    ALWAYS,     //!< Sampled every time the field is retrieved.
+    TTL,        //!< Sampled once the previous sample is older than ttlUsec.
+    ON_DEMAND,  //!< Sampled the first time, and then only after being invalidated.
+};
+
+//! @brief Describes a control table field whose value is sampled from hardware.
+struct SampledField {
+    IControlTable::Offset::Type offset;  //!< Offset of the field within the control table.
+    uint8_t numBytes;                    //!< Size of the field, in bytes.
+    RefreshPolicy refresh;               //!< When the field needs to be sampled again.
+    uint32_t ttlUsec = 0;                //!< Lifetime of a sample for RefreshPolicy::TTL.
+};
+
+//! @brief Caches sampled control table fields so that they're only sampled when needed.
+//! @details This is intended to be used from a derived control table's populateEntry():
+//! @code
+//!     void populateEntry(Offset::Type offset, SizeType numBytes) const override {
+//!         this->m_cache.refresh(offset, numBytes, micros(), [this](size_t idx) {
+//!             // sample field idx and store it in the control table, then:
+//!             this->sampled(FIELDS[idx].offset, FIELDS[idx].numBytes);
+//!         });
+//!     }
+//! @endcode
+//!          Since populateEntry() covers an entire READ, each field is sampled at most
+//!          once per READ.
+class FieldCache {
+ public:
+    //! Maximum number of sampled fields.
+    static constexpr size_t MAX_FIELDS = 32;
+
+    //! @brief Constructor.
+    FieldCache(
+        const SampledField* fields,  //!< [in] Fields which are sampled.
+        size_t numFields             //!< [in] Number of fields in `fields`.
+    );
+
+    //! @brief Samples any fields within a range whose cached value has expired.
+    //! @tparam SampleFn - callable which takes the index of the field to sample.
+    template <typename SampleFn>
+    void refresh(
+        IControlTable::Offset::Type offset,  //!< [in] Offset of the first byte being retrieved.
+        IControlTable::SizeType numBytes,    //!< [in] Number of bytes being retrieved.
+        uint32_t nowUsec,                    //!< [in] Current time in microseconds.
+        SampleFn&& sample                    //!< [in] Function which samples a field.
+    ) {
+        uint32_t stale = this->staleFields(offset, numBytes, nowUsec);
+        if (stale == 0) {
+            return;
+        }
+        for (uint32_t fields = stale; fields != 0; fields &= fields - 1) {
+            sample(static_cast<size_t>(__builtin_ctz(fields)));
+        }
+        this->sampled(stale, nowUsec);
+    }
+
+    //! @brief Forces a field to be sampled the next time it's retrieved.
+    void invalidate(size_t idx  //!< [in] Index of the field to invalidate.
+    ) {
+        this->m_valid &= ~(uint32_t{1} << idx);
+    }
+
+    //! @brief Forces all fields to be sampled the next time they're retrieved.
+    void invalidateAll() { this->m_valid = 0; }
+
+ private:
+    //! @brief Determines which fields within a range need to be sampled.
+    //! @returns a bitmask with a bit set for each field index which needs sampling.
+    uint32_t staleFields(
+        IControlTable::Offset::Type offset,  //!< [in] Offset of the first byte being retrieved.
+        IControlTable::SizeType numBytes,    //!< [in] Number of bytes being retrieved.
+        uint32_t nowUsec                     //!< [in] Current time in microseconds.
+    ) const;
+
+    //! @brief Records that fields have been sampled.
+    void sampled(
+        uint32_t fields,  //!< [in] Bitmask of the field indices which were sampled.
+        uint32_t nowUsec  //!< [in] Time that the fields were sampled.
+    );
+
+    const SampledField* const m_fields;       //!< Fields which are sampled.
+    const size_t m_numFields;                 //!< Number of fields in m_fields.
+    uint32_t m_valid = 0;                     //!< Bitmask of fields with a cached value.
+    uint32_t m_sampledUsec[MAX_FIELDS] = {};  //!< Time each field was last sampled.
+};
+
+}  // namespace bioloid
+
+//! @}
@@ -26,40 +26,63 @@ bioloid::FileStorage::FileStorage(const char* fileName) : m_fileName(fileName) {
 }
 
 bioloid::IControlTableStorage::Error
-bioloid::FileStorage::load(OffsetType offset, uint8_t numBytes, void* data) {
-    int fd = open(this->m_fileName, O_RDONLY);
-    if (fd < 0) {
-        return Error::FAILED;
+bioloid::FileStorage::load(OffsetType offset, SizeType numBytes, void* data) {
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (!this->open(false)) {
+            return Error::FAILED;
+        }
+        ssize_t result = pread(this->m_fd, data, numBytes, offset);
+        if (result == numBytes) {
+            return Error::NONE;
+        }
+        if (result >= 0) {
+            // The file is too short, so reopening won't help.
+            return Error::FAILED;
+        }
+        this->close();
     }
-    if (lseek(fd, offset, SEEK_SET) == (off_t)-1) {
-        close(fd);
-        return Error::FAILED;
-    }
-    if (read(fd, data, numBytes) != numBytes) {
-        close(fd);
-        return Error::FAILED;
-    }
-    close(fd);
-    return Error::NONE;
+    return Error::FAILED;
 }
 
 bioloid::IControlTableStorage::Error
-bioloid::FileStorage::save(OffsetType offset, uint8_t numBytes, const void* data) {
-    // Using mode a+ will create the file if it doesn't exist and leave the contents
-    // alone if it does. The file pointer is positioned at the end of the file, but
-    // we seek to our position anyways, so this doesn't matter.
-    int fd = open(this->m_fileName, O_RDWR | O_CREAT, 0644);
-    if (fd < 0) {
-        return Error::FAILED;
+bioloid::FileStorage::save(OffsetType offset, SizeType numBytes, const void* data) {
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (!this->open(true)) {
+            return Error::FAILED;
+        }
+        if (pwrite(this->m_fd, data, numBytes, offset) == numBytes) {
+            return Error::NONE;
+        }
+        this->close();
     }
-    if (lseek(fd, offset, SEEK_SET) == (off_t)-1) {
-        close(fd);
-        return Error::FAILED;
+    return Error::FAILED;
+}
+
+void bioloid::FileStorage::close() {
+    if (this->m_fd >= 0) {
+        ::close(this->m_fd);
+        this->m_fd = -1;
+    }
+    this->m_writable = false;
+}
+
+bool bioloid::FileStorage::open(bool forWrite) {
+    if (this->m_fd >= 0 && (this->m_writable || !forWrite)) {
+        return true;
     }
-    if (write(fd, data, numBytes) != numBytes) {
-        close(fd);
-        return Error::FAILED;
+    this->close();
+    if (forWrite) {
+        // Create the file if it doesn't exist, and leave the contents alone if it does.
+        this->m_fd = ::open(this->m_fileName, O_RDWR | O_CREAT, 0644);
+        this->m_writable = this->m_fd >= 0;
+    } else {
+        // Try for read/write access first, so that a subsequent save() can use the same
+        // descriptor, but don't create the file.
+        this->m_fd = ::open(this->m_fileName, O_RDWR);
+        this->m_writable = this->m_fd >= 0;
+        if (this->m_fd < 0) {
+            this->m_fd = ::open(this->m_fileName, O_RDONLY);
+        }
     }
-    close(fd);
-    return Error::NONE;
+    return this->m_fd >= 0;
 }
@@ -24,21 +24,49 @@
 namespace bioloid {
 
 //! @brief Class which implements control table storage using a file.
+//! @details The file is opened by the first load() or save() and kept open until close()
+//!          is called or the object is destroyed, so each load() or save() only needs a
+//!          single pread() or pwrite(). If one of those fails, the file is reopened and
+//!          the operation is retried once. load() never creates the file, but save() does.
+//!
+//!          Since the file stays open, call close() before replacing or removing it from
+//!          outside of this object.
 class FileStorage : public IControlTableStorage {
  public:
     //! @brief Constructor.
     FileStorage(const char* fileName  //!< [in] Name of file to store control table in.
     );
 
+    //! @brief Destructor.
+    ~FileStorage() override { this->close(); }
+
+    FileStorage(const FileStorage&) = delete;
+    FileStorage& operator=(const FileStorage&) = delete;
+
     //! @brief Returns the filename that was passed to the construcor.
     //! @return const char* C string containing the filename.
     const char* fileName() const { return this->m_fileName; }
 
-    Error load(OffsetType offset, uint8_t numBytes, void* data) override;
-    Error save(OffsetType offset, uint8_t numBytes, const void* data) override;
+    Error load(OffsetType offset, SizeType numBytes, void* data) override;
+    Error save(OffsetType offset, SizeType numBytes, const void* data) override;
+
+    //! @brief Closes the file, if it's open.
+    //! @details The next load() or save() will open the file again.
+    void close();
+
+    //! @brief Determines if the file is currently open.
+    //! @returns true if the file is open.
+    bool isOpen() const { return this->m_fd >= 0; }
 
  private:
+    //! @brief Opens the file, if it isn't already open with the required access.
+    //! @returns true if the file is open.
+    bool open(bool forWrite  //!< [in] true if the file needs to be writable.
+    );
+
     char const* m_fileName;
+    int m_fd = -1;            //!< Open file, or -1 if the file isn't open.
+    bool m_writable = false;  //!< true if m_fd was opened for writing.
 };
 
 }  // namespace bioloid
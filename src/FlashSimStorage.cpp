@@ -0,0 +1,129 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   FlashSimStorage.cpp
+ *
+ *   @brief  In-memory control table storage which simulates EEPROM or flash memory.
+ *
+ ****************************************************************************/
+
+#include "FlashSimStorage.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+bioloid::FlashSimStorage::FlashSimStorage(
+    const Config& config,
+    size_t numPages,
+    uint8_t* memory,
+    uint32_t* wear)
+    : m_config{config}, m_numPages{numPages}, m_memory{memory}, m_wear{wear} {
+    assert(this->m_config.pageBytes > 0);
+    assert(this->m_memory != nullptr);
+    assert(this->m_wear != nullptr);
+    this->eraseAll();
+}
+
+bioloid::IControlTableStorage::Error
+bioloid::FlashSimStorage::load(OffsetType offset, SizeType numBytes, void* data) {
+    if (this->m_poweredOff || offset + numBytes > this->m_numPages * this->m_config.pageBytes) {
+        return Error::FAILED;
+    }
+    const uint8_t* start = &this->m_memory[offset];
+    if (std::all_of(start, start + numBytes, [](uint8_t byte) { return byte == 0xFF; })) {
+        // Nothing has been saved yet.
+        return Error::FAILED;
+    }
+    memcpy(data, start, numBytes);
+    return Error::NONE;
+}
+
+bioloid::IControlTableStorage::Error
+bioloid::FlashSimStorage::save(OffsetType offset, SizeType numBytes, const void* data) {
+    size_t pageBytes = this->m_config.pageBytes;
+    size_t end = offset + numBytes;
+    if (this->m_poweredOff || end > this->m_numPages * pageBytes) {
+        return Error::FAILED;
+    }
+    this->m_stats.bytesSaved += numBytes;
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t page = offset / pageBytes; page * pageBytes < end; page++) {
+        size_t first = std::max<size_t>(offset, page * pageBytes);
+        size_t last = std::min(end, (page + 1) * pageBytes);
+        if (memcmp(&this->m_memory[first], &bytes[first - offset], last - first) == 0) {
+            // Nothing changed, so the page doesn't need to be rewritten.
+            continue;
+        }
+        if (!this->writePage(page, first, last - first, &bytes[first - offset])) {
+            return Error::FAILED;
+        }
+    }
+    return Error::NONE;
+}
+
+bioloid::IControlTableStorage::Error bioloid::FlashSimStorage::commit() {
+    this->m_stats.lastSaveTime = this->m_saveTime;
+    this->m_saveTime = std::chrono::microseconds{0};
+    return this->m_poweredOff ? Error::FAILED : Error::NONE;
+}
+
+void bioloid::FlashSimStorage::eraseAll() {
+    memset(this->m_memory, 0xFF, this->m_numPages * this->m_config.pageBytes);
+    memset(this->m_wear, 0, this->m_numPages * sizeof(this->m_wear[0]));
+    this->m_stats = {};
+    this->m_saveTime = std::chrono::microseconds{0};
+}
+
+void bioloid::FlashSimStorage::failAfter(size_t numBytes) {
+    this->m_failAfter = numBytes;
+}
+
+void bioloid::FlashSimStorage::powerOn() {
+    this->m_failAfter = SIZE_MAX;
+    this->m_poweredOff = false;
+}
+
+uint32_t bioloid::FlashSimStorage::maxWear() const {
+    return *std::max_element(this->m_wear, this->m_wear + this->m_numPages);
+}
+
+bool bioloid::FlashSimStorage::writePage(
+    size_t page,
+    size_t offset,
+    size_t numBytes,
+    const uint8_t* data) {
+    size_t pageBytes = this->m_config.pageBytes;
+    uint8_t* start = &this->m_memory[page * pageBytes];
+
+    // The bytes of the page which aren't being saved have to be reprogrammed after the erase,
+    // so applying the new bytes in place gives the same result.
+    this->m_wear[page]++;
+    this->m_stats.numErases++;
+    this->m_saveTime += this->m_config.eraseTime;
+    this->m_stats.busyTime += this->m_config.eraseTime;
+    memcpy(&this->m_memory[offset], data, numBytes);
+
+    this->m_stats.numPrograms++;
+    this->m_saveTime += this->m_config.programTime;
+    this->m_stats.busyTime += this->m_config.programTime;
+    if (this->m_failAfter < pageBytes) {
+        // Power failed part way through programming, so the rest of the page stays erased.
+        memset(&start[this->m_failAfter], 0xFF, pageBytes - this->m_failAfter);
+        this->m_failAfter = SIZE_MAX;
+        this->m_poweredOff = true;
+        return false;
+    }
+    if (this->m_failAfter != SIZE_MAX) {
+        this->m_failAfter -= pageBytes;
+    }
+    return true;
+}
@@ -0,0 +1,132 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   FlashSimStorage.h
+ *
+ *   @brief  In-memory control table storage which simulates EEPROM or flash memory.
+ *
+ ****************************************************************************/
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "ControlTable.h"
+
+//! @addtogroup bioloid
+//! @{
+
+namespace bioloid {
+
+//! @brief Control table storage which models the timing and wear of paged non-volatile memory.
+//! @details Memory is divided into pages. Saving bytes which differ from those already
+//!          stored erases each affected page (setting it to 0xFF) and then programs the
+//!          whole page, the way an EEPROM or flash driver would. Pages which don't change
+//!          aren't touched. Each erase increments the page's wear counter.
+//!
+//!          No time actually passes. Instead, the erase and program times are added up,
+//!          so tests can measure how long a device would be blocked in
+//!          IControlTable::save(), which is reported by stats().lastSaveTime once
+//!          commit() is called.
+//!
+//!          failAfter() simulates losing power part way through programming. Programming
+//!          stops after the given number of bytes, leaving the rest of the page erased, and
+//!          all further saves fail until powerOn() is called.
+//!
+//!          As with a blank device, load() fails if every byte being loaded is 0xFF.
+class FlashSimStorage : public IControlTableStorage {
+ public:
+    //! @brief Characteristics of the simulated memory.
+    struct Config {
+        size_t pageBytes = 64;                       //!< Number of bytes in each page.
+        std::chrono::microseconds eraseTime{3000};   //!< Time taken to erase a page.
+        std::chrono::microseconds programTime{500};  //!< Time taken to program a page.
+    };
+
+    //! @brief Statistics about the simulated operations.
+    struct Stats {
+        uint32_t numErases;                      //!< Number of page erases.
+        uint32_t numPrograms;                    //!< Number of page programs.
+        uint64_t bytesSaved;                     //!< Number of bytes passed to save().
+        std::chrono::microseconds busyTime;      //!< Total time spent erasing and programming.
+        std::chrono::microseconds lastSaveTime;  //!< Time taken by the last complete save.
+    };
+
+    //! @brief Constructor.
+    //! @details The memory starts out erased.
+    FlashSimStorage(
+        const Config& config,  //!< [in] Characteristics of the simulated memory.
+        size_t numPages,       //!< [in] Number of pages of memory.
+        uint8_t* memory,       //!< [in] Storage for numPages * config.pageBytes bytes.
+        uint32_t* wear         //!< [in] Storage for numPages wear counters.
+    );
+
+    Error load(OffsetType offset, SizeType numBytes, void* data) override;
+    Error save(OffsetType offset, SizeType numBytes, const void* data) override;
+    Error commit() override;
+
+    //! @brief Erases all of the memory, and resets the wear counters and statistics.
+    void eraseAll();
+
+    //! @brief Simulates losing power after programming some more bytes.
+    void failAfter(size_t numBytes  //!< [in] Number of bytes which can still be programmed.
+    );
+
+    //! @brief Restores power after a simulated power failure.
+    void powerOn();
+
+    //! @brief Determines if a simulated power failure has occurred.
+    //! @returns true if saves will fail until powerOn() is called.
+    bool isPoweredOff() const { return this->m_poweredOff; }
+
+    //! @brief Returns the contents of the simulated memory.
+    //! @returns a pointer to the memory.
+    const uint8_t* memory() const { return this->m_memory; }
+
+    //! @brief Returns the number of times that a page has been erased.
+    //! @returns the page's wear counter.
+    uint32_t wear(size_t page  //!< [in] Index of the page.
+    ) const {
+        return this->m_wear[page];
+    }
+
+    //! @brief Returns the largest wear counter.
+    //! @returns the number of times that the most worn page has been erased.
+    uint32_t maxWear() const;
+
+    //! @brief Returns statistics about the simulated operations.
+    //! @returns the statistics.
+    const Stats& stats() const { return this->m_stats; }
+
+ private:
+    //! @brief Erases and reprograms one page, changing some of its bytes.
+    //! @returns false if power failed while programming.
+    bool writePage(
+        size_t page,         //!< [in] Index of the page.
+        size_t offset,       //!< [in] Offset in memory of the first byte to change.
+        size_t numBytes,     //!< [in] Number of bytes to change (all within the page).
+        const uint8_t* data  //!< [in] New values of the bytes.
+    );
+
+    const Config m_config;                    //!< Characteristics of the simulated memory.
+    const size_t m_numPages;                  //!< Number of pages.
+    uint8_t* const m_memory;                  //!< Contents of the simulated memory.
+    uint32_t* const m_wear;                   //!< Number of erases of each page.
+    Stats m_stats = {};                       //!< Statistics about the simulated operations.
+    std::chrono::microseconds m_saveTime{0};  //!< Time taken by save() since commit().
+    size_t m_failAfter = SIZE_MAX;            //!< Bytes which can be programmed.
+    bool m_poweredOff = false;                //!< true after a simulated power failure.
+};
+
+}  // namespace bioloid
+
+//! @}
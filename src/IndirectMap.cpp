@@ -0,0 +1,64 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   IndirectMap.cpp
+ *
+ *   @brief  Maps a window of the control table onto scattered control table bytes.
+ *
+ ****************************************************************************/
+
+#include "IndirectMap.h"
+
+#include <cassert>
+
+bioloid::IndirectMap::IndirectMap(
+    IControlTable::Offset::Type addrOffset,
+    IControlTable::Offset::Type dataOffset,
+    IControlTable::SizeType numEntries,
+    Run* runs)
+    : m_addrOffset{addrOffset}, m_dataOffset{dataOffset}, m_numEntries{numEntries}, m_runs{runs} {
+    assert(this->m_runs != nullptr);
+    // The address region can't be accessed through the data window.
+    assert(
+        this->m_addrOffset + this->addrBytes() <= this->m_dataOffset ||
+        this->m_dataOffset + this->m_numEntries <= this->m_addrOffset);
+}
+
+void bioloid::IndirectMap::update(const uint8_t* ctlBytes, IControlTable::SizeType numCtlBytes) {
+    assert(this->m_addrOffset + this->addrBytes() <= numCtlBytes);
+    assert(this->m_dataOffset + this->m_numEntries <= numCtlBytes);
+
+    this->m_numRuns = 0;
+    const uint8_t* entry = &ctlBytes[this->m_addrOffset];
+    for (size_t idx = 0; idx < this->m_numEntries; idx++) {
+        size_t source = 0;
+        for (size_t i = 0; i < sizeof(IControlTable::Offset::Type); i++) {
+            source |= static_cast<size_t>(*entry++) << (8 * i);
+        }
+        // Neither the data window nor the address region can be accessed through the window.
+        size_t self = this->m_dataOffset + idx;
+        if (source >= numCtlBytes ||
+            (source >= this->m_dataOffset && source < this->m_dataOffset + this->m_numEntries) ||
+            (source >= this->m_addrOffset && source < this->m_addrOffset + this->addrBytes())) {
+            source = self;
+        }
+
+        if (this->m_numRuns > 0) {
+            Run& last = this->m_runs[this->m_numRuns - 1];
+            if (last.source + last.numBytes == source) {
+                last.numBytes++;
+                continue;
+            }
+        }
+        this->m_runs[this->m_numRuns++] = {
+            static_cast<IControlTable::Offset::Type>(source),
+            static_cast<IControlTable::SizeType>(idx), 1};
+    }
+}
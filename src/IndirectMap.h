@@ -0,0 +1,164 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   IndirectMap.h
+ *
+ *   @brief  Maps a window of the control table onto scattered control table bytes.
+ *
+ ****************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "ControlTable.h"
+
+//! @addtogroup bioloid
+//! @{
+
+namespace bioloid {
+
+//! @brief Lets a master gather scattered control table bytes using a single READ or WRITE.
+//! @details The control table contains an address region with one entry per byte of the
+//!          data window. Each entry is an offset (stored little endian, using the same
+//!          width as Offset::Type) of the byte that the corresponding byte of the data
+//!          window refers to. IControlTable::read() and IControlTable::write() access the
+//!          referenced bytes instead of the data window itself. get() and set() aren't
+//!          redirected.
+//!
+//!          Whenever the address region is modified, the entries are converted into a
+//!          gather table of runs of consecutive offsets, so that resolving an access only
+//!          needs one step per run rather than one per byte. Entries which don't refer to
+//!          a valid byte outside of both the data window and the address region refer to
+//!          the data window byte itself. A WRITE which modifies the address region uses the
+//!          gather table from before the WRITE for all of its bytes.
+//! @code
+//!     IndirectMap::Run runs[NUM_INDIRECT];
+//!     IndirectMap indirect{Offset::INDIRECT_ADDR, Offset::INDIRECT_DATA, NUM_INDIRECT, runs};
+//!     ctlTable.indirect(&indirect);
+//! @endcode
+class IndirectMap {
+ public:
+    //! @brief A run of consecutive data window bytes which refer to consecutive offsets.
+    struct Run {
+        IControlTable::Offset::Type source;  //!< Offset of the byte the run starts with.
+        IControlTable::SizeType index;       //!< Index within the data window of the run.
+        IControlTable::SizeType numBytes;    //!< Number of bytes in the run.
+    };
+
+    //! @brief Constructor.
+    IndirectMap(
+        IControlTable::Offset::Type addrOffset,  //!< [in] Offset of the address region.
+        IControlTable::Offset::Type dataOffset,  //!< [in] Offset of the data window.
+        IControlTable::SizeType numEntries,      //!< [in] Number of bytes in the data window.
+        Run* runs                                //!< [in] Storage for numEntries runs.
+    );
+
+    //! @brief Returns the offset of the address region.
+    //! @returns the offset of the first address entry.
+    IControlTable::Offset::Type addrOffset() const { return this->m_addrOffset; }
+
+    //! @brief Returns the number of bytes in the address region.
+    //! @returns the number of bytes occupied by the address entries.
+    size_t addrBytes() const { return this->m_numEntries * sizeof(IControlTable::Offset::Type); }
+
+    //! @brief Returns the offset of the data window.
+    //! @returns the offset of the first byte of the data window.
+    IControlTable::Offset::Type dataOffset() const { return this->m_dataOffset; }
+
+    //! @brief Returns the number of runs in the gather table.
+    //! @returns the number of runs.
+    size_t numRuns() const { return this->m_numRuns; }
+
+    //! @brief Returns one of the runs from the gather table.
+    //! @returns a reference to the indicated run.
+    const Run& run(size_t idx  //!< [in] Index of the run to return.
+    ) const {
+        return this->m_runs[idx];
+    }
+
+    //! @brief Rebuilds the gather table from the address region.
+    void update(
+        const uint8_t* ctlBytes,             //!< [in] Contents of the control table.
+        IControlTable::SizeType numCtlBytes  //!< [in] Number of bytes in the control table.
+    );
+
+    //! @brief Splits a range of the control table into the segments which are accessed.
+    //! @details Bytes outside of the data window map to themselves, and bytes inside of the
+    //!          data window map through the gather table. `fn` is called for each segment
+    //!          in order, with the offset accessed, the offset of the segment relative to
+    //!          the start of the range and the number of bytes, and returns false to stop.
+    //! @tparam Fn - callable taking (Offset::Type, SizeType, SizeType) and returning bool.
+    //! @returns false if `fn` stopped the iteration.
+    template <typename Fn>
+    bool forEachSegment(
+        IControlTable::Offset::Type offset,  //!< [in] Offset of the first byte accessed.
+        IControlTable::SizeType numBytes,    //!< [in] Number of bytes accessed.
+        Fn&& fn                              //!< [in] Called for each segment.
+    ) const {
+        size_t pos = offset;
+        size_t end = offset + numBytes;
+        size_t windowStart = this->m_dataOffset;
+        size_t windowEnd = windowStart + this->m_numEntries;
+        if (pos < windowStart) {
+            size_t segEnd = std::min(end, windowStart);
+            if (!call(fn, pos, pos - offset, segEnd - pos)) {
+                return false;
+            }
+            pos = segEnd;
+        }
+        if (pos < end && pos < windowEnd) {
+            size_t segEnd = std::min(end, windowEnd);
+            for (size_t idx = 0; idx < this->m_numRuns; idx++) {
+                const Run& run = this->m_runs[idx];
+                size_t runStart = windowStart + run.index;
+                size_t first = std::max(runStart, pos);
+                size_t last = std::min(runStart + run.numBytes, segEnd);
+                if (first < last &&
+                    !call(fn, run.source + (first - runStart), first - offset, last - first)) {
+                    return false;
+                }
+            }
+            pos = segEnd;
+        }
+        if (pos < end) {
+            return call(fn, pos, pos - offset, end - pos);
+        }
+        return true;
+    }
+
+ private:
+    //! @brief Calls the function passed to forEachSegment().
+    //! @returns the value returned by `fn`.
+    template <typename Fn>
+    static bool call(
+        Fn& fn,            //!< [in] Function to call.
+        size_t offset,     //!< [in] Offset of the bytes accessed.
+        size_t bufOffset,  //!< [in] Offset relative to the start of the range.
+        size_t numBytes    //!< [in] Number of bytes in the segment.
+    ) {
+        return fn(
+            static_cast<IControlTable::Offset::Type>(offset),
+            static_cast<IControlTable::SizeType>(bufOffset),
+            static_cast<IControlTable::SizeType>(numBytes));
+    }
+
+    const IControlTable::Offset::Type m_addrOffset;  //!< Offset of the address region.
+    const IControlTable::Offset::Type m_dataOffset;  //!< Offset of the data window.
+    const IControlTable::SizeType m_numEntries;      //!< Number of bytes in the data window.
+    Run* const m_runs;                               //!< Gather table.
+    size_t m_numRuns = 0;                            //!< Number of runs in m_runs.
+};
+
+}  // namespace bioloid
+
+//! @}
@@ -0,0 +1,52 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   LayoutMigration.cpp
+ *
+ *   @brief  Migrates persistent bytes saved using an older control table layout.
+ *
+ ****************************************************************************/
+
+#include "LayoutMigration.h"
+
+bool bioloid::LayoutMigrations::canMigrate(uint16_t fromVersion, size_t numOldBytes) const {
+    if (this->m_numSteps == 0 || fromVersion < this->m_steps[0].fromVersion() ||
+        fromVersion >= this->m_version) {
+        return false;
+    }
+    return this->m_steps[fromVersion - this->m_steps[0].fromVersion()].numOldBytes() ==
+           numOldBytes;
+}
+
+bool bioloid::LayoutMigrations::migrate(
+    uint16_t fromVersion,
+    const uint8_t* oldBytes,
+    size_t numOldBytes,
+    uint8_t* newBytes,
+    size_t numNewBytes) const {
+    if (!this->canMigrate(fromVersion, numOldBytes) || numNewBytes != this->numBytes()) {
+        return false;
+    }
+    size_t first = fromVersion - this->m_steps[0].fromVersion();
+    for (size_t offset = 0; offset < numNewBytes; offset++) {
+        // Follow the byte back through each step to the stored version.
+        size_t source = offset;
+        for (size_t step = this->m_numSteps; step-- > first;) {
+            source = this->m_steps[step].source(source);
+            if (source == MigrationCopy::NEW_BYTE) {
+                break;
+            }
+        }
+        if (source != MigrationCopy::NEW_BYTE) {
+            newBytes[offset] = oldBytes[source];
+        }
+    }
+    return true;
+}
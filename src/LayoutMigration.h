@@ -0,0 +1,187 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   LayoutMigration.h
+ *
+ *   @brief  Migrates persistent bytes saved using an older control table layout.
+ *
+ ****************************************************************************/
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+//! @addtogroup bioloid
+//! @{
+
+namespace bioloid {
+
+//! @brief Describes a run of bytes which moves from one layout version to the next.
+struct MigrationCopy {
+    //! Source of a byte which isn't copied, and so keeps its initial value.
+    static constexpr uint16_t NEW_BYTE = 0xFFFF;
+
+    uint16_t from;      //!< Offset of the run in the older layout.
+    uint16_t to;        //!< Offset of the run in the newer layout.
+    uint16_t numBytes;  //!< Number of bytes in the run.
+};
+
+class MigrationStep;  // forward declaration.
+
+//! @brief Precomputed plan for migrating persistent bytes from one layout version to the next.
+//! @details The copies are expanded at compile time into the offset in the older layout of
+//!          each byte of the newer layout, so applying the plan needs no searching. Bytes
+//!          which aren't covered by any copy keep their initial values.
+//! @tparam NUM_NEW_BYTES - number of persistent bytes in the newer layout.
+template <size_t NUM_NEW_BYTES>
+class MigrationPlan {
+ public:
+    //! @brief Constructor.
+    template <size_t NUM_COPIES>
+    constexpr MigrationPlan(
+        uint16_t fromVersion,                      //!< [in] Version of the older layout.
+        size_t numOldBytes,                        //!< [in] Persistent bytes in the older layout.
+        const MigrationCopy (&copies)[NUM_COPIES]  //!< [in] Bytes to copy.
+        )
+        : m_fromVersion{fromVersion}, m_numOldBytes{numOldBytes}, m_source{} {
+        static_assert(NUM_NEW_BYTES < MigrationCopy::NEW_BYTE);
+        for (auto& source : this->m_source) {
+            source = MigrationCopy::NEW_BYTE;
+        }
+        for (const MigrationCopy& copy : copies) {
+            assert(copy.from + copy.numBytes <= numOldBytes);
+            assert(copy.to + copy.numBytes <= NUM_NEW_BYTES);
+            for (size_t idx = 0; idx < copy.numBytes; idx++) {
+                // Copies aren't allowed to overlap in the newer layout.
+                assert(this->m_source[copy.to + idx] == MigrationCopy::NEW_BYTE);
+                this->m_source[copy.to + idx] = static_cast<uint16_t>(copy.from + idx);
+            }
+        }
+    }
+
+ private:
+    friend class MigrationStep;
+
+    uint16_t m_fromVersion;            //!< Version of the older layout.
+    size_t m_numOldBytes;              //!< Number of persistent bytes in the older layout.
+    uint16_t m_source[NUM_NEW_BYTES];  //!< Offset in the older layout of each byte.
+};
+
+//! @brief A non-templated view onto a MigrationPlan.
+class MigrationStep {
+ public:
+    //! @brief Constructor.
+    template <size_t NUM_NEW_BYTES>
+    constexpr MigrationStep(const MigrationPlan<NUM_NEW_BYTES>& plan  //!< [in] Plan to view.
+                            )
+        : m_fromVersion{plan.m_fromVersion},
+          m_numOldBytes{plan.m_numOldBytes},
+          m_numNewBytes{NUM_NEW_BYTES},
+          m_source{plan.m_source} {}
+
+    //! @brief Returns the version of the layout that this step migrates from.
+    //! @returns the older layout version (the newer version is one more).
+    constexpr uint16_t fromVersion() const { return this->m_fromVersion; }
+
+    //! @brief Returns the number of persistent bytes in the older layout.
+    //! @returns the number of bytes.
+    constexpr size_t numOldBytes() const { return this->m_numOldBytes; }
+
+    //! @brief Returns the number of persistent bytes in the newer layout.
+    //! @returns the number of bytes.
+    constexpr size_t numNewBytes() const { return this->m_numNewBytes; }
+
+    //! @brief Returns where a byte of the newer layout comes from.
+    //! @returns the offset in the older layout, or MigrationCopy::NEW_BYTE.
+    constexpr uint16_t source(size_t offset  //!< [in] Offset in the newer layout.
+    ) const {
+        return this->m_source[offset];
+    }
+
+ private:
+    uint16_t m_fromVersion;    //!< Version of the older layout.
+    size_t m_numOldBytes;      //!< Number of persistent bytes in the older layout.
+    size_t m_numNewBytes;      //!< Number of persistent bytes in the newer layout.
+    const uint16_t* m_source;  //!< Offset in the older layout of each byte.
+};
+
+//! @brief The migration steps which lead up to the current layout of a control table.
+//! @details Steps must be consecutive, ending with the step to the current version:
+//! @code
+//!     // Version 1 to 2 moved the calibration from 0x06 to 0x08.
+//!     static constexpr MigrationCopy V1_COPIES[] = {
+//!         // from  to    numBytes
+//!         {0x00,   0x00, 0x06},
+//!         {0x06,   0x08, 0x02},
+//!     };
+//!     static constexpr MigrationPlan<0x14> V1_PLAN{1, 0x10, V1_COPIES};
+//!     static constexpr MigrationPlan<0x18> V2_PLAN{2, 0x14, V2_COPIES};
+//!     static constexpr MigrationStep STEPS[] = {V1_PLAN, V2_PLAN};
+//!     static constexpr LayoutMigrations MIGRATIONS{3, STEPS};
+//! @endcode
+//!          Bytes saved using any older version are migrated to the current version in a
+//!          single pass, by following each byte back through the steps.
+class LayoutMigrations {
+ public:
+    //! @brief Constructor.
+    template <size_t NUM_STEPS>
+    constexpr LayoutMigrations(
+        uint16_t version,                        //!< [in] Current layout version.
+        const MigrationStep (&steps)[NUM_STEPS]  //!< [in] Steps, oldest first.
+        )
+        : m_version{version}, m_steps{steps}, m_numSteps{NUM_STEPS} {
+        for (size_t idx = 0; idx < NUM_STEPS; idx++) {
+            assert(steps[idx].fromVersion() + NUM_STEPS - idx == version);
+            assert(idx + 1 == NUM_STEPS ||
+                   steps[idx].numNewBytes() == steps[idx + 1].numOldBytes());
+        }
+    }
+
+    //! @brief Returns the current layout version.
+    //! @returns the version that persistent bytes are migrated to.
+    constexpr uint16_t version() const { return this->m_version; }
+
+    //! @brief Returns the number of persistent bytes in the current layout.
+    //! @returns the number of bytes produced by the last step.
+    constexpr size_t numBytes() const {
+        return this->m_numSteps == 0 ? 0 : this->m_steps[this->m_numSteps - 1].numNewBytes();
+    }
+
+    //! @brief Determines if persistent bytes can be migrated to the current version.
+    //! @returns true if there are steps from the version, and the size matches.
+    bool canMigrate(
+        uint16_t fromVersion,  //!< [in] Version of the stored bytes.
+        size_t numOldBytes     //!< [in] Number of stored bytes.
+    ) const;
+
+    //! @brief Migrates persistent bytes to the current version.
+    //! @details Bytes of the current layout which don't come from the older layout are left
+    //!          alone, so newBytes should already contain the initial values.
+    //! @returns true if the bytes were migrated.
+    //! @returns false if the older layout can't be migrated, or numNewBytes isn't numBytes().
+    bool migrate(
+        uint16_t fromVersion,     //!< [in] Version of the stored bytes.
+        const uint8_t* oldBytes,  //!< [in] Stored bytes.
+        size_t numOldBytes,       //!< [in] Number of stored bytes.
+        uint8_t* newBytes,        //!< [in,out] Persistent bytes using the current layout.
+        size_t numNewBytes        //!< [in] Number of persistent bytes in the current layout.
+    ) const;
+
+ private:
+    uint16_t m_version;            //!< Current layout version.
+    const MigrationStep* m_steps;  //!< Steps, oldest first.
+    size_t m_numSteps;             //!< Number of steps.
+};
+
+}  // namespace bioloid
+
+//! @}
@@ -113,6 +113,20 @@ class Packet {
         return this->m_length - 2;
     }
 
+    //! Returns the parameter data.
+    //! @returns a pointer to the parameter data.
+    const uint8_t* params() const { return this->m_params; }
+
+    //! Returns the parameter storage.
+    //! @details This allows the parameter data to be written in place, and is normally
+    //!          followed by a call to params(numParams).
+    //! @returns a pointer to the parameter storage.
+    uint8_t* params() { return this->m_params; }
+
+    //! Returns the maximum number of parameter bytes which can be stored in the packet.
+    //! @returns the maximum number of parameter bytes.
+    uint8_t maxParams() const { return this->m_maxParams; }
+
     //! Sets the parameter bytes
     void params(
         size_t numParams,   //!< [in] Number of bytes of parameter data.
@@ -0,0 +1,133 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   RedundantStorage.cpp
+ *
+ *   @brief  Control table storage which alternates between two slots.
+ *
+ ****************************************************************************/
+
+#include "RedundantStorage.h"
+
+#include <cstring>
+#include <initializer_list>
+#include <limits>
+
+#include "Crc32.h"
+#include "StorageUtil.h"
+
+bioloid::RedundantStorage::RedundantStorage(
+    IControlTableStorage& storage,
+    SizeType numPersistentBytes,
+    uint8_t* image)
+    : m_storage{storage}, m_numPersistentBytes{numPersistentBytes}, m_image{image} {
+    assert(this->m_image != nullptr);
+    // The second slot starts right after the first one.
+    assert(slotBytes(this->m_numPersistentBytes) <= std::numeric_limits<OffsetType>::max());
+}
+
+bool bioloid::RedundantStorage::readHeader(size_t slot, uint32_t* generation, uint32_t* dataCrc) {
+    uint8_t header[HEADER_BYTES];
+    auto offset = static_cast<OffsetType>(slot * slotBytes(this->m_numPersistentBytes));
+    if (this->m_storage.load(offset, HEADER_BYTES, header) != Error::NONE ||
+        getLE(&header[4], 2) != this->m_numPersistentBytes || getLE(&header[6], 2) != MAGIC ||
+        getLE(&header[12], 4) != crc32(header, 12)) {
+        return false;
+    }
+    *generation = getLE(&header[0], 4);
+    *dataCrc = getLE(&header[8], 4);
+    return true;
+}
+
+bool bioloid::RedundantStorage::readData(size_t slot, uint32_t dataCrc) {
+    auto offset = static_cast<OffsetType>(
+        slot * slotBytes(this->m_numPersistentBytes) + HEADER_BYTES);
+    uint8_t* data = &this->m_image[HEADER_BYTES];
+    return this->m_storage.load(offset, this->m_numPersistentBytes, data) == Error::NONE &&
+           crc32(data, this->m_numPersistentBytes) == dataCrc;
+}
+
+bioloid::IControlTableStorage::Error bioloid::RedundantStorage::readSlots() {
+    uint32_t generation[2];
+    uint32_t dataCrc[2];
+    bool valid[2];
+    for (size_t slot = 0; slot < 2; slot++) {
+        valid[slot] = this->readHeader(slot, &generation[slot], &dataCrc[slot]);
+    }
+
+    // Generation numbers wrap around, so compare them using their difference.
+    size_t newest = 0;
+    if (!valid[0] || (valid[1] && static_cast<int32_t>(generation[1] - generation[0]) > 0)) {
+        newest = 1;
+    }
+    for (size_t slot : {newest, 1 - newest}) {
+        if (valid[slot] && this->readData(slot, dataCrc[slot])) {
+            this->m_activeSlot = slot;
+            this->m_generation = generation[slot];
+            this->m_loaded = true;
+            return Error::NONE;
+        }
+    }
+    if (valid[newest]) {
+        // Keep counting from the newest header, so that a later load prefers the next save.
+        this->m_activeSlot = newest;
+        this->m_generation = generation[newest];
+    }
+    return Error::FAILED;
+}
+
+bioloid::IControlTableStorage::Error
+bioloid::RedundantStorage::load(OffsetType offset, SizeType numBytes, void* data) {
+    if (offset + numBytes > this->m_numPersistentBytes) {
+        return Error::FAILED;
+    }
+    if (!this->m_loaded && this->readSlots() != Error::NONE) {
+        return Error::FAILED;
+    }
+    memcpy(data, &this->m_image[HEADER_BYTES + offset], numBytes);
+    return Error::NONE;
+}
+
+bioloid::IControlTableStorage::Error
+bioloid::RedundantStorage::save(OffsetType offset, SizeType numBytes, const void* data) {
+    if (offset + numBytes > this->m_numPersistentBytes) {
+        return Error::FAILED;
+    }
+    memcpy(&this->m_image[HEADER_BYTES + offset], data, numBytes);
+    this->m_pending = true;
+    return Error::NONE;
+}
+
+bioloid::IControlTableStorage::Error bioloid::RedundantStorage::commit() {
+    if (!this->m_pending) {
+        return Error::NONE;
+    }
+    // Overwrite the older slot, which is the first slot if neither is valid.
+    size_t slot = this->m_activeSlot == 0 ? 1 : 0;
+    uint32_t generation = this->m_generation + 1;
+    putLE(&this->m_image[0], generation, 4);
+    putLE(&this->m_image[4], this->m_numPersistentBytes, 2);
+    putLE(&this->m_image[6], MAGIC, 2);
+    putLE(&this->m_image[8], crc32(&this->m_image[HEADER_BYTES], this->m_numPersistentBytes), 4);
+    putLE(&this->m_image[12], crc32(this->m_image, 12), 4);
+
+    auto numBytes = static_cast<SizeType>(slotBytes(this->m_numPersistentBytes));
+    auto offset = static_cast<OffsetType>(slot * numBytes);
+    if (this->m_storage.save(offset, numBytes, this->m_image) != Error::NONE ||
+        this->m_storage.commit() != Error::NONE) {
+        // The active slot is still intact, so the next commit() overwrites the same slot.
+        return Error::FAILED;
+    }
+    this->m_activeSlot = slot;
+    this->m_generation = generation;
+    this->m_loaded = true;
+    this->m_pending = false;
+    return Error::NONE;
+}
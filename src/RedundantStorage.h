@@ -0,0 +1,114 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   RedundantStorage.h
+ *
+ *   @brief  Control table storage which alternates between two slots.
+ *
+ ****************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "ControlTable.h"
+
+//! @addtogroup bioloid
+//! @{
+
+namespace bioloid {
+
+//! @brief Crash-safe control table storage which alternates saves between two slots.
+//! @details The slots are stored one after the other in another storage object (e.g. a
+//!          FileStorage, a FlashSimStorage, or a FileStorage opened on a block device), so
+//!          no rename is needed. Each slot contains a header followed by the persistent
+//!          bytes. The header holds a generation number, the number of persistent bytes, the
+//!          CRC-32 of the persistent bytes and the CRC-32 of the rest of the header, all
+//!          stored little endian.
+//!
+//!          save() only updates an in-memory image of the slot. commit() writes the whole
+//!          slot, with the next generation number, over the older of the two slots using a
+//!          single save() of the underlying storage, so the newer slot survives if power is
+//!          lost part way through.
+//!
+//!          load() reads both headers and then the persistent bytes of the newest slot whose
+//!          header is valid, falling back to the other slot if its persistent bytes don't
+//!          match their CRC, so loading takes at most four reads no matter how many saves
+//!          have been made. load() must be called before the first commit() (which
+//!          IControlTable does), so that the older slot is known.
+//!
+//!          The underlying storage is addressed using OffsetType, so both slots must fit
+//!          within the address range of the control table.
+class RedundantStorage : public IControlTableStorage {
+ public:
+    static constexpr uint16_t MAGIC = 0x4241;   //!< "AB" in little endian.
+    static constexpr size_t HEADER_BYTES = 16;  //!< Size of the header of each slot.
+    static constexpr size_t NO_SLOT = 2;        //!< Returned by activeSlot() before a load.
+
+    //! @brief Determines the size of each slot.
+    //! @returns the number of bytes in the image (and each slot).
+    static constexpr size_t slotBytes(
+        size_t numPersistentBytes  //!< [in] Number of persistent bytes in the table.
+    ) {
+        return HEADER_BYTES + numPersistentBytes;
+    }
+
+    //! @brief Constructor.
+    RedundantStorage(
+        IControlTableStorage& storage,  //!< [in] Storage containing both slots.
+        SizeType numPersistentBytes,    //!< [in] Number of persistent bytes.
+        uint8_t* image                  //!< [in] Storage for slotBytes(numPersistentBytes).
+    );
+
+    Error load(OffsetType offset, SizeType numBytes, void* data) override;
+    Error save(OffsetType offset, SizeType numBytes, const void* data) override;
+    Error commit() override;
+
+    //! @brief Returns the slot containing the newest saved table.
+    //! @returns 0 or 1, or NO_SLOT if neither slot is valid.
+    size_t activeSlot() const { return this->m_activeSlot; }
+
+    //! @brief Returns the generation number of the newest saved table.
+    //! @returns the generation number (0 if nothing has been saved).
+    uint32_t generation() const { return this->m_generation; }
+
+ private:
+    //! @brief Reads and validates the header of a slot.
+    //! @returns true if the header is valid.
+    bool readHeader(
+        size_t slot,           //!< [in] Index of the slot.
+        uint32_t* generation,  //!< [out] Generation number of the slot.
+        uint32_t* dataCrc      //!< [out] CRC-32 of the persistent bytes in the slot.
+    );
+
+    //! @brief Reads the persistent bytes of a slot into the image.
+    //! @returns true if the persistent bytes match the CRC.
+    bool readData(
+        size_t slot,      //!< [in] Index of the slot.
+        uint32_t dataCrc  //!< [in] CRC-32 from the slot's header.
+    );
+
+    //! @brief Finds the newest valid slot, and reads it into the image.
+    //! @returns Error::NONE if a valid slot was found.
+    Error readSlots();
+
+    IControlTableStorage& m_storage;      //!< Storage containing both slots.
+    const SizeType m_numPersistentBytes;  //!< Number of persistent bytes.
+    uint8_t* const m_image;               //!< Header and persistent bytes.
+    size_t m_activeSlot = NO_SLOT;        //!< Slot containing the newest table.
+    uint32_t m_generation = 0;            //!< Generation number of the newest table.
+    bool m_loaded = false;                //!< true if the slots have been read.
+    bool m_pending = false;               //!< true if save() was called since commit().
+};
+
+}  // namespace bioloid
+
+//! @}
@@ -0,0 +1,94 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   SeqLock.h
+ *
+ *   @brief  Sequence lock which allows lock-free reads of data with a single writer.
+ *
+ ****************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+//! @addtogroup bioloid
+//! @{
+
+namespace bioloid {
+
+//! @brief Sequence lock protecting data which has a single writer and many readers.
+//! @details The writer increments the sequence number before and after modifying the data,
+//!          so the sequence number is odd while a modification is in progress. Readers
+//!          copy the data and then check that the sequence number didn't change, retrying
+//!          if it did. Readers never block the writer.
+//!
+//!          SeqLock is standard layout and only contains an atomic uint32_t, so on hosts
+//!          where that is lock-free it can be placed in memory shared between processes.
+class SeqLock {
+ public:
+    //! @brief Called by the writer before modifying the protected data.
+    void writeBegin() {
+        this->m_sequence.store(this->m_sequence.load(std::memory_order_relaxed) + 1,
+                               std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    //! @brief Called by the writer after modifying the protected data.
+    void writeEnd() {
+        this->m_sequence.store(this->m_sequence.load(std::memory_order_relaxed) + 1,
+                               std::memory_order_release);
+    }
+
+    //! @brief Called by a reader before reading the protected data.
+    //! @details Waits for any modification in progress to complete.
+    //! @returns the sequence number to pass to readRetry().
+    uint32_t readBegin() const {
+        uint32_t sequence;
+        while (((sequence = this->m_sequence.load(std::memory_order_acquire)) & 1) != 0) {
+        }
+        return sequence;
+    }
+
+    //! @brief Called by a reader after reading the protected data.
+    //! @returns true if the data was modified while it was being read, and the read needs
+    //!          to be retried.
+    bool readRetry(uint32_t sequence  //!< [in] Sequence number returned from readBegin().
+    ) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return this->m_sequence.load(std::memory_order_relaxed) != sequence;
+    }
+
+    //! @brief Copies a consistent snapshot of some protected data.
+    void read(
+        const void* src,  //!< [in] Protected data to copy.
+        size_t numBytes,  //!< [in] Number of bytes to copy.
+        void* dst         //!< [out] Place to store the copy.
+    ) const {
+        uint32_t sequence;
+        do {
+            sequence = this->readBegin();
+            memcpy(dst, src, numBytes);
+        } while (this->readRetry(sequence));
+    }
+
+    //! @brief Returns the current sequence number.
+    //! @returns the sequence number, which is odd while a modification is in progress.
+    uint32_t sequence() const { return this->m_sequence.load(std::memory_order_acquire); }
+
+ private:
+    std::atomic<uint32_t> m_sequence{0};  //!< Incremented before and after each modification.
+};
+
+}  // namespace bioloid
+
+//! @}
@@ -0,0 +1,53 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   StorageUtil.h
+ *
+ *   @brief  Byte order helpers shared by the control table storage classes.
+ *
+ ****************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+//! @addtogroup bioloid
+//! @{
+
+namespace bioloid {
+
+//! @brief Stores a value in little endian byte order.
+inline void putLE(
+    uint8_t* dst,    //!< [out] Place to store the value.
+    uint32_t value,  //!< [in] Value to store.
+    size_t numBytes  //!< [in] Number of bytes to store.
+) {
+    for (size_t idx = 0; idx < numBytes; idx++) {
+        dst[idx] = static_cast<uint8_t>(value >> (8 * idx));
+    }
+}
+
+//! @brief Retrieves a value stored in little endian byte order.
+//! @returns the value.
+inline uint32_t getLE(
+    const uint8_t* src,  //!< [in] Place where the value is stored.
+    size_t numBytes      //!< [in] Number of bytes to retrieve.
+) {
+    uint32_t value = 0;
+    for (size_t idx = 0; idx < numBytes; idx++) {
+        value |= static_cast<uint32_t>(src[idx]) << (8 * idx);
+    }
+    return value;
+}
+
+}  // namespace bioloid
+
+//! @}
@@ -0,0 +1,142 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   TypedControlTable.h
+ *
+ *   @brief  Control table whose fields are checked at compile time.
+ *
+ ****************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "ControlTable.h"
+
+//! @addtogroup bioloid
+//! @{
+
+namespace bioloid {
+
+//! @brief Declares a field within a typed control table.
+//! @details Fields are declared as types within a schema, by deriving from Field:
+//! @code
+//!     struct Fields {
+//!         struct GoalPosition : bioloid::Field<0x1E, uint16_t> {};
+//!     };
+//! @endcode
+//! @tparam FIELD_OFFSET - offset of the field within the control table.
+//! @tparam T - type of the value stored in the field.
+template <IControlTable::Offset::Type FIELD_OFFSET, typename T>
+struct Field {
+    static_assert(std::is_integral_v<T>);
+
+    using ValueType = T;  //!< Type of the value stored in the field.
+
+    static constexpr IControlTable::Offset::Type OFFSET = FIELD_OFFSET;  //!< Offset of the field.
+    static constexpr size_t SIZE = sizeof(T);  //!< Size of the field, in bytes.
+};
+
+//! @brief Control table whose layout is described by a schema type.
+//! @details The schema provides the size of the control table:
+//! @code
+//!     struct Schema {
+//!         static constexpr uint8_t NUM_CTL_BYTES = 0x32;
+//!         static constexpr uint8_t NUM_PERSISTENT_BYTES = 0x18;
+//!     };
+//! @endcode
+//!          Device-side code accesses fields using get<Field>() and set<Field>(), which
+//!          are bounds checked at compile time, while the packet dispatcher continues to
+//!          use the IControlTable interface.
+//! @tparam Schema - type describing the layout of the control table.
+template <typename Schema>
+class ControlTable : public IControlTable {
+ public:
+    static_assert(Schema::NUM_PERSISTENT_BYTES <= Schema::NUM_CTL_BYTES);
+
+    //! @brief Constructor.
+    ControlTable(
+        IControlTableStorage& storage,       //!< [in] Class which actually persists the data.
+        IPort* port,                         //!< [in] Port associated with the device.
+        const FieldSchema* schema = nullptr  //!< [in] Describes the fields in the table.
+        )
+        : IControlTable(
+              Schema::NUM_CTL_BYTES,
+              Schema::NUM_PERSISTENT_BYTES,
+              this->m_bytes,
+              storage,
+              port,
+              schema) {}
+
+    using IControlTable::get;
+    using IControlTable::set;
+
+    //! @brief Retrieves the value of a field.
+    //! @details This is intended for device-side code, so populateEntry() isn't called.
+    //!          On little endian hosts this compiles to a single load (plus counting the
+    //!          read when BIOLOID_CTL_HEATMAP is enabled).
+    //! @tparam F - field to retrieve.
+    //! @returns the value of the field.
+    template <typename F>
+    typename F::ValueType get() const {
+        static_assert(F::OFFSET + F::SIZE <= Schema::NUM_CTL_BYTES);
+
+        this->countRead(F::OFFSET, F::SIZE);
+        typename F::ValueType val;
+        memcpy(&val, &this->m_bytes[F::OFFSET], F::SIZE);
+        return fromLittleEndian(val);
+    }
+
+    //! @brief Sets the value of a field.
+    //! @details The same bookkeeping is performed as for IControlTable::set().
+    //! @tparam F - field to set.
+    template <typename F>
+    void set(typename F::ValueType val  //!< [in] Value to store in the field.
+    ) {
+        static_assert(F::OFFSET + F::SIZE <= Schema::NUM_CTL_BYTES);
+
+        val = fromLittleEndian(val);
+        if (this->m_seqLock != nullptr) {
+            this->m_seqLock->writeBegin();
+        }
+        memcpy(&this->m_bytes[F::OFFSET], &val, F::SIZE);
+        if (this->m_seqLock != nullptr) {
+            this->m_seqLock->writeEnd();
+        }
+        this->countWrite(F::OFFSET, F::SIZE);
+        this->modified(F::OFFSET, F::SIZE);
+    }
+
+ private:
+    //! @brief Converts a value between little endian and host byte order.
+    //! @returns the converted value.
+    template <typename T>
+    static constexpr T fromLittleEndian(T val  //!< [in] Value to convert.
+    ) {
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+        T result = 0;
+        for (size_t i = 0; i < sizeof(T); i++) {
+            result = (result << 8) | ((val >> (i * 8)) & 0xff);
+        }
+        return result;
+#else
+        return val;
+#endif
+    }
+
+    uint8_t m_bytes[Schema::NUM_CTL_BYTES];  //!< Storage for the control table.
+};
+
+}  // namespace bioloid
+
+//! @}
@@ -1,4 +1,18 @@
 SOURCES_CPP += \
+    AccessHeatmap.cpp \
+    ChangeJournal.cpp \
+    ColumnStore.cpp \
+    ContainerStorage.cpp \
     ControlTable.cpp \
+    ControlTableDiff.cpp \
+    ControlTableObservers.cpp \
+    ControlTableSchema.cpp \
+    Crc32.cpp \
+    Device.cpp \
+    FieldCache.cpp \
     FileStorage.cpp \
-    Packet.cpp
+    FlashSimStorage.cpp \
+    IndirectMap.cpp \
+    LayoutMigration.cpp \
+    Packet.cpp \
+    RedundantStorage.cpp
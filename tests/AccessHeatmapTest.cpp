@@ -0,0 +1,152 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   AccessHeatmapTest.cpp
+ *
+ *   @brief  Tests counting of control table accesses.
+ *
+ ****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+#include "AccessHeatmap.h"
+#include "ControlTable.h"
+#include "Device.h"
+#include "Packet.h"
+#include "TestUtil.h"
+#include "TypedControlTable.h"
+#include "Util.h"
+
+//! Convenience aliases
+//! @{
+using AccessHeatmap = bioloid::AccessHeatmap;
+//! @}
+
+TEST(AccessHeatmapTest, Record) {
+    uint32_t reads[8];
+    uint32_t writes[8];
+    AccessHeatmap heatmap{LEN(reads), reads, writes};
+
+    EXPECT_EQ(reads[0], 0u);
+    heatmap.recordRead(2, 2);
+    heatmap.recordRead(3, 1);
+    heatmap.recordWrite(7, 1);
+    EXPECT_EQ(heatmap.reads()[2], 1u);
+    EXPECT_EQ(heatmap.reads()[3], 2u);
+    EXPECT_EQ(heatmap.reads()[4], 0u);
+    EXPECT_EQ(heatmap.writes()[7], 1u);
+    EXPECT_EQ(heatmap.writes()[3], 0u);
+
+    heatmap.reset();
+    EXPECT_EQ(heatmap.reads()[3], 0u);
+    EXPECT_EQ(heatmap.writes()[7], 0u);
+}
+
+#if BIOLOID_CTL_HEATMAP
+
+//! @brief Control table whose accesses are counted.
+class HeatmapControlTable : public bioloid::IControlTable {
+ public:
+    //! @brief Total number of bytes in the control table.
+    static constexpr uint8_t NUM_CTL_BYTES = 0x20;
+
+    HeatmapControlTable()
+        : IControlTable(NUM_CTL_BYTES, 0x10, this->m_ctlBytes, this->m_storage, &this->m_port),
+          counts{NUM_CTL_BYTES, this->m_reads, this->m_writes} {
+        this->setToInitialValues();
+        this->heatmap(&this->counts);
+    }
+
+    AccessHeatmap counts;  //!< Access counts for the control table.
+
+ private:
+    uint8_t m_ctlBytes[NUM_CTL_BYTES];
+    uint32_t m_reads[NUM_CTL_BYTES];
+    uint32_t m_writes[NUM_CTL_BYTES];
+    NullStorage m_storage;
+    TestPort m_port;
+};
+
+TEST(AccessHeatmapTest, ControlTable) {
+    HeatmapControlTable test;
+    using Offset = HeatmapControlTable::Offset;
+
+    test.get_u8(Offset::ID);
+    test.get_u16(Offset::MODEL);
+    test.set(Offset::LED, uint8_t{1});
+
+    uint8_t data[4] = {};
+    EXPECT_EQ(test.read(Offset::ID, LEN(data), data), bioloid::Error::NONE);
+    EXPECT_EQ(test.write(0x10, data, LEN(data)), bioloid::Error::NONE);
+
+    // Rejected writes aren't counted.
+    EXPECT_EQ(test.write(0x1F, data, LEN(data)), bioloid::Error::RANGE);
+
+    EXPECT_EQ(test.counts.reads()[Offset::ID], 2u);
+    EXPECT_EQ(test.counts.reads()[Offset::MODEL + 1], 1u);
+    EXPECT_EQ(test.counts.reads()[Offset::ID + 3], 1u);
+    EXPECT_EQ(test.counts.writes()[Offset::LED], 1u);
+    EXPECT_EQ(test.counts.writes()[0x13], 1u);
+    EXPECT_EQ(test.counts.writes()[0x1F], 0u);
+}
+
+TEST(AccessHeatmapTest, InternalReadsArentCounted) {
+    HeatmapControlTable test;
+    using Offset = HeatmapControlTable::Offset;
+    bioloid::Device device{test};
+
+    // Checking the ID of each packet, and applying a new baud rate, aren't reads by the master.
+    uint8_t cmdParams[4];
+    uint8_t rspParams[4];
+    bioloid::Packet cmd{LEN(cmdParams), cmdParams};
+    bioloid::Packet rsp{LEN(rspParams), rspParams};
+    cmd.id(HeatmapControlTable::DEFAULT_DEVICE_ID);
+    cmd.command(bioloid::Command::PING);
+    cmd.params({});
+    EXPECT_TRUE(device.processPacket(cmd, &rsp));
+    test.set(Offset::BAUD, uint8_t{3});
+
+    EXPECT_EQ(test.counts.reads()[Offset::ID], 0u);
+    EXPECT_EQ(test.counts.reads()[Offset::BAUD], 0u);
+    EXPECT_EQ(test.counts.writes()[Offset::BAUD], 1u);
+}
+
+//! @brief Layout of a typed control table whose accesses are counted.
+struct HeatmapSchema {
+    static constexpr uint8_t NUM_CTL_BYTES = 0x20;         //!< Total number of bytes.
+    static constexpr uint8_t NUM_PERSISTENT_BYTES = 0x10;  //!< Number of persistent bytes.
+
+    //! @brief Fields within the control table.
+    struct Fields {
+        struct Goal : bioloid::Field<0x1E, uint16_t> {};  //!< Goal position
+    };
+};
+
+TEST(AccessHeatmapTest, TypedControlTable) {
+    NullStorage storage;
+    TestPort port;
+    bioloid::ControlTable<HeatmapSchema> test{storage, &port};
+    uint32_t reads[HeatmapSchema::NUM_CTL_BYTES];
+    uint32_t writes[HeatmapSchema::NUM_CTL_BYTES];
+    AccessHeatmap counts{HeatmapSchema::NUM_CTL_BYTES, reads, writes};
+    test.setToInitialValues();
+    test.heatmap(&counts);
+
+    using Goal = HeatmapSchema::Fields::Goal;
+    test.set<Goal>(0x123);
+    EXPECT_EQ(test.get<Goal>(), 0x123);
+    EXPECT_EQ(counts.writes()[Goal::OFFSET], 1u);
+    EXPECT_EQ(counts.writes()[Goal::OFFSET + 1], 1u);
+    EXPECT_EQ(counts.reads()[Goal::OFFSET + 1], 1u);
+}
+
+#endif  // BIOLOID_CTL_HEATMAP
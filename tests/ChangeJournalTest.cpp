@@ -0,0 +1,234 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   ChangeJournalTest.cpp
+ *
+ *   @brief  Tests replicating a control table using a journal of changes.
+ *
+ ****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+#include "ChangeJournal.h"
+#include "ControlTable.h"
+#include "ControlTableObservers.h"
+#include "SeqLock.h"
+#include "TestUtil.h"
+#include "Util.h"
+
+//! Convenience aliases
+//! @{
+using ChangeJournal = bioloid::ChangeJournal;
+using Error = bioloid::Error;
+using JournalReplica = bioloid::JournalReplica;
+using ObserverRegistry = bioloid::ObserverRegistry;
+//! @}
+
+//! @brief Storage which keeps the persistent bytes in memory.
+class MemoryStorage : public bioloid::IControlTableStorage {
+ public:
+    Error load(OffsetType offset, SizeType numBytes, void* data) override {
+        if (!this->valid) {
+            return Error::FAILED;
+        }
+        memcpy(data, &this->bytes[offset], numBytes);
+        return Error::NONE;
+    }
+
+    Error save(OffsetType offset, SizeType numBytes, const void* data) override {
+        memcpy(&this->bytes[offset], data, numBytes);
+        this->valid = true;
+        return Error::NONE;
+    }
+
+    uint8_t bytes[0x18] = {};  //!< Persistent bytes.
+    bool valid = false;        //!< true once something has been saved.
+};
+
+//! @brief Control table which records its changes in a journal.
+class JournaledControlTable : public bioloid::IControlTable {
+ public:
+    //! @brief Total number of bytes in the control table.
+    static constexpr uint8_t NUM_CTL_BYTES = 0x40;
+
+    //! @brief Number of changes that the journal holds.
+    static constexpr size_t NUM_ENTRIES = 8;
+
+    //! @brief Offset of a 32-bit field used for testing.
+    static constexpr Offset::Type COUNTER = 0x30;
+
+    //! @brief Offset of a field which is sampled by populateEntry().
+    static constexpr Offset::Type TEMPERATURE = 0x2B;
+
+    JournaledControlTable()
+        : IControlTable(NUM_CTL_BYTES, 0x18, this->m_ctlBytes, this->storage, &this->m_port),
+          journal{this->m_entries, NUM_ENTRIES},
+          m_registry{NUM_CTL_BYTES, this->m_masks} {
+        this->setToInitialValues();
+        this->seqLock(&this->m_lock);
+        this->observers(&this->m_registry);
+        this->m_registry.subscribe(&this->journal, 0, NUM_CTL_BYTES);
+    }
+
+    ChangeJournal journal;    //!< Changes to this control table.
+    uint8_t temperature = 0;  //!< Value sampled for TEMPERATURE.
+    MemoryStorage storage;    //!< Storage for the persistent bytes.
+
+ protected:
+    void populateEntry(Offset::Type offset, SizeType numBytes) const override {
+        if (overlaps(offset, numBytes, TEMPERATURE)) {
+            this->IControlTable::m_ctlBytes[TEMPERATURE] = this->temperature;
+            this->sampled(TEMPERATURE, 1);
+        }
+    }
+
+ private:
+    uint8_t m_ctlBytes[NUM_CTL_BYTES];
+    ChangeJournal::Entry m_entries[NUM_ENTRIES];
+    ObserverRegistry::Mask m_masks[NUM_CTL_BYTES];
+    ObserverRegistry m_registry;
+    bioloid::SeqLock m_lock;
+    TestPort m_port;
+};
+
+using Offset = JournaledControlTable::Offset;  //!< Convenience alias
+using Result = ChangeJournal::Result;          //!< Convenience alias
+
+TEST(ChangeJournalTest, Record) {
+    JournaledControlTable table;
+    EXPECT_EQ(table.journal.head(), 0u);
+
+    ChangeJournal::Change change;
+    EXPECT_EQ(table.journal.read(1, &change), Result::EMPTY);
+
+    table.set(Offset::RDT, uint16_t{0x1234});
+    EXPECT_EQ(table.journal.head(), 1u);
+    ASSERT_EQ(table.journal.read(1, &change), Result::CHANGE);
+    EXPECT_EQ(change.sequence, 1u);
+    EXPECT_EQ(change.offset, Offset::RDT);
+    EXPECT_EQ(change.numBytes, 2);
+    EXPECT_EQ(change.data[0], 0x34);
+    EXPECT_EQ(change.data[1], 0x12);
+
+    // Large writes are split into several changes.
+    uint8_t data[ChangeJournal::MAX_CHANGE_BYTES + 4];
+    memset(data, 0x5A, sizeof(data));
+    EXPECT_EQ(table.write(Offset::LED + 1, data, LEN(data)), Error::NONE);
+    EXPECT_EQ(table.journal.head(), 3u);
+    ASSERT_EQ(table.journal.read(3, &change), Result::CHANGE);
+    EXPECT_EQ(change.offset, Offset::LED + 1 + ChangeJournal::MAX_CHANGE_BYTES);
+    EXPECT_EQ(change.numBytes, 4);
+}
+
+TEST(ChangeJournalTest, Overrun) {
+    JournaledControlTable table;
+    for (uint8_t i = 0; i < JournaledControlTable::NUM_ENTRIES + 1; i++) {
+        table.set(Offset::LED, i);
+    }
+
+    // The first change has been overwritten, but the rest are still available.
+    ChangeJournal::Change change;
+    EXPECT_EQ(table.journal.read(1, &change), Result::OVERRUN);
+    ASSERT_EQ(table.journal.read(2, &change), Result::CHANGE);
+    EXPECT_EQ(change.data[0], 1);
+}
+
+TEST(ChangeJournalTest, Replica) {
+    JournaledControlTable table;
+    uint8_t replica[JournaledControlTable::NUM_CTL_BYTES] = {};
+    JournalReplica sync{table.journal, replica, LEN(replica)};
+
+    // The first sync takes a snapshot.
+    table.set(Offset::LED, uint8_t{1});
+    EXPECT_EQ(sync.sync(table), 0u);
+    EXPECT_EQ(sync.numSnapshots(), 1u);
+    EXPECT_EQ(memcmp(replica, table.ctlBytes(), LEN(replica)), 0);
+
+    // Changes are replayed incrementally.
+    table.set(Offset::RDT, uint8_t{10});
+    table.set(Offset::LED, uint8_t{0});
+    EXPECT_EQ(sync.sync(table), 2u);
+    EXPECT_EQ(sync.numSnapshots(), 1u);
+    EXPECT_EQ(memcmp(replica, table.ctlBytes(), LEN(replica)), 0);
+
+    // Falling too far behind causes another snapshot.
+    for (uint8_t i = 0; i < 2 * JournaledControlTable::NUM_ENTRIES; i++) {
+        table.set(Offset::RDT, i);
+    }
+    EXPECT_EQ(sync.sync(table), 0u);
+    EXPECT_EQ(sync.numSnapshots(), 2u);
+    EXPECT_EQ(sync.next(), table.journal.head() + 1);
+    EXPECT_EQ(memcmp(replica, table.ctlBytes(), LEN(replica)), 0);
+}
+
+TEST(ChangeJournalTest, ReplicaAfterLoad) {
+    JournaledControlTable table;
+    uint8_t replica[JournaledControlTable::NUM_CTL_BYTES] = {};
+    JournalReplica sync{table.journal, replica, LEN(replica)};
+
+    table.set(Offset::ID, uint8_t{7});
+    EXPECT_EQ(table.save(), bioloid::IControlTableStorage::Error::NONE);
+    table.set(Offset::ID, uint8_t{8});
+    table.set(Offset::LED, uint8_t{1});
+    sync.sync(table);
+
+    // Reloading replaces the whole table, which is recorded as a change.
+    table.load();
+    EXPECT_EQ(table.get_u8(Offset::ID), 7);
+    EXPECT_GT(sync.sync(table), 0u);
+    EXPECT_EQ(sync.numSnapshots(), 1u);
+    EXPECT_EQ(memcmp(replica, table.ctlBytes(), LEN(replica)), 0);
+}
+
+TEST(ChangeJournalTest, ReplicaSampled) {
+    JournaledControlTable table;
+    uint8_t replica[JournaledControlTable::NUM_CTL_BYTES] = {};
+    JournalReplica sync{table.journal, replica, LEN(replica)};
+    sync.sync(table);
+
+    // Values stored by populateEntry() are replayed too.
+    table.temperature = 40;
+    EXPECT_EQ(table.get_u8(JournaledControlTable::TEMPERATURE), 40);
+    EXPECT_EQ(sync.sync(table), 1u);
+    EXPECT_EQ(replica[JournaledControlTable::TEMPERATURE], 40);
+}
+
+TEST(ChangeJournalTest, Concurrent) {
+    JournaledControlTable table;
+    uint8_t replica[JournaledControlTable::NUM_CTL_BYTES] = {};
+    JournalReplica sync{table.journal, replica, LEN(replica)};
+    sync.sync(table);
+
+    // The replica never sees a value which the table didn't contain.
+    std::atomic<bool> done{false};
+    std::thread writer([&table, &done]() {
+        for (uint32_t i = 1; i <= 100000; i++) {
+            table.set(JournaledControlTable::COUNTER, (i & 0xFF) * 0x01010101u);
+        }
+        done = true;
+    });
+    uint32_t counter;
+    bool consistent = true;
+    while (!done) {
+        sync.sync(table);
+        memcpy(&counter, &replica[JournaledControlTable::COUNTER], sizeof(counter));
+        consistent &= (counter & 0xFF) * 0x01010101u == counter;
+    }
+    writer.join();
+    sync.sync(table);
+
+    EXPECT_TRUE(consistent);
+    EXPECT_EQ(memcmp(replica, table.ctlBytes(), LEN(replica)), 0);
+}
@@ -0,0 +1,92 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   ColumnStoreTest.cpp
+ *
+ *   @brief  Tests the column store used for fields from many devices.
+ *
+ ****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+#include "ColumnStore.h"
+#include "Util.h"
+
+//! Convenience aliases
+//! @{
+using ColumnDesc = bioloid::ColumnDesc;
+using ColumnStore = bioloid::ColumnStore;
+//! @}
+
+//! @brief Offsets of the fields stored in columns.
+struct Offset : public bioloid::IControlTable::Offset {
+    static constexpr Type PRESENT_POSITION = 0x24;  //!< Present position (2 bytes)
+    static constexpr Type PRESENT_SPEED = 0x26;     //!< Present speed (2 bytes)
+    static constexpr Type PRESENT_VOLTAGE = 0x2A;   //!< Present voltage (1 byte)
+};
+
+//! @brief Fields stored in columns.
+static constexpr ColumnDesc COLUMNS[] = {
+    {Offset::PRESENT_POSITION, 2},
+    {Offset::PRESENT_SPEED, 2},
+    {Offset::PRESENT_VOLTAGE, 1},
+};
+
+//! @brief Number of devices in the store.
+static constexpr size_t NUM_DEVICES = 4;
+
+TEST(ColumnStoreTest, Update) {
+    uint16_t values[LEN(COLUMNS) * NUM_DEVICES];
+    ColumnStore store{COLUMNS, LEN(COLUMNS), NUM_DEVICES, values};
+
+    // A READ of position and speed.
+    uint8_t data[] = {0x34, 0x02, 0x10, 0x00};
+    EXPECT_EQ(store.update(1, Offset::PRESENT_POSITION, data, LEN(data)), 2u);
+    EXPECT_EQ(store.value(0, 1), 0x0234);
+    EXPECT_EQ(store.value(1, 1), 0x0010);
+    EXPECT_EQ(store.value(2, 1), 0);
+
+    // Fields which are only partially covered aren't updated.
+    EXPECT_EQ(store.update(2, Offset::PRESENT_POSITION + 1, data, 2), 0u);
+    EXPECT_EQ(store.value(0, 2), 0);
+
+    // A READ covering all of the fields.
+    uint8_t all[7] = {0xff, 0x03, 0x20, 0x00, 0x00, 0x00, 0x7B};
+    EXPECT_EQ(store.update(3, Offset::PRESENT_POSITION, all, LEN(all)), 3u);
+
+    const uint16_t* position = store.column(0);
+    EXPECT_EQ(position[0], 0);
+    EXPECT_EQ(position[1], 0x0234);
+    EXPECT_EQ(position[2], 0);
+    EXPECT_EQ(position[3], 0x03ff);
+    EXPECT_EQ(store.column(2)[3], 0x7B);
+}
+
+TEST(ColumnStoreTest, ConvertColumn) {
+    // Use an odd number of values so that the SIMD and scalar paths are both exercised.
+    uint16_t raw[19];
+    for (size_t i = 0; i < LEN(raw); i++) {
+        raw[i] = static_cast<uint16_t>(i * 100);
+    }
+    float converted[LEN(raw)];
+    bioloid::convertColumn(raw, LEN(raw), 512.0f, 0.5f, converted);
+    for (size_t i = 0; i < LEN(raw); i++) {
+        EXPECT_FLOAT_EQ(converted[i], (static_cast<float>(raw[i]) - 512.0f) * 0.5f);
+    }
+
+    // Values above 0x7fff must not be treated as negative.
+    uint16_t big[8] = {0xffff, 0x8000, 0, 1, 2, 3, 4, 5};
+    float bigConverted[LEN(big)];
+    bioloid::convertColumn(big, LEN(big), 0.0f, 1.0f, bigConverted);
+    EXPECT_FLOAT_EQ(bigConverted[0], 65535.0f);
+    EXPECT_FLOAT_EQ(bigConverted[1], 32768.0f);
+}
@@ -0,0 +1,167 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   ContainerStorageTest.cpp
+ *
+ *   @brief  Tests storing many control tables in a single file.
+ *
+ ****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstdio>
+
+#include "ContainerStorage.h"
+#include "ControlTable.h"
+#include "TestUtil.h"
+#include "Util.h"
+
+static constexpr const char* fileName = "ContainerStorageTest.ctl";
+
+//! Convenience aliases
+//! @{
+using ContainerSlot = bioloid::ContainerSlot;
+using ContainerStorage = bioloid::ContainerStorage;
+using Error = bioloid::IControlTableStorage::Error;
+//! @}
+
+//! @brief Control table stored in a slot of a container.
+class SlotControlTable : public bioloid::IControlTable {
+ public:
+    static constexpr uint8_t NUM_CTL_BYTES = 0x20;         //!< Number of control bytes.
+    static constexpr uint8_t NUM_PERSISTENT_BYTES = 0x18;  //!< Number of persistent bytes.
+
+    SlotControlTable(ContainerStorage& container, uint32_t key)
+        : IControlTable(
+              NUM_CTL_BYTES, NUM_PERSISTENT_BYTES, this->m_ctlBytes, this->m_storage,
+              &this->m_port),
+          m_storage{container, key} {}
+
+ private:
+    uint8_t m_ctlBytes[NUM_CTL_BYTES];
+    ContainerSlot m_storage;
+    TestPort m_port;
+};
+
+using Offset = SlotControlTable::Offset;  //!< Convenience alias
+
+static constexpr size_t NUM_SLOTS = 3;  //!< Number of slots in the test container.
+
+//! Number of bytes in each slot.
+static constexpr size_t SLOT_BYTES =
+    ContainerStorage::slotBytes(SlotControlTable::NUM_PERSISTENT_BYTES);
+
+//! Number of bytes in the test container.
+static constexpr size_t IMAGE_BYTES = ContainerStorage::imageBytes(NUM_SLOTS, SLOT_BYTES);
+
+//! @brief Returns the size of the test file.
+//! @returns the number of bytes in the file.
+static long fileSize() {
+    FILE* fs = fopen(fileName, "rb");
+    if (fs == nullptr) {
+        return -1;
+    }
+    fseek(fs, 0, SEEK_END);
+    long size = ftell(fs);
+    fclose(fs);
+    return size;
+}
+
+TEST(ContainerStorageTest, Layout) {
+    EXPECT_EQ(SLOT_BYTES, ContainerStorage::SLOT_ALIGN);
+    EXPECT_EQ(ContainerStorage::slotsOffset(NUM_SLOTS), ContainerStorage::SLOT_ALIGN);
+    EXPECT_EQ(IMAGE_BYTES, (NUM_SLOTS + 1) * ContainerStorage::SLOT_ALIGN);
+}
+
+TEST(ContainerStorageTest, ManyTables) {
+    remove(fileName);
+    {
+        uint8_t image[IMAGE_BYTES];
+        ContainerStorage container{fileName, NUM_SLOTS, SLOT_BYTES, image};
+        ASSERT_TRUE(container.open());
+        EXPECT_EQ(fileSize(), static_cast<long>(IMAGE_BYTES));
+
+        for (uint8_t id = 1; id <= NUM_SLOTS; id++) {
+            SlotControlTable test{container, id * 100u};
+            test.load();
+            EXPECT_EQ(test.get_u8(Offset::ID), SlotControlTable::DEFAULT_DEVICE_ID);
+            test.set(Offset::ID, id);
+            EXPECT_EQ(test.save(), Error::NONE);
+        }
+
+        // The container is full.
+        SlotControlTable extra{container, 999};
+        extra.load();
+        EXPECT_EQ(extra.save(), Error::FAILED);
+    }
+    EXPECT_EQ(fileSize(), static_cast<long>(IMAGE_BYTES));
+
+    uint8_t image[IMAGE_BYTES];
+    ContainerStorage container{fileName, NUM_SLOTS, SLOT_BYTES, image};
+    ASSERT_TRUE(container.open());
+    for (uint8_t id = NUM_SLOTS; id >= 1; id--) {
+        SlotControlTable test{container, id * 100u};
+        test.load();
+        EXPECT_EQ(test.get_u8(Offset::ID), id);
+    }
+
+    remove(fileName);
+}
+
+TEST(ContainerStorageTest, CorruptSlot) {
+    remove(fileName);
+    uint8_t image[IMAGE_BYTES];
+    {
+        ContainerStorage container{fileName, NUM_SLOTS, SLOT_BYTES, image};
+        ASSERT_TRUE(container.open());
+        for (uint8_t id = 1; id <= 2; id++) {
+            SlotControlTable test{container, id};
+            test.load();
+            test.set(Offset::ID, id);
+            EXPECT_EQ(test.save(), Error::NONE);
+        }
+    }
+
+    // Corrupt the first slot, which only affects the first table.
+    FILE* fs = fopen(fileName, "r+b");
+    ASSERT_NE(fs, nullptr);
+    fseek(fs, ContainerStorage::slotsOffset(NUM_SLOTS) + ContainerStorage::SLOT_HEADER_BYTES,
+          SEEK_SET);
+    fputc(0x55, fs);
+    fclose(fs);
+
+    ContainerStorage container{fileName, NUM_SLOTS, SLOT_BYTES, image};
+    ASSERT_TRUE(container.open());
+    SlotControlTable first{container, 1};
+    first.load();
+    EXPECT_EQ(first.get_u8(Offset::ID), SlotControlTable::DEFAULT_DEVICE_ID);
+    SlotControlTable second{container, 2};
+    second.load();
+    EXPECT_EQ(second.get_u8(Offset::ID), 2);
+
+    remove(fileName);
+}
+
+TEST(ContainerStorageTest, WrongLayout) {
+    remove(fileName);
+    uint8_t image[IMAGE_BYTES];
+    {
+        ContainerStorage container{fileName, NUM_SLOTS, SLOT_BYTES, image};
+        ASSERT_TRUE(container.open());
+    }
+
+    // A container with a different number of slots isn't overwritten.
+    ContainerStorage container{fileName, NUM_SLOTS - 1, SLOT_BYTES, image};
+    EXPECT_FALSE(container.open());
+    EXPECT_EQ(fileSize(), static_cast<long>(IMAGE_BYTES));
+
+    remove(fileName);
+}
@@ -0,0 +1,110 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   ControlTableDiffTest.cpp
+ *
+ *   @brief  Tests control table snapshots and diffs.
+ *
+ ****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "ControlTable.h"
+#include "ControlTableDiff.h"
+#include "TestUtil.h"
+#include "Util.h"
+
+//! Convenience aliases
+//! @{
+using ChangedRun = bioloid::ChangedRun;
+using Error = bioloid::Error;
+using Runs = std::vector<ChangedRun>;
+//! @}
+
+//! @brief Control table used to test snapshots.
+class DiffControlTable : public bioloid::IControlTable {
+ public:
+    //! @brief Total number of bytes in the control table.
+    static constexpr uint8_t NUM_CTL_BYTES = 0x40;
+
+    DiffControlTable()
+        : IControlTable(NUM_CTL_BYTES, 0x10, this->m_ctlBytes, this->m_storage, &this->m_port) {
+        this->setToInitialValues();
+    }
+
+ private:
+    uint8_t m_ctlBytes[NUM_CTL_BYTES];
+    NullStorage m_storage;
+    TestPort m_port;
+};
+
+//! @brief Diffs two snapshots.
+//! @returns the changed runs.
+static Runs diff(const uint8_t* prev, const uint8_t* curr, size_t numBytes, size_t maxRuns = 8) {
+    ChangedRun runs[8];
+    size_t numRuns = bioloid::diffSnapshots(prev, curr, numBytes, runs, maxRuns);
+    return Runs(runs, runs + numRuns);
+}
+
+TEST(ControlTableDiffTest, Snapshot) {
+    DiffControlTable test;
+
+    uint8_t small[DiffControlTable::NUM_CTL_BYTES - 1];
+    EXPECT_EQ(bioloid::captureSnapshot(test, small, LEN(small)), Error::RANGE);
+
+    uint8_t prev[DiffControlTable::NUM_CTL_BYTES];
+    uint8_t curr[DiffControlTable::NUM_CTL_BYTES];
+    EXPECT_EQ(bioloid::captureSnapshot(test, prev, LEN(prev)), Error::NONE);
+    EXPECT_EQ(memcmp(prev, test.ctlBytes(), LEN(prev)), 0);
+
+    test.set(DiffControlTable::Offset::LED, uint8_t{1});
+    test.set(0x30, uint32_t{0x12345678});
+    EXPECT_EQ(bioloid::captureSnapshot(test, curr, LEN(curr)), Error::NONE);
+    EXPECT_EQ(diff(prev, curr, LEN(curr)), (Runs{{DiffControlTable::Offset::LED, 1}, {0x30, 4}}));
+}
+
+TEST(ControlTableDiffTest, Runs) {
+    uint8_t prev[100] = {};
+    uint8_t curr[100] = {};
+
+    EXPECT_EQ(diff(prev, curr, LEN(curr)), Runs{});
+
+    // Runs at the start, spanning the 8 and 16 byte boundaries, and at the end.
+    curr[0] = 1;
+    curr[14] = 1;
+    curr[15] = 1;
+    curr[16] = 1;
+    curr[17] = 1;
+    curr[40] = 1;
+    curr[99] = 1;
+    EXPECT_EQ(diff(prev, curr, LEN(curr)), (Runs{{0, 1}, {14, 4}, {40, 1}, {99, 1}}));
+
+    // A run which covers the entire snapshot.
+    memset(curr, 0xff, LEN(curr));
+    EXPECT_EQ(diff(prev, curr, LEN(curr)), (Runs{{0, LEN(curr)}}));
+}
+
+TEST(ControlTableDiffTest, TooManyRuns) {
+    uint8_t prev[64] = {};
+    uint8_t curr[64] = {};
+
+    curr[1] = 1;
+    curr[10] = 1;
+    curr[20] = 1;
+    curr[30] = 1;
+
+    // The last run grows to cover all of the changes which didn't fit.
+    EXPECT_EQ(diff(prev, curr, LEN(curr), 2), (Runs{{1, 1}, {10, 21}}));
+    EXPECT_EQ(diff(prev, curr, LEN(curr), 0), Runs{});
+}
@@ -0,0 +1,147 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   ControlTableObserversTest.cpp
+ *
+ *   @brief  Tests the control table observers.
+ *
+ ****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "ControlTable.h"
+#include "ControlTableObservers.h"
+#include "TestUtil.h"
+#include "Util.h"
+
+//! Convenience aliases
+//! @{
+using ObserverRegistry = bioloid::ObserverRegistry;
+using Offset = bioloid::IControlTable::Offset;
+//! @}
+
+//! @brief Control table with an observer registry.
+class ObservedControlTable : public bioloid::IControlTable {
+ public:
+    //! @brief Total number of bytes in the control table.
+    static constexpr uint8_t NUM_CTL_BYTES = 0x20;
+
+    ObservedControlTable()
+        : IControlTable(NUM_CTL_BYTES, 0x10, this->m_ctlBytes, this->m_storage, &this->m_port),
+          registry{NUM_CTL_BYTES, this->m_masks} {
+        this->setToInitialValues();
+        this->observers(&this->registry);
+    }
+
+    ObserverRegistry registry;  //!< Observers of this control table.
+
+ private:
+    uint8_t m_ctlBytes[NUM_CTL_BYTES];
+    ObserverRegistry::Mask m_masks[NUM_CTL_BYTES];
+    NullStorage m_storage;
+    TestPort m_port;
+};
+
+//! @brief Observer which records the notifications it receives.
+class RecordingObserver : public bioloid::IControlTableObserver {
+ public:
+    //! @brief A notification.
+    struct Change {
+        Offset::Type offset;  //!< Offset of the first modified byte.
+        bioloid::IControlTable::SizeType numBytes;  //!< Number of modified bytes.
+
+        //! @brief Compares two changes.
+        //! @returns true if the changes are the same.
+        bool operator==(const Change& rhs) const {
+            return this->offset == rhs.offset && this->numBytes == rhs.numBytes;
+        }
+    };
+
+    void entriesChanged(
+        const bioloid::IControlTable& ctlTable,
+        Offset::Type offset,
+        bioloid::IControlTable::SizeType numBytes) override {
+        (void)ctlTable;
+        this->changes.push_back({offset, numBytes});
+    }
+
+    std::vector<Change> changes;  //!< Notifications received.
+};
+
+using Changes = std::vector<RecordingObserver::Change>;  //!< Convenience alias
+
+TEST(ControlTableObserversTest, NotifiedOncePerWrite) {
+    ObservedControlTable table;
+    RecordingObserver led;
+    RecordingObserver config;
+    EXPECT_TRUE(table.registry.subscribe(&led, Offset::LED, 1));
+    EXPECT_TRUE(table.registry.subscribe(&config, Offset::ID, 3));
+
+    // A write which covers both subscriptions notifies each observer once, with only
+    // the part that they subscribed to.
+    uint8_t data[0x18] = {};
+    EXPECT_EQ(table.write(Offset::VERSION, data, LEN(data)), bioloid::Error::NONE);
+    EXPECT_EQ(led.changes, (Changes{{Offset::LED, 1}}));
+    EXPECT_EQ(config.changes, (Changes{{Offset::ID, 3}}));
+
+    // A write which only partially overlaps the subscription.
+    config.changes.clear();
+    table.set(Offset::RDT, uint16_t{0x1234});
+    EXPECT_EQ(config.changes, (Changes{{Offset::RDT, 1}}));
+    EXPECT_EQ(led.changes.size(), 1u);
+
+    // A write which doesn't overlap anything.
+    table.set(Offset::LED + 1, uint8_t{1});
+    EXPECT_EQ(config.changes.size(), 1u);
+    EXPECT_EQ(led.changes.size(), 1u);
+}
+
+TEST(ControlTableObserversTest, MultipleRanges) {
+    ObservedControlTable table;
+    RecordingObserver observer;
+    EXPECT_TRUE(table.registry.subscribe(&observer, Offset::ID, 1));
+    EXPECT_TRUE(table.registry.subscribe(&observer, Offset::RDT, 1));
+
+    uint8_t data[3] = {};
+    EXPECT_EQ(table.write(Offset::ID, data, LEN(data)), bioloid::Error::NONE);
+    EXPECT_EQ(observer.changes, (Changes{{Offset::ID, 1}, {Offset::RDT, 1}}));
+}
+
+TEST(ControlTableObserversTest, Unsubscribe) {
+    ObservedControlTable table;
+    RecordingObserver observer;
+    EXPECT_TRUE(table.registry.subscribe(&observer, Offset::LED, 1));
+    table.registry.unsubscribe(&observer);
+
+    table.set(Offset::LED, uint8_t{1});
+    EXPECT_TRUE(observer.changes.empty());
+}
+
+TEST(ControlTableObserversTest, BadSubscriptions) {
+    ObservedControlTable table;
+    RecordingObserver observer;
+
+    EXPECT_FALSE(table.registry.subscribe(nullptr, Offset::LED, 1));
+    EXPECT_FALSE(table.registry.subscribe(&observer, Offset::LED, 0));
+    EXPECT_FALSE(
+        table.registry.subscribe(&observer, ObservedControlTable::NUM_CTL_BYTES - 1, 2));
+
+    for (size_t i = 0; i < ObserverRegistry::MAX_SUBSCRIPTIONS; i++) {
+        EXPECT_TRUE(table.registry.subscribe(&observer, Offset::LED, 1));
+    }
+    EXPECT_FALSE(table.registry.subscribe(&observer, Offset::LED, 1));
+
+    // Freeing up the subscriptions allows new ones to be registered.
+    table.registry.unsubscribe(&observer);
+    EXPECT_TRUE(table.registry.subscribe(&observer, Offset::LED, 1));
+}
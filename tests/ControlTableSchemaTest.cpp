@@ -0,0 +1,243 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   ControlTableSchemaTest.cpp
+ *
+ *   @brief  Tests the control table field schema.
+ *
+ ****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+#include "ControlTable.h"
+#include "ControlTableSchema.h"
+#include "TestUtil.h"
+#include "Util.h"
+
+//! Convenience aliases
+//! @{
+using Error = bioloid::Error;
+using FieldDesc = bioloid::FieldDesc;
+using FieldSchema = bioloid::FieldSchema;
+//! @}
+
+//! @brief Control table which has a schema.
+class SchemaControlTable : public bioloid::IControlTable {
+ public:
+    //! @brief Total number of bytes in the control table.
+    static constexpr uint8_t NUM_CTL_BYTES = 0x20;
+
+    //! @brief Number of bytes which are persisted.
+    static constexpr uint8_t NUM_PERSISTENT_BYTES = 0x10;
+
+    //! @brief Model number reported by the control table.
+    static constexpr uint16_t MODEL = 0x0C1D;
+
+    //! @brief Offsets for fields in the SchemaControlTable
+    struct Offset : public IControlTable::Offset {
+        static constexpr Type CW_LIMIT = 0x06;     //!< a uint16_t persistent field
+        static constexpr Type TRIM = 0x08;         //!< an int8_t persistent field
+        static constexpr Type GOAL = 0x1E;         //!< a uint16_t volatile field
+        static constexpr Type TEMPERATURE = 0x1C;  //!< a read-only field
+    };
+
+    //! @brief Flags for a signed persistent field.
+    static constexpr FieldDesc::Flags::Type SIGNED_PERSIST =
+        FieldDesc::RW_PERSIST | FieldDesc::Flags::SIGNED;
+
+    //! @brief Describes the fields in the control table.
+    static constexpr FieldDesc FIELDS[] = {
+        // clang-format off
+        // offset             size flags                   min  max   error               default
+        {Offset::MODEL,       2,   FieldDesc::RO_PERSIST,  0,   -1,   Error::RANGE,       MODEL},
+        {Offset::VERSION,     1,   FieldDesc::RO_PERSIST},
+        {Offset::ID,          1,   FieldDesc::RW_PERSIST,  0,   0xFD, Error::RANGE,       1},
+        {Offset::BAUD,        1,   FieldDesc::RW_PERSIST,  0,   -1,   Error::RANGE,       34},
+        {Offset::RDT,         1,   FieldDesc::RW_PERSIST,  0,   -1,   Error::RANGE,       250},
+        {Offset::CW_LIMIT,    2,   FieldDesc::RW_PERSIST,  0,   1023, Error::RANGE,       1023},
+        {Offset::TRIM,        1,   SIGNED_PERSIST,         -10, 10,   Error::RANGE,       -2},
+        {Offset::LED,         1,   FieldDesc::WRITABLE,    0,   1},
+        {Offset::TEMPERATURE, 1,   FieldDesc::READ_ONLY},
+        {Offset::GOAL,        2,   FieldDesc::WRITABLE,    0,   1023, Error::ANGLE_LIMIT, 512},
+        // clang-format on
+    };
+
+    //! @brief Lookup tables derived from FIELDS.
+    static constexpr bioloid::FieldTable<NUM_CTL_BYTES, LEN(FIELDS)> FIELD_TABLE{FIELDS};
+
+    //! @brief Schema used by the control table.
+    static constexpr FieldSchema SCHEMA{FIELD_TABLE};
+
+    explicit SchemaControlTable(uint8_t numPersistentBytes = NUM_PERSISTENT_BYTES)
+        : IControlTable(
+              NUM_CTL_BYTES,
+              numPersistentBytes,
+              this->m_ctlBytes,
+              this->m_storage,
+              &this->m_port,
+              &SCHEMA) {
+        this->setToInitialValues();
+    }
+
+    int numModifiedCalls = 0;  //!< Number of times entryModified() was called.
+
+ protected:
+    void entryModified(Offset::Type offset, SizeType numBytes) override {
+        this->numModifiedCalls++;
+        this->IControlTable::entryModified(offset, numBytes);
+    }
+
+ private:
+    uint8_t m_ctlBytes[NUM_CTL_BYTES];
+    NullStorage m_storage;
+    TestPort m_port;
+};
+
+using Offset = SchemaControlTable::Offset;  //!< Convenience alias
+
+TEST(ControlTableSchemaTest, FieldTable) {
+    static constexpr const FieldSchema& schema = SchemaControlTable::SCHEMA;
+
+    static_assert(schema.numCtlBytes() == SchemaControlTable::NUM_CTL_BYTES);
+    static_assert(schema.numFields() == LEN(SchemaControlTable::FIELDS));
+    static_assert(schema.byteFlags(Offset::MODEL + 1) == (bioloid::ByteFlags::IN_FIELD |
+                                                          bioloid::ByteFlags::PERSISTENT));
+    static_assert(schema.byteFlags(Offset::LED) == (bioloid::ByteFlags::IN_FIELD |
+                                                    bioloid::ByteFlags::WRITABLE |
+                                                    bioloid::ByteFlags::LIMITED));
+    EXPECT_EQ(schema.byteFlags(Offset::LED + 1), 0);
+    EXPECT_EQ(schema.field(2).offset, Offset::ID);
+}
+
+TEST(ControlTableSchemaTest, ValidWrite) {
+    SchemaControlTable test;
+
+    uint8_t data[] = {0x01, 0x02, 0x03};
+    EXPECT_EQ(test.validateWrite(Offset::ID, LEN(data), data), Error::NONE);
+
+    uint8_t limit[] = {0xff, 0x03, 0xf6};  // CW_LIMIT = 1023, TRIM = -10
+    EXPECT_EQ(test.validateWrite(Offset::CW_LIMIT, LEN(limit), limit), Error::NONE);
+}
+
+TEST(ControlTableSchemaTest, BadRange) {
+    SchemaControlTable test;
+
+    uint8_t data[4] = {};
+
+    // Past the end of the table.
+    EXPECT_EQ(test.validateWrite(Offset::GOAL, LEN(data), data), Error::RANGE);
+
+    // Read-only field.
+    EXPECT_EQ(test.validateWrite(Offset::MODEL, 1, data), Error::RANGE);
+    EXPECT_EQ(test.validateWrite(Offset::TEMPERATURE, 1, data), Error::RANGE);
+
+    // Unused byte.
+    EXPECT_EQ(test.validateWrite(Offset::LED + 1, 1, data), Error::RANGE);
+
+    // A writable field followed by an unused byte.
+    EXPECT_EQ(test.validateWrite(Offset::LED, 2, data), Error::RANGE);
+}
+
+TEST(ControlTableSchemaTest, Limits) {
+    SchemaControlTable test;
+
+    uint8_t id = 0xFE;
+    EXPECT_EQ(test.validateWrite(Offset::ID, 1, &id), Error::RANGE);
+
+    uint8_t trim = 11;
+    EXPECT_EQ(test.validateWrite(Offset::TRIM, 1, &trim), Error::RANGE);
+    trim = static_cast<uint8_t>(-11);
+    EXPECT_EQ(test.validateWrite(Offset::TRIM, 1, &trim), Error::RANGE);
+    trim = static_cast<uint8_t>(-1);
+    EXPECT_EQ(test.validateWrite(Offset::TRIM, 1, &trim), Error::NONE);
+
+    uint8_t goal[] = {0x00, 0x04};
+    EXPECT_EQ(test.validateWrite(Offset::GOAL, LEN(goal), goal), Error::ANGLE_LIMIT);
+
+    // A single write can report multiple errors, but each field is only checked once.
+    uint8_t data[] = {0x00, 0x04, 0x00, 0x04};
+    Error::Type expected = Error::ANGLE_LIMIT | Error::RANGE;
+    EXPECT_EQ(test.validateWrite(Offset::GOAL - 2, LEN(data), data), expected);
+}
+
+TEST(ControlTableSchemaTest, PartialField) {
+    SchemaControlTable test;
+
+    // Writing only the MSB of a field uses the current LSB to check limits.
+    test.set(Offset::GOAL, uint16_t{0x00ff});
+    uint8_t msb = 0x03;
+    EXPECT_EQ(test.validateWrite(Offset::GOAL + 1, 1, &msb), Error::NONE);
+    msb = 0x04;
+    EXPECT_EQ(test.validateWrite(Offset::GOAL + 1, 1, &msb), Error::ANGLE_LIMIT);
+
+    // Validating doesn't modify the control table.
+    EXPECT_EQ(test.get_u16(Offset::GOAL), 0x00ff);
+}
+
+TEST(ControlTableSchemaTest, DefaultImage) {
+    static constexpr const uint8_t* defaults = SchemaControlTable::SCHEMA.defaults();
+
+    static_assert(defaults[Offset::MODEL] == 0x1D);
+    static_assert(defaults[Offset::MODEL + 1] == 0x0C);
+    static_assert(defaults[Offset::CW_LIMIT] == 0xFF);
+    static_assert(defaults[Offset::CW_LIMIT + 1] == 0x03);
+    static_assert(defaults[Offset::TRIM] == 0xFE);
+    static_assert(defaults[Offset::LED + 1] == 0);
+}
+
+TEST(ControlTableSchemaTest, InitialValues) {
+    SchemaControlTable test;
+
+    test.set(Offset::GOAL, uint16_t{100});
+    test.set(Offset::TRIM, int8_t{5});
+    test.numModifiedCalls = 0;
+
+    test.setToInitialValues();
+    EXPECT_EQ(test.numModifiedCalls, 1);
+    EXPECT_EQ(test.get_u16(Offset::MODEL), SchemaControlTable::MODEL);
+    EXPECT_EQ(test.get_u8(Offset::ID), 1);
+    EXPECT_EQ(test.get_u8(Offset::BAUD), 34);
+    EXPECT_EQ(test.get_u8(Offset::RDT), 250);
+    EXPECT_EQ(test.get_u16(Offset::CW_LIMIT), 1023);
+    EXPECT_EQ(test.get_i8(Offset::TRIM), -2);
+    EXPECT_EQ(test.get_u16(Offset::GOAL), 512);
+    EXPECT_TRUE(test.isDirty());
+}
+
+TEST(ControlTableSchemaTest, NoSchema) {
+    // Without a schema, only the bounds are checked.
+    static constexpr uint8_t NUM_CTL_BYTES = 8;
+    uint8_t ctlBytes[NUM_CTL_BYTES];
+    NullStorage storage;
+    TestPort port;
+    bioloid::IControlTable test(NUM_CTL_BYTES, 0, ctlBytes, storage, &port);
+
+    uint8_t data[2] = {};
+    EXPECT_EQ(test.validateWrite(0, LEN(data), data), Error::NONE);
+    EXPECT_EQ(test.validateWrite(NUM_CTL_BYTES - 1, LEN(data), data), Error::RANGE);
+}
+
+TEST(ControlTableSchemaDeathTest, PersistentPastPrefix) {
+    // TRIM is persistent, but lies past the first 8 bytes.
+    EXPECT_DEATH(
+        SchemaControlTable(0x08),
+        "Assertion `this->m_schema == nullptr \\|\\| "
+        "this->m_schema->persistsPrefix\\(this->m_numPersistentBytes\\)' failed.");
+}
+
+TEST(ControlTableSchemaDeathTest, VolatileInPrefix) {
+    // LED isn't persistent, but lies within the first 0x1A bytes.
+    EXPECT_DEATH(
+        SchemaControlTable(0x1A),
+        "Assertion `this->m_schema == nullptr \\|\\| "
+        "this->m_schema->persistsPrefix\\(this->m_numPersistentBytes\\)' failed.");
+}
@@ -21,17 +21,9 @@
 
 #include "ControlTable.h"
 #include "FileStorage.h"
+#include "TestUtil.h"
 #include "Util.h"
 
-//! @brief Test port for testing the control table.
-class TestPort : public bioloid::IPort {
-    uint8_t available() override { return 0; }
-
-    uint8_t readByte() { return 0xff; }
-
-    void writePacket(bioloid::Packet const& pkt) { (void)pkt; }
-};
-
 //! @brief Test control table class.
 class TestControlTable : public bioloid::IControlTable {
  public:
@@ -89,11 +81,23 @@ class TestControlTable : public bioloid::IControlTable {
     char const* fileName() { return this->m_storage.fileName(); }
 
  protected:
-    void populateEntry(Offset::Type offset) const override {
-        this->IControlTable::populateEntry(offset);
+    void populateEntry(Offset::Type offset, SizeType numBytes) const override {
+        this->numPopulateCalls++;
+        this->IControlTable::populateEntry(offset, numBytes);
     }
 
-    void entryModified(Offset::Type offset) override { this->IControlTable::entryModified(offset); }
+    void entryModified(Offset::Type offset, SizeType numBytes) override {
+        this->numModifiedCalls++;
+        this->lastModifiedOffset = offset;
+        this->lastModifiedBytes = numBytes;
+        this->IControlTable::entryModified(offset, numBytes);
+    }
+
+ public:
+    mutable uint32_t numPopulateCalls = 0;  //!< Number of times populateEntry was called.
+    uint32_t numModifiedCalls = 0;          //!< Number of times entryModified was called.
+    Offset::Type lastModifiedOffset = 0;    //!< Offset passed to the last entryModified.
+    uint8_t lastModifiedBytes = 0;          //!< numBytes passed to the last entryModified.
 
  private:
     uint8_t m_ctlBytes[NUM_CTL_BYTES];
@@ -103,6 +107,65 @@ class TestControlTable : public bioloid::IControlTable {
 
 using Offset = TestControlTable::Offset;  //!< Convenience alias
 
+//! @brief Storage which records the spans that are saved.
+class SpanStorage : public bioloid::IControlTableStorage {
+ public:
+    //! @brief A span of bytes passed to save().
+    struct Span {
+        OffsetType offset;  //!< Offset of the first byte saved.
+        SizeType numBytes;  //!< Number of bytes saved.
+
+        //! @brief Compares two spans.
+        //! @returns true if the spans are the same.
+        bool operator==(const Span& rhs) const {
+            return this->offset == rhs.offset && this->numBytes == rhs.numBytes;
+        }
+    };
+
+    Error load(OffsetType offset, SizeType numBytes, void* data) override {
+        memset(data, 0, numBytes);
+        (void)offset;
+        return Error::NONE;
+    }
+
+    Error save(OffsetType offset, SizeType numBytes, const void* data) override {
+        (void)data;
+        this->spans.push_back({offset, numBytes});
+        return this->fail ? Error::FAILED : Error::NONE;
+    }
+
+    Error commit() override {
+        this->numCommits++;
+        return Error::NONE;
+    }
+
+    std::vector<Span> spans;  //!< Spans which have been saved.
+    bool fail = false;        //!< Set to true to make save() fail.
+    uint32_t numCommits = 0;  //!< Number of times commit() was called.
+};
+
+//! @brief Control table which uses SpanStorage.
+class SpanControlTable : public bioloid::IControlTable {
+ public:
+    SpanControlTable()
+        : IControlTable(
+              TestControlTable::NUM_CTL_BYTES,
+              TestControlTable::NUM_PERSISTENT_BYTES,
+              this->m_ctlBytes,
+              this->storage,
+              &this->m_port) {
+        this->load();
+    }
+
+    SpanStorage storage;  //!< Storage which records the spans saved.
+
+ private:
+    uint8_t m_ctlBytes[TestControlTable::NUM_CTL_BYTES];
+    TestPort m_port;
+};
+
+using Span = SpanStorage::Span;  //!< Convenience alias
+
 TEST(ControlTableTest, InitialValue) {
     TestControlTable test;
 
@@ -167,6 +230,178 @@ TEST(ControlTableTest, TestSave) {
     EXPECT_EQ(test.get_u32(Offset::FIELD1), 0x01020304);
 }
 
+TEST(ControlTableTest, ReadRange) {
+    TestControlTable test;
+    test.setToInitialValues();
+
+    uint8_t buf[7];
+    test.numPopulateCalls = 0;
+    EXPECT_EQ(test.read(Offset::FIELD1, LEN(buf), buf), bioloid::Error::NONE);
+    EXPECT_EQ(test.numPopulateCalls, 1u);
+    EXPECT_EQ(memcmp(buf, &test.ctlBytes()[Offset::FIELD1], LEN(buf)), 0);
+    EXPECT_EQ(buf[0], 0x44);
+    EXPECT_EQ(buf[4], 0x66);
+    EXPECT_EQ(buf[6], TestControlTable::FIELD3_DEFAULT);
+
+    // Reading past the end of the table fails without calling populateEntry.
+    EXPECT_EQ(test.read(TestControlTable::NUM_CTL_BYTES - 1, 2, buf), bioloid::Error::RANGE);
+    EXPECT_EQ(test.numPopulateCalls, 1u);
+}
+
+TEST(ControlTableTest, WriteRange) {
+    TestControlTable test;
+    test.setToInitialValues();
+
+    uint8_t data[] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06};
+    test.numModifiedCalls = 0;
+    EXPECT_EQ(test.write(Offset::FIELD1, data, LEN(data)), bioloid::Error::NONE);
+    EXPECT_EQ(test.numModifiedCalls, 1u);
+    EXPECT_EQ(test.lastModifiedOffset, Offset::FIELD1);
+    EXPECT_EQ(test.lastModifiedBytes, LEN(data));
+    EXPECT_EQ(test.get_u32(Offset::FIELD1), 0x04030201u);
+    EXPECT_EQ(test.get_u16(Offset::FIELD2), 0x0605u);
+
+    // Writing past the end of the table fails without modifying anything.
+    EXPECT_EQ(
+        test.write(TestControlTable::NUM_CTL_BYTES - 1, data, 2), bioloid::Error::RANGE);
+    EXPECT_EQ(test.numModifiedCalls, 1u);
+    EXPECT_EQ(test.ctlBytes()[TestControlTable::NUM_CTL_BYTES - 1], 0);
+}
+
+TEST(ControlTableTest, SetCallsModifiedOnce) {
+    TestControlTable test;
+    test.setToInitialValues();
+
+    test.numModifiedCalls = 0;
+    test.set(Offset::FIELD1, uint32_t{0x12345678});
+    EXPECT_EQ(test.numModifiedCalls, 1u);
+    EXPECT_EQ(test.lastModifiedOffset, Offset::FIELD1);
+    EXPECT_EQ(test.lastModifiedBytes, sizeof(uint32_t));
+}
+
+TEST(ControlTableTest, SaveOnlyDirtySpans) {
+    SpanControlTable test;
+
+    // Nothing has been modified since loading.
+    EXPECT_FALSE(test.isDirty());
+    EXPECT_EQ(test.save(), bioloid::IControlTableStorage::Error::NONE);
+    EXPECT_TRUE(test.storage.spans.empty());
+
+    // Volatile fields are never saved.
+    test.set(Offset::FIELD4, uint8_t{1});
+    EXPECT_FALSE(test.isDirty());
+
+    test.set(Offset::FIELD1, uint32_t{1});
+    test.set(Offset::FIELD3, uint8_t{3});
+    EXPECT_TRUE(test.isDirty());
+    EXPECT_EQ(test.save(), bioloid::IControlTableStorage::Error::NONE);
+    EXPECT_EQ(test.storage.spans, (std::vector<Span>{{Offset::FIELD1, 4}, {Offset::FIELD3, 1}}));
+    EXPECT_FALSE(test.isDirty());
+
+    // Adjacent fields are saved as a single span.
+    test.storage.spans.clear();
+    test.set(Offset::FIELD2, uint16_t{2});
+    test.set(Offset::FIELD1, uint32_t{1});
+    EXPECT_EQ(test.save(), bioloid::IControlTableStorage::Error::NONE);
+    EXPECT_EQ(test.storage.spans, (std::vector<Span>{{Offset::FIELD1, 6}}));
+
+    // A range write which straddles the end of the persistent bytes.
+    test.storage.spans.clear();
+    uint8_t data[4] = {};
+    EXPECT_EQ(test.write(TestControlTable::NUM_PERSISTENT_BYTES - 2, data, LEN(data)),
+              bioloid::Error::NONE);
+    EXPECT_EQ(test.save(), bioloid::IControlTableStorage::Error::NONE);
+    EXPECT_EQ(test.storage.spans,
+              (std::vector<Span>{{TestControlTable::NUM_PERSISTENT_BYTES - 2, 2}}));
+}
+
+TEST(ControlTableTest, SaveFailureKeepsDirty) {
+    SpanControlTable test;
+
+    EXPECT_EQ(test.save(), bioloid::IControlTableStorage::Error::NONE);
+    test.set(Offset::FIELD1, uint32_t{1});
+    test.set(Offset::FIELD3, uint8_t{3});
+    test.storage.fail = true;
+    test.storage.spans.clear();
+    test.storage.numCommits = 0;
+    EXPECT_EQ(test.save(), bioloid::IControlTableStorage::Error::FAILED);
+    EXPECT_TRUE(test.isDirty());
+
+    // Saving stops at the first failed span, without committing the partial save.
+    EXPECT_EQ(test.storage.spans, (std::vector<Span>{{Offset::FIELD1, 4}}));
+    EXPECT_EQ(test.storage.numCommits, 0u);
+
+    // Every span is retried by the next save.
+    test.storage.fail = false;
+    test.storage.spans.clear();
+    EXPECT_EQ(test.save(), bioloid::IControlTableStorage::Error::NONE);
+    EXPECT_EQ(test.storage.spans, (std::vector<Span>{{Offset::FIELD1, 4}, {Offset::FIELD3, 1}}));
+    EXPECT_EQ(test.storage.numCommits, 1u);
+    EXPECT_FALSE(test.isDirty());
+}
+
+TEST(ControlTableTest, InitialValuesAreDirty) {
+    SpanControlTable test;
+
+    // Setting the initial values needs to save the entire persistent portion.
+    test.setToInitialValues();
+    EXPECT_EQ(test.save(), bioloid::IControlTableStorage::Error::NONE);
+    EXPECT_EQ(
+        test.storage.spans, (std::vector<Span>{{0, TestControlTable::NUM_PERSISTENT_BYTES}}));
+}
+
+TEST(ControlTableTest, AddressWidth) {
+    EXPECT_EQ(sizeof(Offset::Type) * 8, BIOLOID_CTL_ADDR_BITS);
+    EXPECT_EQ(sizeof(bioloid::IControlTable::SizeType), sizeof(Offset::Type));
+}
+
+#if BIOLOID_CTL_ADDR_BITS == 16
+
+//! @brief Control table which is too large to be addressed using 8-bit offsets.
+class LargeControlTable : public bioloid::IControlTable {
+ public:
+    static constexpr SizeType NUM_CTL_BYTES = 0x300;         //!< Number of control bytes.
+    static constexpr SizeType NUM_PERSISTENT_BYTES = 0x120;  //!< Number of persistent bytes.
+
+    LargeControlTable()
+        : IControlTable(
+              NUM_CTL_BYTES, NUM_PERSISTENT_BYTES, this->m_ctlBytes, this->storage, &this->m_port) {
+        this->load();
+    }
+
+    SpanStorage storage;  //!< Storage which records the spans saved.
+
+ private:
+    uint8_t m_ctlBytes[NUM_CTL_BYTES];
+    TestPort m_port;
+};
+
+TEST(ControlTableTest, LargeTable) {
+    LargeControlTable test;
+
+    uint8_t data[0x110];
+    for (size_t i = 0; i < LEN(data); i++) {
+        data[i] = static_cast<uint8_t>(i);
+    }
+    EXPECT_EQ(test.write(0x1F0, data, LEN(data)), bioloid::Error::NONE);
+    EXPECT_EQ(test.get_u16(0x2FE), 0x0F0E);
+
+    uint8_t buf[LEN(data)];
+    EXPECT_EQ(test.read(0x1F0, LEN(buf), buf), bioloid::Error::NONE);
+    EXPECT_EQ(memcmp(buf, data, LEN(buf)), 0);
+    EXPECT_EQ(test.read(0x2F0, 0x11, buf), bioloid::Error::RANGE);
+
+    // Bytes beyond the persistent portion aren't saved.
+    EXPECT_FALSE(test.isDirty());
+
+    // Persistent bytes beyond offset 0xFF are tracked the same as the rest.
+    test.set<uint16_t>(0x110, 0x1234);
+    EXPECT_EQ(test.save(), bioloid::IControlTableStorage::Error::NONE);
+    EXPECT_EQ(test.storage.spans, (std::vector<Span>{{0x110, 2}}));
+}
+
+#endif  // BIOLOID_CTL_ADDR_BITS == 16
+
 TEST(ControlTableDeathTest, NullFileName) {
     EXPECT_DEATH(TestControlTable(nullptr), "Assertion `this->m_ctlBytes != nullptr' failed.");
 }
@@ -0,0 +1,31 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   Crc32Test.cpp
+ *
+ *   @brief  Tests the CRC-32 calculation.
+ *
+ ****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+#include "Crc32.h"
+
+TEST(Crc32Test, CheckValue) {
+    static const char data[] = "123456789";
+
+    EXPECT_EQ(bioloid::crc32(data, 0), 0u);
+    EXPECT_EQ(bioloid::crc32(data, 9), 0xCBF43926u);
+
+    // Calculating the CRC in pieces gives the same result.
+    EXPECT_EQ(bioloid::crc32(&data[4], 5, bioloid::crc32(data, 4)), 0xCBF43926u);
+}
@@ -0,0 +1,178 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   DeviceTest.cpp
+ *
+ *   @brief  Tests the instruction packet dispatcher.
+ *
+ ****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+#include "ControlTable.h"
+#include "Device.h"
+#include "Packet.h"
+#include "TestUtil.h"
+#include "Util.h"
+
+//! Convenience aliases
+//! @{
+using Command = bioloid::Command;
+using Error = bioloid::Error;
+using ID = bioloid::ID;
+using Packet = bioloid::Packet;
+//! @}
+
+//! @brief Device with a small control table used for testing.
+class TestDevice : public bioloid::IControlTable {
+ public:
+    //! @brief Total number of bytes in the control table.
+    static constexpr uint8_t NUM_CTL_BYTES = 0x20;
+
+    //! @brief ID assigned to the device.
+    static constexpr ID::Type DEVICE_ID = 0x05;
+
+    TestDevice()
+        : IControlTable(NUM_CTL_BYTES, 0x10, this->m_ctlBytes, this->m_storage, &this->m_port),
+          m_device{*this} {
+        this->setToInitialValues();
+        this->set(Offset::ID, DEVICE_ID);
+    }
+
+    //! @brief Sends an instruction packet to the device.
+    //! @returns true if the device replied.
+    bool send(
+        ID::Type id,                      //!< [in] ID to send the instruction to.
+        Command::Type cmd,                //!< [in] Instruction to send.
+        std::initializer_list<uint8_t> p  //!< [in] Parameters for the instruction.
+    ) {
+        this->m_cmd.id(id);
+        this->m_cmd.command(cmd);
+        this->m_cmd.params(p);
+        return this->m_device.processPacket(this->m_cmd, &this->rsp);
+    }
+
+    //! @brief Sends an instruction packet which starts with offsets and lengths.
+    //! @details Each address is encoded using the same width as Offset::Type, so the
+    //!          tests work regardless of BIOLOID_CTL_ADDR_BITS.
+    //! @returns true if the device replied.
+    bool send(
+        ID::Type id,                            //!< [in] ID to send the instruction to.
+        Command::Type cmd,                      //!< [in] Instruction to send.
+        std::initializer_list<uint16_t> addrs,  //!< [in] Offsets and lengths to encode.
+        std::initializer_list<uint8_t> data     //!< [in] Remaining parameters.
+    ) {
+        uint8_t p[LEN(m_cmdParams)];
+        size_t numParams = 0;
+        for (uint16_t addr : addrs) {
+            for (size_t i = 0; i < sizeof(Offset::Type); i++) {
+                p[numParams++] = static_cast<uint8_t>(addr >> (8 * i));
+            }
+        }
+        for (uint8_t byte : data) {
+            p[numParams++] = byte;
+        }
+        this->m_cmd.id(id);
+        this->m_cmd.command(cmd);
+        this->m_cmd.params(numParams, p);
+        return this->m_device.processPacket(this->m_cmd, &this->rsp);
+    }
+
+    Packet rsp{LEN(m_rspParams), m_rspParams};  //!< Status packet from the last instruction.
+
+ private:
+    uint8_t m_ctlBytes[NUM_CTL_BYTES];
+    NullStorage m_storage;
+    TestPort m_port;
+    bioloid::Device m_device;
+    uint8_t m_cmdParams[16];
+    uint8_t m_rspParams[16];
+    Packet m_cmd{LEN(m_cmdParams), m_cmdParams};
+};
+
+TEST(DeviceTest, Ping) {
+    TestDevice test;
+
+    EXPECT_TRUE(test.send(TestDevice::DEVICE_ID, Command::PING, {}));
+    EXPECT_EQ(test.rsp.id(), TestDevice::DEVICE_ID);
+    EXPECT_EQ(test.rsp.errorCode(), Error::NONE);
+    EXPECT_EQ(test.rsp.numParams(), 0);
+
+    // Packets for other devices are ignored.
+    EXPECT_FALSE(test.send(TestDevice::DEVICE_ID + 1, Command::PING, {}));
+}
+
+TEST(DeviceTest, Read) {
+    TestDevice test;
+
+    EXPECT_TRUE(test.send(TestDevice::DEVICE_ID, Command::READ, {0x03, 0x03}, {}));
+    EXPECT_EQ(test.rsp.errorCode(), Error::NONE);
+    ASSERT_EQ(test.rsp.numParams(), 3);
+    EXPECT_EQ(test.rsp.params()[0], TestDevice::DEVICE_ID);
+    EXPECT_EQ(test.rsp.params()[1], TestDevice::DEFAULT_BAUD);
+    EXPECT_EQ(test.rsp.params()[2], TestDevice::DEFAULT_RDT);
+
+    // Reading past the end of the control table.
+    EXPECT_TRUE(test.send(TestDevice::DEVICE_ID, Command::READ, {0x1f, 0x02}, {}));
+    EXPECT_EQ(test.rsp.errorCode(), Error::RANGE);
+    EXPECT_EQ(test.rsp.numParams(), 0);
+
+    // Reading more than fits in the status packet.
+    EXPECT_TRUE(test.send(TestDevice::DEVICE_ID, Command::READ, {0x00, 0x20}, {}));
+    EXPECT_EQ(test.rsp.errorCode(), Error::RANGE);
+
+    // Missing the length.
+    EXPECT_TRUE(test.send(TestDevice::DEVICE_ID, Command::READ, {0x00}, {}));
+    EXPECT_EQ(test.rsp.errorCode(), Error::INSTRUCTION);
+}
+
+TEST(DeviceTest, Write) {
+    TestDevice test;
+
+    EXPECT_TRUE(test.send(TestDevice::DEVICE_ID, Command::WRITE, {0x10}, {0x34, 0x12}));
+    EXPECT_EQ(test.rsp.errorCode(), Error::NONE);
+    EXPECT_EQ(test.get_u16(0x10), 0x1234);
+
+    // Writing past the end of the control table.
+    EXPECT_TRUE(test.send(TestDevice::DEVICE_ID, Command::WRITE, {0x1f}, {0x01, 0x02}));
+    EXPECT_EQ(test.rsp.errorCode(), Error::RANGE);
+    EXPECT_EQ(test.get_u8(0x1f), 0x00);
+
+    // Broadcast writes are processed, but not replied to.
+    EXPECT_FALSE(test.send(ID::BROADCAST, Command::WRITE, {0x10}, {0x78}));
+    EXPECT_EQ(test.get_u8(0x10), 0x78);
+
+    // Missing the data.
+    EXPECT_TRUE(test.send(TestDevice::DEVICE_ID, Command::WRITE, {0x10}, {}));
+    EXPECT_EQ(test.rsp.errorCode(), Error::INSTRUCTION);
+}
+
+TEST(DeviceTest, Reset) {
+    TestDevice test;
+
+    EXPECT_TRUE(test.send(TestDevice::DEVICE_ID, Command::WRITE, {0x05}, {0x10}));
+    EXPECT_EQ(test.get_u8(TestDevice::Offset::RDT), 0x10);
+
+    // The status packet uses the ID the instruction was sent to.
+    EXPECT_TRUE(test.send(TestDevice::DEVICE_ID, Command::RESET, {}));
+    EXPECT_EQ(test.rsp.id(), TestDevice::DEVICE_ID);
+    EXPECT_EQ(test.rsp.errorCode(), Error::NONE);
+    EXPECT_EQ(test.get_u8(TestDevice::Offset::RDT), TestDevice::DEFAULT_RDT);
+    EXPECT_EQ(test.get_u8(TestDevice::Offset::ID), TestDevice::DEFAULT_DEVICE_ID);
+}
+
+TEST(DeviceTest, BadInstruction) {
+    TestDevice test;
+
+    EXPECT_TRUE(test.send(TestDevice::DEVICE_ID, 0x55, {}));
+    EXPECT_EQ(test.rsp.errorCode(), Error::INSTRUCTION);
+}
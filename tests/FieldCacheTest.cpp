@@ -0,0 +1,151 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   FieldCacheTest.cpp
+ *
+ *   @brief  Tests the sampled field cache.
+ *
+ ****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+#include "ControlTable.h"
+#include "FieldCache.h"
+#include "TestUtil.h"
+#include "Util.h"
+
+//! Convenience aliases
+//! @{
+using RefreshPolicy = bioloid::RefreshPolicy;
+using SampledField = bioloid::SampledField;
+//! @}
+
+//! @brief Control table with fields which are sampled from "hardware".
+class SensorControlTable : public bioloid::IControlTable {
+ public:
+    //! @brief Total number of bytes in the control table.
+    static constexpr uint8_t NUM_CTL_BYTES = 0x30;
+
+    //! @brief Lifetime of the voltage and temperature samples.
+    static constexpr uint32_t TTL_USEC = 1000;
+
+    //! @brief Offsets for fields in the SensorControlTable
+    struct Offset : public IControlTable::Offset {
+        static constexpr Type SERIAL = 0x1C;       //!< Serial number (on demand)
+        static constexpr Type LOAD = 0x28;         //!< Present load (always)
+        static constexpr Type VOLTAGE = 0x2A;      //!< Present voltage (TTL)
+        static constexpr Type TEMPERATURE = 0x2B;  //!< Present temperature (TTL)
+    };
+
+    //! @brief Fields which are sampled.
+    static constexpr SampledField SAMPLED_FIELDS[] = {
+        // clang-format off
+        {Offset::SERIAL,        4,  RefreshPolicy::ON_DEMAND},
+        {Offset::LOAD,          2,  RefreshPolicy::ALWAYS},
+        {Offset::VOLTAGE,       1,  RefreshPolicy::TTL,         TTL_USEC},
+        {Offset::TEMPERATURE,   1,  RefreshPolicy::TTL,         TTL_USEC},
+        // clang-format on
+    };
+
+    SensorControlTable()
+        : IControlTable(NUM_CTL_BYTES, 0x10, this->m_ctlBytes, this->m_storage, &this->m_port),
+          cache{SAMPLED_FIELDS, LEN(SAMPLED_FIELDS)} {
+        this->setToInitialValues();
+    }
+
+    mutable bioloid::FieldCache cache;  //!< Cache of the sampled fields.
+    uint32_t nowUsec = 0;               //!< Simulated time.
+
+    //! Number of times each field was sampled.
+    mutable uint32_t numSamples[LEN(SAMPLED_FIELDS)] = {};
+
+ protected:
+    void populateEntry(Offset::Type offset, SizeType numBytes) const override {
+        this->cache.refresh(offset, numBytes, this->nowUsec, [this](size_t idx) {
+            const SampledField& field = SAMPLED_FIELDS[idx];
+            this->numSamples[idx]++;
+            uint8_t* ctlBytes = this->IControlTable::m_ctlBytes;
+            ctlBytes[field.offset] = static_cast<uint8_t>(this->numSamples[idx]);
+            this->sampled(field.offset, field.numBytes);
+        });
+    }
+
+ private:
+    uint8_t m_ctlBytes[NUM_CTL_BYTES];
+    NullStorage m_storage;
+    TestPort m_port;
+};
+
+using Offset = SensorControlTable::Offset;  //!< Convenience alias
+
+TEST(FieldCacheTest, Ttl) {
+    SensorControlTable test;
+
+    EXPECT_EQ(test.get_u8(Offset::TEMPERATURE), 1);
+    test.nowUsec += SensorControlTable::TTL_USEC - 1;
+    EXPECT_EQ(test.get_u8(Offset::TEMPERATURE), 1);
+    test.nowUsec += 1;
+    EXPECT_EQ(test.get_u8(Offset::TEMPERATURE), 2);
+    EXPECT_EQ(test.numSamples[3], 2u);
+
+    // Fields outside of the range retrieved aren't sampled.
+    EXPECT_EQ(test.numSamples[2], 0u);
+}
+
+TEST(FieldCacheTest, TtlWraps) {
+    SensorControlTable test;
+
+    test.nowUsec = 0xFFFFFFFF - 10;
+    EXPECT_EQ(test.get_u8(Offset::VOLTAGE), 1);
+    test.nowUsec += 20;
+    EXPECT_EQ(test.get_u8(Offset::VOLTAGE), 1);
+    test.nowUsec += SensorControlTable::TTL_USEC;
+    EXPECT_EQ(test.get_u8(Offset::VOLTAGE), 2);
+}
+
+TEST(FieldCacheTest, Always) {
+    SensorControlTable test;
+
+    EXPECT_EQ(test.get_u16(Offset::LOAD), 1);
+    EXPECT_EQ(test.get_u16(Offset::LOAD), 2);
+    EXPECT_EQ(test.get_u16(Offset::LOAD), 3);
+}
+
+TEST(FieldCacheTest, OnDemand) {
+    SensorControlTable test;
+
+    EXPECT_EQ(test.get_u8(Offset::SERIAL), 1);
+    test.nowUsec += 1'000'000;
+    EXPECT_EQ(test.get_u8(Offset::SERIAL), 1);
+
+    test.cache.invalidate(0);
+    EXPECT_EQ(test.get_u8(Offset::SERIAL), 2);
+    EXPECT_EQ(test.get_u8(Offset::SERIAL), 2);
+
+    test.cache.invalidateAll();
+    EXPECT_EQ(test.get_u8(Offset::SERIAL), 3);
+}
+
+TEST(FieldCacheTest, RangeReadSamplesOnce) {
+    SensorControlTable test;
+
+    // A single READ covering several fields samples each of them exactly once.
+    uint8_t buf[4];
+    EXPECT_EQ(test.read(Offset::LOAD, LEN(buf), buf), bioloid::Error::NONE);
+    EXPECT_EQ(test.numSamples[0], 0u);
+    EXPECT_EQ(test.numSamples[1], 1u);
+    EXPECT_EQ(test.numSamples[2], 1u);
+    EXPECT_EQ(test.numSamples[3], 1u);
+    EXPECT_EQ(buf[0], 1);
+    EXPECT_EQ(buf[2], 1);
+    EXPECT_EQ(buf[3], 1);
+}
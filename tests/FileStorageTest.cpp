@@ -59,6 +59,49 @@ TEST(FileStorageTest, LoadTest) {
     }
 }
 
+TEST(FileStorageTest, KeepOpenTest) {
+    uint8_t buf[32];
+    for (uint_fast8_t i = 0; i < LEN(buf); i++) {
+        buf[i] = i;
+    }
+
+    {
+        FileStorage test(fileName);
+        remove(fileName);
+
+        // Loading doesn't create the file.
+        EXPECT_EQ(test.load(0, LEN(buf), buf), FileStorage::Error::FAILED);
+        EXPECT_FALSE(test.isOpen());
+        EXPECT_EQ(fopen(fileName, "rb"), nullptr);
+
+        // The file stays open between calls.
+        EXPECT_EQ(test.save(0, LEN(buf), buf), FileStorage::Error::NONE);
+        EXPECT_TRUE(test.isOpen());
+        EXPECT_EQ(test.save(4, 4, &buf[8]), FileStorage::Error::NONE);
+
+        uint8_t data[8];
+        EXPECT_EQ(test.load(0, LEN(data), data), FileStorage::Error::NONE);
+        EXPECT_EQ(data[3], 3);
+        EXPECT_EQ(data[4], 8);
+        EXPECT_EQ(data[7], 11);
+
+        // After closing, the file is opened again by the next call.
+        test.close();
+        EXPECT_FALSE(test.isOpen());
+        EXPECT_EQ(test.load(0, LEN(data), data), FileStorage::Error::NONE);
+        EXPECT_TRUE(test.isOpen());
+    }
+
+    // The data was written through to the file.
+    uint8_t data[32];
+    FILE* fs = fopen(fileName, "rb");
+    ASSERT_NE(fs, nullptr);
+    EXPECT_EQ(fread(data, 1, LEN(data), fs), LEN(data));
+    fclose(fs);
+    EXPECT_EQ(data[5], 9);
+    EXPECT_EQ(data[31], 31);
+}
+
 TEST(FileStorageDeathTest, NullFileName) {
     EXPECT_DEATH(FileStorage test(nullptr), "Assertion `this->m_fileName != nullptr' failed.");
 }
@@ -0,0 +1,141 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   FlashSimStorageTest.cpp
+ *
+ *   @brief  Tests storing a control table in simulated EEPROM or flash memory.
+ *
+ ****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+
+#include "ControlTable.h"
+#include "FlashSimStorage.h"
+#include "TestUtil.h"
+#include "Util.h"
+
+//! Convenience aliases
+//! @{
+using Error = bioloid::IControlTableStorage::Error;
+using FlashSimStorage = bioloid::FlashSimStorage;
+using usecs = std::chrono::microseconds;
+//! @}
+
+//! @brief Control table stored in simulated memory.
+class FlashControlTable : public bioloid::IControlTable {
+ public:
+    static constexpr uint8_t NUM_CTL_BYTES = 0x20;         //!< Number of control bytes.
+    static constexpr uint8_t NUM_PERSISTENT_BYTES = 0x18;  //!< Number of persistent bytes.
+
+    FlashControlTable(FlashSimStorage& storage)
+        : IControlTable(
+              NUM_CTL_BYTES, NUM_PERSISTENT_BYTES, this->m_ctlBytes, storage, &this->m_port) {}
+
+ private:
+    uint8_t m_ctlBytes[NUM_CTL_BYTES];
+    TestPort m_port;
+};
+
+using Offset = FlashControlTable::Offset;  //!< Convenience alias
+
+static constexpr size_t PAGE_BYTES = 16;  //!< Number of bytes in each simulated page.
+static constexpr size_t NUM_PAGES = 2;    //!< Number of simulated pages.
+
+//! @brief Simulated memory used by the tests.
+class FlashSimStorageTest : public ::testing::Test {
+ protected:
+    //! @brief Returns the configuration used by the tests.
+    //! @returns the configuration.
+    static FlashSimStorage::Config config() {
+        FlashSimStorage::Config config;
+        config.pageBytes = PAGE_BYTES;
+        config.eraseTime = usecs{1000};
+        config.programTime = usecs{200};
+        return config;
+    }
+
+    uint8_t m_memory[NUM_PAGES * PAGE_BYTES];
+    uint32_t m_wear[NUM_PAGES];
+    FlashSimStorage m_storage{config(), NUM_PAGES, this->m_memory, this->m_wear};
+};
+
+TEST_F(FlashSimStorageTest, Timing) {
+    FlashControlTable test{this->m_storage};
+    test.load();
+    EXPECT_EQ(test.get_u8(Offset::ID), FlashControlTable::DEFAULT_DEVICE_ID);
+
+    // The first save writes every page.
+    EXPECT_EQ(test.save(), Error::NONE);
+    EXPECT_EQ(this->m_storage.stats().lastSaveTime, usecs{2 * 1200});
+    EXPECT_EQ(this->m_storage.stats().numErases, 2u);
+    EXPECT_EQ(this->m_storage.maxWear(), 1u);
+
+    // Changing one byte only rewrites its page.
+    test.set(Offset::ID, uint8_t{5});
+    EXPECT_EQ(test.save(), Error::NONE);
+    EXPECT_EQ(this->m_storage.stats().lastSaveTime, usecs{1200});
+    EXPECT_EQ(this->m_storage.wear(0), 2u);
+    EXPECT_EQ(this->m_storage.wear(1), 1u);
+
+    // Writing the same value doesn't rewrite the page.
+    test.set(Offset::ID, uint8_t{5});
+    EXPECT_EQ(test.save(), Error::NONE);
+    EXPECT_EQ(this->m_storage.stats().lastSaveTime, usecs{0});
+    EXPECT_EQ(this->m_storage.stats().busyTime, usecs{3 * 1200});
+
+    FlashControlTable reload{this->m_storage};
+    reload.load();
+    EXPECT_EQ(reload.get_u8(Offset::ID), 5);
+}
+
+TEST_F(FlashSimStorageTest, SpansInOnePage) {
+    FlashControlTable test{this->m_storage};
+    test.load();
+    EXPECT_EQ(test.save(), Error::NONE);
+
+    // ID and RDT aren't adjacent, so they're saved as two spans which each rewrite page 0.
+    test.set(Offset::ID, uint8_t{5});
+    test.set(Offset::RDT, uint8_t{6});
+    EXPECT_EQ(test.save(), Error::NONE);
+    EXPECT_EQ(this->m_storage.stats().lastSaveTime, usecs{2 * 1200});
+    EXPECT_EQ(this->m_storage.wear(0), 3u);
+}
+
+TEST_F(FlashSimStorageTest, PowerFailure) {
+    FlashControlTable test{this->m_storage};
+    test.load();
+    EXPECT_EQ(test.save(), Error::NONE);
+
+    // Lose power after programming the ID, but before programming the RDT.
+    test.set(Offset::ID, uint8_t{5});
+    test.set(Offset::BAUD, uint8_t{7});
+    test.set(Offset::RDT, uint8_t{6});
+    this->m_storage.failAfter(Offset::RDT);
+    EXPECT_EQ(test.save(), Error::FAILED);
+    EXPECT_TRUE(this->m_storage.isPoweredOff());
+    EXPECT_TRUE(test.isDirty());
+
+    this->m_storage.powerOn();
+    FlashControlTable reload{this->m_storage};
+    reload.load();
+    EXPECT_EQ(reload.get_u8(Offset::ID), 5);
+    EXPECT_EQ(reload.get_u8(Offset::BAUD), 7);
+    EXPECT_EQ(reload.get_u8(Offset::RDT), 0xFF);
+    EXPECT_EQ(this->m_memory[PAGE_BYTES - 1], 0xFF);
+}
+
+TEST_F(FlashSimStorageTest, Blank) {
+    uint8_t data[4];
+    EXPECT_EQ(this->m_storage.load(0, sizeof(data), data), Error::FAILED);
+    EXPECT_EQ(this->m_storage.save(NUM_PAGES * PAGE_BYTES - 2, sizeof(data), data), Error::FAILED);
+}
@@ -0,0 +1,193 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   IndirectMapTest.cpp
+ *
+ *   @brief  Tests indirect addressing of control table bytes.
+ *
+ ****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+#include "ControlTable.h"
+#include "IndirectMap.h"
+#include "TestUtil.h"
+#include "Util.h"
+
+//! Convenience aliases
+//! @{
+using Error = bioloid::Error;
+using IndirectMap = bioloid::IndirectMap;
+//! @}
+
+//! @brief Control table with an indirect address region.
+class IndirectControlTable : public bioloid::IControlTable {
+ public:
+    //! @brief Total number of bytes in the control table.
+    static constexpr uint8_t NUM_CTL_BYTES = 0x60;
+
+    //! @brief Number of bytes in the indirect data window.
+    static constexpr uint8_t NUM_INDIRECT = 8;
+
+    //! @brief Offsets for fields in the IndirectControlTable
+    struct Offset : public IControlTable::Offset {
+        static constexpr Type GOAL = 0x1E;           //!< Goal position (2 bytes)
+        static constexpr Type POSITION = 0x24;       //!< Present position (2 bytes)
+        static constexpr Type VOLTAGE = 0x2A;        //!< Present voltage
+        static constexpr Type TEMPERATURE = 0x2B;    //!< Present temperature
+        static constexpr Type INDIRECT_ADDR = 0x40;  //!< Indirect addresses
+        static constexpr Type INDIRECT_DATA = 0x50;  //!< Indirect data window
+    };
+
+    IndirectControlTable()
+        : IControlTable(NUM_CTL_BYTES, 0x18, this->m_ctlBytes, this->m_storage, &this->m_port),
+          map{Offset::INDIRECT_ADDR, Offset::INDIRECT_DATA, NUM_INDIRECT, this->m_runs} {
+        this->setToInitialValues();
+        this->indirect(&this->map);
+    }
+
+    //! @brief Points the indirect data window at a list of offsets.
+    //! @details Any remaining entries refer to the data window itself.
+    //! @returns the error from writing the address region.
+    Error::Type mapTo(std::initializer_list<Offset::Type> offsets) {
+        uint8_t addrs[NUM_INDIRECT * sizeof(Offset::Type)];
+        const Offset::Type* offset = offsets.begin();
+        size_t idx = 0;
+        for (size_t entry = 0; entry < NUM_INDIRECT; entry++) {
+            size_t addr = entry < offsets.size() ? *offset++ : Offset::INDIRECT_DATA + entry;
+            for (size_t i = 0; i < sizeof(Offset::Type); i++) {
+                addrs[idx++] = static_cast<uint8_t>(addr >> (8 * i));
+            }
+        }
+        return this->write(Offset::INDIRECT_ADDR, addrs, LEN(addrs));
+    }
+
+    IndirectMap map;  //!< Indirect mapping for the control table.
+
+ private:
+    uint8_t m_ctlBytes[NUM_CTL_BYTES];
+    IndirectMap::Run m_runs[NUM_INDIRECT];
+    NullStorage m_storage;
+    TestPort m_port;
+};
+
+using Offset = IndirectControlTable::Offset;  //!< Convenience alias
+
+TEST(IndirectMapTest, GatherTable) {
+    IndirectControlTable test;
+
+    // The address region is initially zero, so every data window byte refers to offset 0.
+    EXPECT_EQ(test.map.numRuns(), IndirectControlTable::NUM_INDIRECT);
+    EXPECT_EQ(test.map.run(0).source, 0);
+
+    // Consecutive offsets are coalesced into a single run.
+    EXPECT_EQ(
+        test.mapTo({Offset::POSITION, Offset::POSITION + 1, Offset::VOLTAGE, Offset::TEMPERATURE}),
+        Error::NONE);
+    ASSERT_EQ(test.map.numRuns(), 3u);
+    EXPECT_EQ(test.map.run(0).source, Offset::POSITION);
+    EXPECT_EQ(test.map.run(0).numBytes, 2);
+    EXPECT_EQ(test.map.run(1).source, Offset::VOLTAGE);
+    EXPECT_EQ(test.map.run(1).index, 2);
+    EXPECT_EQ(test.map.run(1).numBytes, 2);
+    EXPECT_EQ(test.map.run(2).source, Offset::INDIRECT_DATA + 4);
+}
+
+TEST(IndirectMapTest, Read) {
+    IndirectControlTable test;
+
+    test.set(Offset::POSITION, uint16_t{0x1234});
+    test.set(Offset::VOLTAGE, uint8_t{120});
+    test.set(Offset::TEMPERATURE, uint8_t{40});
+    test.mapTo({Offset::POSITION, Offset::POSITION + 1, Offset::TEMPERATURE, Offset::VOLTAGE});
+
+    uint8_t data[4];
+    EXPECT_EQ(test.read(Offset::INDIRECT_DATA, LEN(data), data), Error::NONE);
+    EXPECT_EQ(data[0], 0x34);
+    EXPECT_EQ(data[1], 0x12);
+    EXPECT_EQ(data[2], 40);
+    EXPECT_EQ(data[3], 120);
+
+    // A read which starts before the window is only redirected within the window.
+    uint8_t wide[3];
+    EXPECT_EQ(test.read(Offset::INDIRECT_DATA - 1, LEN(wide), wide), Error::NONE);
+    EXPECT_EQ(wide[0], 0);
+    EXPECT_EQ(wide[1], 0x34);
+    EXPECT_EQ(wide[2], 0x12);
+}
+
+TEST(IndirectMapTest, Write) {
+    IndirectControlTable test;
+
+    test.mapTo({Offset::GOAL, Offset::GOAL + 1, Offset::LED});
+
+    uint8_t data[] = {0x00, 0x02, 0x01};
+    EXPECT_EQ(test.write(Offset::INDIRECT_DATA, data, LEN(data)), Error::NONE);
+    EXPECT_EQ(test.get_u16(Offset::GOAL), 0x0200);
+    EXPECT_EQ(test.get_u8(Offset::LED), 1);
+
+    // The data window itself isn't modified.
+    EXPECT_EQ(test.get_u8(Offset::INDIRECT_DATA), 0);
+}
+
+TEST(IndirectMapTest, InvalidAddress) {
+    IndirectControlTable test;
+
+    // Addresses past the end of the table, or within the window, refer to the window.
+    test.mapTo({IndirectControlTable::NUM_CTL_BYTES, Offset::INDIRECT_DATA + 2});
+    EXPECT_EQ(test.map.numRuns(), 1u);
+    EXPECT_EQ(test.map.run(0).source, Offset::INDIRECT_DATA);
+}
+
+TEST(IndirectMapTest, AddressRegionIsntMapped) {
+    IndirectControlTable test;
+
+    // Addresses within the address region refer to the window, so that writing through the
+    // window can't modify the gather table part way through a WRITE.
+    test.mapTo({Offset::INDIRECT_ADDR, Offset::GOAL});
+    ASSERT_EQ(test.map.numRuns(), 3u);
+    EXPECT_EQ(test.map.run(0).source, Offset::INDIRECT_DATA);
+    EXPECT_EQ(test.map.run(1).source, Offset::GOAL);
+
+    uint8_t data[] = {0x12, 0x34};
+    EXPECT_EQ(test.write(Offset::INDIRECT_DATA, data, LEN(data)), Error::NONE);
+    EXPECT_EQ(test.get_u8(Offset::INDIRECT_DATA), 0x12);
+    EXPECT_EQ(test.get_u8(Offset::GOAL), 0x34);
+    EXPECT_EQ(test.map.run(1).source, Offset::GOAL);
+}
+
+TEST(IndirectMapTest, WriteAddressesAndData) {
+    IndirectControlTable test;
+
+    test.mapTo({Offset::GOAL, Offset::GOAL + 1});
+
+    // A single WRITE covering both the address region and the data window stores the data
+    // using the addresses from before the WRITE.
+    uint8_t data[Offset::INDIRECT_DATA - Offset::INDIRECT_ADDR + 2] = {};
+    for (size_t entry = 0; entry < IndirectControlTable::NUM_INDIRECT; entry++) {
+        size_t addr = entry == 0 ? Offset::LED : Offset::INDIRECT_DATA + entry;
+        for (size_t i = 0; i < sizeof(Offset::Type); i++) {
+            data[entry * sizeof(Offset::Type) + i] = static_cast<uint8_t>(addr >> (8 * i));
+        }
+    }
+    data[LEN(data) - 2] = 0x00;
+    data[LEN(data) - 1] = 0x02;
+    EXPECT_EQ(test.write(Offset::INDIRECT_ADDR, data, LEN(data)), Error::NONE);
+    EXPECT_EQ(test.get_u16(Offset::GOAL), 0x0200);
+    EXPECT_EQ(test.get_u8(Offset::LED), 0);
+
+    // The new addresses are used by the next access.
+    EXPECT_EQ(test.map.run(0).source, Offset::LED);
+    uint8_t led = 1;
+    EXPECT_EQ(test.write(Offset::INDIRECT_DATA, &led, 1), Error::NONE);
+    EXPECT_EQ(test.get_u8(Offset::LED), 1);
+}
@@ -0,0 +1,227 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   LayoutMigrationTest.cpp
+ *
+ *   @brief  Tests migrating persistent bytes saved using an older layout.
+ *
+ ****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "ControlTable.h"
+#include "LayoutMigration.h"
+#include "SafeFileStorage.h"
+#include "TestUtil.h"
+#include "Util.h"
+
+static constexpr const char* fileName = "LayoutMigrationTest.ctl";
+
+//! Convenience aliases
+//! @{
+using Error = bioloid::IControlTableStorage::Error;
+using LayoutMigrations = bioloid::LayoutMigrations;
+using MigrationCopy = bioloid::MigrationCopy;
+using MigrationStep = bioloid::MigrationStep;
+template <size_t NUM_NEW_BYTES>
+using MigrationPlan = bioloid::MigrationPlan<NUM_NEW_BYTES>;
+//! @}
+
+//! Version 1 to 2 moved the calibration from 0x06 to 0x10, and added 4 bytes.
+static constexpr MigrationCopy V1_COPIES[] = {
+    // from  to    numBytes
+    {0x00,   0x00, 0x06},
+    {0x08,   0x08, 0x08},
+    {0x06,   0x10, 0x02},
+};
+
+//! Version 2 to 3 added 4 bytes to the end.
+static constexpr MigrationCopy V2_COPIES[] = {
+    // from  to    numBytes
+    {0x00,   0x00, 0x14},
+};
+
+static constexpr MigrationPlan<0x14> V1_PLAN{1, 0x10, V1_COPIES};  //!< Version 1 to 2.
+static constexpr MigrationPlan<0x18> V2_PLAN{2, 0x14, V2_COPIES};  //!< Version 2 to 3.
+static constexpr MigrationStep STEPS[] = {V1_PLAN, V2_PLAN};       //!< All of the steps.
+static constexpr LayoutMigrations MIGRATIONS{3, STEPS};            //!< Migrations to version 3.
+
+static_assert(STEPS[0].source(0x10) == 0x06);
+static_assert(STEPS[0].source(0x06) == MigrationCopy::NEW_BYTE);
+static_assert(STEPS[1].source(0x13) == 0x13);
+
+//! @brief Control table stored using SafeFileStorage with a particular layout version.
+class VersionedControlTable : public bioloid::IControlTable {
+ public:
+    static constexpr uint8_t NUM_CTL_BYTES = 0x20;  //!< Number of control bytes.
+
+    VersionedControlTable(uint16_t version, uint8_t numPersistentBytes)
+        : IControlTable(
+              NUM_CTL_BYTES, numPersistentBytes, this->m_ctlBytes, this->m_storage,
+              &this->m_port),
+          m_storage{fileName, version, numPersistentBytes, this->m_image} {}
+
+ private:
+    uint8_t m_ctlBytes[NUM_CTL_BYTES];
+    uint8_t m_image[NUM_CTL_BYTES];
+    bioloid::SafeFileStorage m_storage;
+    TestPort m_port;
+};
+
+using Offset = VersionedControlTable::Offset;  //!< Convenience alias
+
+TEST(LayoutMigrationTest, Migrate) {
+    uint8_t oldBytes[0x14];
+    for (size_t idx = 0; idx < sizeof(oldBytes); idx++) {
+        oldBytes[idx] = static_cast<uint8_t>(idx);
+    }
+
+    // Both steps are applied at once.
+    uint8_t newBytes[0x18];
+    memset(newBytes, 0xEE, sizeof(newBytes));
+    EXPECT_TRUE(MIGRATIONS.migrate(1, oldBytes, 0x10, newBytes, sizeof(newBytes)));
+    EXPECT_EQ(newBytes[0x05], 0x05);
+    EXPECT_EQ(newBytes[0x06], 0xEE);
+    EXPECT_EQ(newBytes[0x0F], 0x0F);
+    EXPECT_EQ(newBytes[0x10], 0x06);
+    EXPECT_EQ(newBytes[0x11], 0x07);
+    EXPECT_EQ(newBytes[0x12], 0xEE);
+    EXPECT_EQ(newBytes[0x17], 0xEE);
+
+    memset(newBytes, 0xEE, sizeof(newBytes));
+    EXPECT_TRUE(MIGRATIONS.migrate(2, oldBytes, 0x14, newBytes, sizeof(newBytes)));
+    EXPECT_EQ(memcmp(newBytes, oldBytes, sizeof(oldBytes)), 0);
+    EXPECT_EQ(newBytes[0x14], 0xEE);
+
+    // The current layout must have exactly as many bytes as the last step produces.
+    EXPECT_FALSE(MIGRATIONS.migrate(2, oldBytes, 0x14, newBytes, 0x14));
+    EXPECT_FALSE(MIGRATIONS.migrate(2, oldBytes, 0x14, newBytes, 0x1C));
+    EXPECT_EQ(MIGRATIONS.numBytes(), 0x18u);
+
+    EXPECT_FALSE(MIGRATIONS.canMigrate(1, 0x14));
+    EXPECT_FALSE(MIGRATIONS.canMigrate(0, 0x10));
+    EXPECT_FALSE(MIGRATIONS.canMigrate(3, 0x18));
+}
+
+TEST(LayoutMigrationTest, Load) {
+    remove(fileName);
+    {
+        VersionedControlTable old{1, 0x10};
+        old.load();
+        old.set(Offset::ID, uint8_t{5});
+        old.set(0x06, uint16_t{0x1234});
+        EXPECT_EQ(old.save(), Error::NONE);
+    }
+
+    {
+        VersionedControlTable test{3, 0x18};
+        test.migrations(&MIGRATIONS);
+        test.load();
+        EXPECT_EQ(test.get_u8(Offset::ID), 5);
+        EXPECT_EQ(test.get_u16(0x10), 0x1234);
+        EXPECT_EQ(test.get_u16(0x06), 0);
+        EXPECT_EQ(test.get_u8(Offset::BAUD), VersionedControlTable::DEFAULT_BAUD);
+
+        // The migrated bytes are saved using the current layout.
+        EXPECT_TRUE(test.isDirty());
+        EXPECT_EQ(test.save(), Error::NONE);
+    }
+
+    VersionedControlTable reload{3, 0x18};
+    reload.load();
+    EXPECT_EQ(reload.get_u8(Offset::ID), 5);
+    EXPECT_EQ(reload.get_u16(0x10), 0x1234);
+    EXPECT_FALSE(reload.isDirty());
+
+    remove(fileName);
+}
+
+TEST(LayoutMigrationTest, NoMigration) {
+    remove(fileName);
+    {
+        VersionedControlTable old{1, 0x10};
+        old.load();
+        old.set(Offset::ID, uint8_t{5});
+        EXPECT_EQ(old.save(), Error::NONE);
+    }
+
+    // Without migrations, the table is set to its initial values.
+    VersionedControlTable test{3, 0x18};
+    test.load();
+    EXPECT_EQ(test.get_u8(Offset::ID), VersionedControlTable::DEFAULT_DEVICE_ID);
+
+    remove(fileName);
+}
+
+TEST(LayoutMigrationTest, NewerLayout) {
+    remove(fileName);
+    {
+        VersionedControlTable newer{4, 0x1C};
+        newer.load();
+        newer.set(Offset::ID, uint8_t{5});
+        EXPECT_EQ(newer.save(), Error::NONE);
+    }
+
+    // Bytes saved by newer firmware are rejected, and replaced by a complete image using
+    // the current layout the first time the table is saved.
+    {
+        VersionedControlTable test{3, 0x18};
+        test.migrations(&MIGRATIONS);
+        test.load();
+        EXPECT_EQ(test.get_u8(Offset::ID), VersionedControlTable::DEFAULT_DEVICE_ID);
+        EXPECT_TRUE(test.isDirty());
+        test.set(Offset::RDT, uint8_t{7});
+        EXPECT_EQ(test.save(), Error::NONE);
+    }
+
+    VersionedControlTable reload{3, 0x18};
+    reload.load();
+    EXPECT_EQ(reload.get_u8(Offset::ID), VersionedControlTable::DEFAULT_DEVICE_ID);
+    EXPECT_EQ(reload.get_u8(Offset::BAUD), VersionedControlTable::DEFAULT_BAUD);
+    EXPECT_EQ(reload.get_u8(Offset::RDT), 7);
+    EXPECT_FALSE(reload.isDirty());
+
+    remove(fileName);
+}
+
+TEST(LayoutMigrationTest, MigrationFails) {
+    remove(fileName);
+    {
+        VersionedControlTable old{1, 0x10};
+        old.load();
+        old.set(Offset::ID, uint8_t{5});
+        EXPECT_EQ(old.save(), Error::NONE);
+    }
+
+    // The migrations produce 0x18 persistent bytes, so migrating to 0x1C fails and the
+    // table is saved from its initial values.
+    {
+        VersionedControlTable test{3, 0x1C};
+        test.migrations(&MIGRATIONS);
+        test.load();
+        EXPECT_EQ(test.get_u8(Offset::ID), VersionedControlTable::DEFAULT_DEVICE_ID);
+        EXPECT_TRUE(test.isDirty());
+        test.set(Offset::RDT, uint8_t{7});
+        EXPECT_EQ(test.save(), Error::NONE);
+    }
+
+    VersionedControlTable reload{3, 0x1C};
+    reload.load();
+    EXPECT_EQ(reload.get_u8(Offset::ID), VersionedControlTable::DEFAULT_DEVICE_ID);
+    EXPECT_EQ(reload.get_u8(Offset::BAUD), VersionedControlTable::DEFAULT_BAUD);
+    EXPECT_EQ(reload.get_u8(Offset::RDT), 7);
+    EXPECT_FALSE(reload.isDirty());
+
+    remove(fileName);
+}
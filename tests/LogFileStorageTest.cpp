@@ -0,0 +1,165 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   LogFileStorageTest.cpp
+ *
+ *   @brief  Tests log-structured storage of a control table.
+ *
+ ****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+
+#include "ControlTable.h"
+#include "LogFileStorage.h"
+#include "TestUtil.h"
+#include "Util.h"
+
+static constexpr const char* fileName = "LogFileStorageTest.ctl";
+
+//! Convenience aliases
+//! @{
+using Error = bioloid::IControlTableStorage::Error;
+using LogFileStorage = bioloid::LogFileStorage;
+//! @}
+
+//! @brief Control table stored using LogFileStorage.
+class LogControlTable : public bioloid::IControlTable {
+ public:
+    static constexpr uint8_t NUM_CTL_BYTES = 0x20;         //!< Number of control bytes.
+    static constexpr uint8_t NUM_PERSISTENT_BYTES = 0x18;  //!< Number of persistent bytes.
+
+    //! Number of bytes in a record containing all of the persistent bytes.
+    static constexpr size_t FULL_RECORD_BYTES = LogFileStorage::RECORD_HEADER_BYTES +
+                                                NUM_PERSISTENT_BYTES +
+                                                LogFileStorage::RECORD_CRC_BYTES;
+
+    LogControlTable(size_t compactThreshold = 1024)
+        : IControlTable(
+              NUM_CTL_BYTES, NUM_PERSISTENT_BYTES, this->m_ctlBytes, this->storage,
+              &this->m_port),
+          storage{fileName, NUM_PERSISTENT_BYTES, this->m_image, compactThreshold} {}
+
+    LogFileStorage storage;  //!< Storage for the control table.
+
+ private:
+    uint8_t m_ctlBytes[NUM_CTL_BYTES];
+    uint8_t m_image[NUM_PERSISTENT_BYTES];
+    TestPort m_port;
+};
+
+using Offset = LogControlTable::Offset;  //!< Convenience alias
+
+//! @brief Returns the size of the test file.
+//! @returns the number of bytes in the file.
+static long fileSize() {
+    FILE* fs = fopen(fileName, "rb");
+    if (fs == nullptr) {
+        return -1;
+    }
+    fseek(fs, 0, SEEK_END);
+    long size = ftell(fs);
+    fclose(fs);
+    return size;
+}
+
+TEST(LogFileStorageTest, Append) {
+    remove(fileName);
+    {
+        LogControlTable test;
+        test.load();
+        EXPECT_EQ(test.get_u8(Offset::ID), LogControlTable::DEFAULT_DEVICE_ID);
+
+        // The first save writes a record containing everything.
+        EXPECT_EQ(test.save(), Error::NONE);
+        EXPECT_EQ(fileSize(), static_cast<long>(LogControlTable::FULL_RECORD_BYTES));
+
+        // Subsequent saves only append the modified bytes.
+        test.set(Offset::ID, uint8_t{5});
+        EXPECT_EQ(test.save(), Error::NONE);
+        test.set(Offset::ID, uint8_t{6});
+        test.set(Offset::RDT, uint8_t{7});
+        EXPECT_EQ(test.save(), Error::NONE);
+        EXPECT_EQ(test.storage.logBytes(), LogControlTable::FULL_RECORD_BYTES + 3 * 9);
+        EXPECT_EQ(fileSize(), static_cast<long>(test.storage.logBytes()));
+        EXPECT_EQ(test.storage.stats().numRecords, 4u);
+    }
+
+    LogControlTable test;
+    test.load();
+    EXPECT_EQ(test.get_u8(Offset::ID), 6);
+    EXPECT_EQ(test.get_u8(Offset::RDT), 7);
+
+    remove(fileName);
+}
+
+TEST(LogFileStorageTest, TornRecord) {
+    remove(fileName);
+    {
+        LogControlTable test;
+        test.load();
+        test.set(Offset::ID, uint8_t{5});
+        EXPECT_EQ(test.save(), Error::NONE);
+        test.set(Offset::ID, uint8_t{6});
+        EXPECT_EQ(test.save(), Error::NONE);
+    }
+
+    // Simulate a power failure part way through appending the last record.
+    long size = fileSize();
+    ASSERT_EQ(truncate(fileName, size - 2), 0);
+
+    LogControlTable test;
+    test.load();
+    EXPECT_EQ(test.get_u8(Offset::ID), 5);
+    EXPECT_EQ(fileSize(), static_cast<long>(LogControlTable::FULL_RECORD_BYTES));
+
+    // New records are appended after the last valid one.
+    test.set(Offset::ID, uint8_t{8});
+    EXPECT_EQ(test.save(), Error::NONE);
+    LogControlTable reload;
+    reload.load();
+    EXPECT_EQ(reload.get_u8(Offset::ID), 8);
+
+    remove(fileName);
+}
+
+TEST(LogFileStorageTest, Compact) {
+    remove(fileName);
+    LogControlTable test{64};
+    test.load();
+    EXPECT_EQ(test.save(), Error::NONE);
+    for (uint8_t i = 0; i < 10; i++) {
+        test.set(Offset::ID, i);
+        EXPECT_EQ(test.save(), Error::NONE);
+        EXPECT_LE(test.storage.logBytes(), 64u + 9u);
+    }
+    EXPECT_GT(test.storage.stats().numCompactions, 1u);
+    EXPECT_EQ(test.storage.stats().bytesSaved, LogControlTable::NUM_PERSISTENT_BYTES + 10u);
+    EXPECT_GT(test.storage.stats().bytesWritten, test.storage.stats().bytesSaved);
+
+    LogControlTable reload;
+    reload.load();
+    EXPECT_EQ(reload.get_u8(Offset::ID), 9);
+
+    remove(fileName);
+}
+
+#if BIOLOID_CTL_ADDR_BITS == 16
+TEST(LogFileStorageDeathTest, TooManyPersistentBytes) {
+    uint8_t image[1];
+    EXPECT_DEATH(
+        LogFileStorage(fileName, BIOLOID_CTL_MAX_PERSISTENT_BYTES + 1, image, 1024),
+        "Assertion `this->m_numPersistentBytes <= BIOLOID_CTL_MAX_PERSISTENT_BYTES' failed.");
+}
+#endif
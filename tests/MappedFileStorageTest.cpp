@@ -0,0 +1,141 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   MappedFileStorageTest.cpp
+ *
+ *   @brief  Tests storing a control table in a memory mapped file.
+ *
+ ****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "ControlTable.h"
+#include "MappedFileStorage.h"
+#include "TestUtil.h"
+#include "Util.h"
+
+static constexpr const char* fileName = "MappedFileStorageTest.ctl";
+
+//! Convenience aliases
+//! @{
+using Error = bioloid::IControlTableStorage::Error;
+using MappedFileStorage = bioloid::MappedFileStorage;
+//! @}
+
+//! @brief Control table whose bytes are stored by the storage.
+class MappedControlTable : public bioloid::IControlTable {
+ public:
+    static constexpr uint8_t NUM_CTL_BYTES = 0x20;         //!< Number of control bytes.
+    static constexpr uint8_t NUM_PERSISTENT_BYTES = 0x18;  //!< Number of persistent bytes.
+
+    MappedControlTable(MappedFileStorage& storage)
+        : IControlTable(
+              NUM_CTL_BYTES, NUM_PERSISTENT_BYTES, storage.ctlBytes(), storage, &this->m_port) {
+    }
+
+ private:
+    TestPort m_port;
+};
+
+using Offset = MappedControlTable::Offset;  //!< Convenience alias
+
+//! @brief Reads the contents of the test file.
+//! @returns the number of bytes read.
+static size_t readFile(uint8_t* buf, size_t numBytes) {
+    FILE* fs = fopen(fileName, "rb");
+    if (fs == nullptr) {
+        return 0;
+    }
+    size_t bytesRead = fread(buf, 1, numBytes, fs);
+    fclose(fs);
+    return bytesRead;
+}
+
+TEST(MappedFileStorageTest, LoadSave) {
+    remove(fileName);
+    {
+        MappedFileStorage storage{fileName};
+        ASSERT_TRUE(storage.map(
+            MappedControlTable::NUM_CTL_BYTES, MappedControlTable::NUM_PERSISTENT_BYTES));
+        MappedControlTable test{storage};
+
+        // A new file causes the table to be set to its initial values.
+        test.load();
+        EXPECT_EQ(test.get_u8(Offset::ID), MappedControlTable::DEFAULT_DEVICE_ID);
+        EXPECT_EQ(test.get_u8(Offset::RDT), MappedControlTable::DEFAULT_RDT);
+
+        test.set(Offset::ID, uint8_t{7});
+        test.set(Offset::LED, uint8_t{1});
+        EXPECT_EQ(test.save(), Error::NONE);
+    }
+
+    // The file only contains the persistent bytes.
+    uint8_t buf[MappedControlTable::NUM_CTL_BYTES];
+    EXPECT_EQ(readFile(buf, LEN(buf)), MappedControlTable::NUM_PERSISTENT_BYTES);
+    EXPECT_EQ(buf[Offset::ID], 7);
+
+    MappedFileStorage storage{fileName};
+    ASSERT_TRUE(storage.map(
+        MappedControlTable::NUM_CTL_BYTES, MappedControlTable::NUM_PERSISTENT_BYTES));
+    MappedControlTable test{storage};
+    test.load();
+    EXPECT_EQ(test.get_u8(Offset::ID), 7);
+    EXPECT_EQ(test.get_u8(Offset::RDT), MappedControlTable::DEFAULT_RDT);
+    EXPECT_EQ(test.get_u8(Offset::LED), 0);
+
+    remove(fileName);
+}
+
+TEST(MappedFileStorageTest, Relaxed) {
+    remove(fileName);
+    MappedFileStorage storage{fileName, MappedFileStorage::Sync::RELAXED};
+    ASSERT_TRUE(storage.map(
+        MappedControlTable::NUM_CTL_BYTES, MappedControlTable::NUM_PERSISTENT_BYTES));
+    MappedControlTable test{storage};
+    test.load();
+    test.set(Offset::BAUD, uint8_t{34});
+    EXPECT_EQ(test.save(), Error::NONE);
+
+    // The file shares the page cache with the mapping, so it sees the modification.
+    uint8_t buf[MappedControlTable::NUM_PERSISTENT_BYTES];
+    EXPECT_EQ(readFile(buf, LEN(buf)), LEN(buf));
+    EXPECT_EQ(buf[Offset::BAUD], 34);
+
+    remove(fileName);
+}
+
+TEST(MappedFileStorageTest, Copy) {
+    remove(fileName);
+    MappedFileStorage storage{fileName};
+
+    // Nothing can be loaded or saved until the file is mapped.
+    uint8_t data[4] = {1, 2, 3, 4};
+    EXPECT_EQ(storage.save(0, LEN(data), data), Error::FAILED);
+    ASSERT_TRUE(storage.map(0x10, 0x08));
+
+    // Storage can also be used with control bytes that live elsewhere.
+    EXPECT_EQ(storage.load(0, LEN(data), data), Error::FAILED);
+    EXPECT_EQ(storage.save(2, LEN(data), data), Error::NONE);
+    uint8_t loaded[4];
+    EXPECT_EQ(storage.load(2, LEN(loaded), loaded), Error::NONE);
+    EXPECT_EQ(memcmp(loaded, data, LEN(data)), 0);
+    EXPECT_EQ(storage.ctlBytes()[3], 2);
+
+    // Only the persistent bytes can be loaded or saved.
+    EXPECT_EQ(storage.save(6, LEN(data), data), Error::FAILED);
+
+    storage.unmap();
+    EXPECT_EQ(storage.ctlBytes(), nullptr);
+    remove(fileName);
+}
@@ -0,0 +1,164 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   RedundantStorageTest.cpp
+ *
+ *   @brief  Tests storing a control table in two alternating slots.
+ *
+ ****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstdio>
+
+#include "ControlTable.h"
+#include "FileStorage.h"
+#include "FlashSimStorage.h"
+#include "RedundantStorage.h"
+#include "TestUtil.h"
+#include "Util.h"
+
+static constexpr const char* fileName = "RedundantStorageTest.ctl";
+
+//! Convenience aliases
+//! @{
+using Error = bioloid::IControlTableStorage::Error;
+using FlashSimStorage = bioloid::FlashSimStorage;
+using RedundantStorage = bioloid::RedundantStorage;
+//! @}
+
+//! @brief Control table stored in two alternating slots of another storage object.
+class RedundantControlTable : public bioloid::IControlTable {
+ public:
+    static constexpr uint8_t NUM_CTL_BYTES = 0x20;         //!< Number of control bytes.
+    static constexpr uint8_t NUM_PERSISTENT_BYTES = 0x18;  //!< Number of persistent bytes.
+
+    //! Number of bytes in each slot.
+    static constexpr size_t SLOT_BYTES = RedundantStorage::slotBytes(NUM_PERSISTENT_BYTES);
+
+    RedundantControlTable(bioloid::IControlTableStorage& slots)
+        : IControlTable(
+              NUM_CTL_BYTES, NUM_PERSISTENT_BYTES, this->m_ctlBytes, this->storage,
+              &this->m_port),
+          storage{slots, NUM_PERSISTENT_BYTES, this->m_image} {}
+
+    RedundantStorage storage;  //!< Storage for the control table.
+
+ private:
+    uint8_t m_ctlBytes[NUM_CTL_BYTES];
+    uint8_t m_image[SLOT_BYTES];
+    TestPort m_port;
+};
+
+using Offset = RedundantControlTable::Offset;  //!< Convenience alias
+
+static constexpr size_t PAGE_BYTES = 8;  //!< Number of bytes in each simulated page.
+
+//! Number of simulated pages needed for both slots.
+static constexpr size_t NUM_PAGES = 2 * RedundantControlTable::SLOT_BYTES / PAGE_BYTES;
+
+//! @brief Slots stored in simulated flash memory.
+class RedundantStorageTest : public ::testing::Test {
+ protected:
+    //! @brief Returns the configuration of the simulated memory.
+    //! @returns the configuration.
+    static FlashSimStorage::Config config() {
+        FlashSimStorage::Config config;
+        config.pageBytes = PAGE_BYTES;
+        return config;
+    }
+
+    uint8_t m_memory[NUM_PAGES * PAGE_BYTES];
+    uint32_t m_wear[NUM_PAGES];
+    FlashSimStorage m_flash{config(), NUM_PAGES, this->m_memory, this->m_wear};
+};
+
+TEST_F(RedundantStorageTest, Alternate) {
+    RedundantControlTable test{this->m_flash};
+    test.load();
+    EXPECT_EQ(test.storage.activeSlot(), RedundantStorage::NO_SLOT);
+
+    for (uint8_t i = 1; i <= 3; i++) {
+        test.set(Offset::ID, i);
+        EXPECT_EQ(test.save(), Error::NONE);
+        EXPECT_EQ(test.storage.generation(), i);
+        EXPECT_EQ(test.storage.activeSlot(), (i - 1u) % 2);
+
+        RedundantControlTable reload{this->m_flash};
+        reload.load();
+        EXPECT_EQ(reload.get_u8(Offset::ID), i);
+        EXPECT_EQ(reload.storage.generation(), i);
+    }
+}
+
+TEST_F(RedundantStorageTest, PowerFailure) {
+    RedundantControlTable test{this->m_flash};
+    test.load();
+    test.set(Offset::ID, uint8_t{5});
+    EXPECT_EQ(test.save(), Error::NONE);
+
+    // Lose power part way through writing the persistent bytes of the second slot.
+    test.set(Offset::ID, uint8_t{6});
+    this->m_flash.failAfter(RedundantStorage::HEADER_BYTES + 2);
+    EXPECT_EQ(test.save(), Error::FAILED);
+    this->m_flash.powerOn();
+
+    RedundantControlTable reload{this->m_flash};
+    reload.load();
+    EXPECT_EQ(reload.get_u8(Offset::ID), 5);
+    EXPECT_EQ(reload.storage.activeSlot(), 0u);
+
+    // The next save overwrites the torn slot, rather than the valid one.
+    reload.set(Offset::ID, uint8_t{7});
+    EXPECT_EQ(reload.save(), Error::NONE);
+    EXPECT_EQ(reload.storage.activeSlot(), 1u);
+    EXPECT_EQ(reload.storage.generation(), 2u);
+}
+
+TEST_F(RedundantStorageTest, CorruptHeader) {
+    RedundantControlTable test{this->m_flash};
+    test.load();
+    test.set(Offset::ID, uint8_t{5});
+    EXPECT_EQ(test.save(), Error::NONE);
+    test.set(Offset::ID, uint8_t{6});
+    EXPECT_EQ(test.save(), Error::NONE);
+
+    // Corrupt the generation number of the newest slot.
+    uint8_t generation = 0x55;
+    EXPECT_EQ(this->m_flash.save(RedundantControlTable::SLOT_BYTES, 1, &generation), Error::NONE);
+
+    RedundantControlTable reload{this->m_flash};
+    reload.load();
+    EXPECT_EQ(reload.get_u8(Offset::ID), 5);
+    EXPECT_EQ(reload.storage.activeSlot(), 0u);
+}
+
+TEST(RedundantFileStorageTest, File) {
+    remove(fileName);
+    {
+        bioloid::FileStorage file{fileName};
+        RedundantControlTable test{file};
+        test.load();
+        EXPECT_EQ(test.get_u8(Offset::ID), RedundantControlTable::DEFAULT_DEVICE_ID);
+        test.set(Offset::ID, uint8_t{5});
+        EXPECT_EQ(test.save(), Error::NONE);
+        test.set(Offset::ID, uint8_t{6});
+        EXPECT_EQ(test.save(), Error::NONE);
+    }
+
+    bioloid::FileStorage file{fileName};
+    RedundantControlTable test{file};
+    test.load();
+    EXPECT_EQ(test.get_u8(Offset::ID), 6);
+    EXPECT_EQ(test.storage.generation(), 2u);
+
+    remove(fileName);
+}
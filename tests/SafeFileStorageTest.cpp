@@ -0,0 +1,158 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   SafeFileStorageTest.cpp
+ *
+ *   @brief  Tests crash-safe storage of a control table.
+ *
+ ****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "ControlTable.h"
+#include "SafeFileStorage.h"
+#include "TestUtil.h"
+#include "Util.h"
+
+static constexpr const char* fileName = "SafeFileStorageTest.ctl";
+
+//! Convenience aliases
+//! @{
+using Error = bioloid::IControlTableStorage::Error;
+using SafeFileStorage = bioloid::SafeFileStorage;
+//! @}
+
+//! @brief Control table stored using SafeFileStorage.
+class SafeControlTable : public bioloid::IControlTable {
+ public:
+    static constexpr uint8_t NUM_CTL_BYTES = 0x20;         //!< Number of control bytes.
+    static constexpr uint8_t NUM_PERSISTENT_BYTES = 0x18;  //!< Number of persistent bytes.
+    static constexpr uint16_t LAYOUT_VERSION = 3;          //!< Version of the layout.
+
+    SafeControlTable(const char* name = fileName, uint16_t version = LAYOUT_VERSION)
+        : IControlTable(
+              NUM_CTL_BYTES, NUM_PERSISTENT_BYTES, this->m_ctlBytes, this->m_storage,
+              &this->m_port),
+          m_storage{name, version, NUM_PERSISTENT_BYTES, this->m_image} {}
+
+ private:
+    uint8_t m_ctlBytes[NUM_CTL_BYTES];
+    uint8_t m_image[NUM_PERSISTENT_BYTES];
+    SafeFileStorage m_storage;
+    TestPort m_port;
+};
+
+using Offset = SafeControlTable::Offset;  //!< Convenience alias
+
+//! @brief Reads the contents of the test file.
+//! @returns the number of bytes read.
+static size_t readFile(uint8_t* buf, size_t numBytes) {
+    FILE* fs = fopen(fileName, "rb");
+    if (fs == nullptr) {
+        return 0;
+    }
+    size_t bytesRead = fread(buf, 1, numBytes, fs);
+    fclose(fs);
+    return bytesRead;
+}
+
+//! @brief Replaces the contents of the test file.
+static void writeFile(const uint8_t* buf, size_t numBytes) {
+    FILE* fs = fopen(fileName, "wb");
+    ASSERT_NE(fs, nullptr);
+    EXPECT_EQ(fwrite(buf, 1, numBytes, fs), numBytes);
+    fclose(fs);
+}
+
+TEST(SafeFileStorageTest, LoadSave) {
+    remove(fileName);
+    {
+        SafeControlTable test;
+        test.load();
+        EXPECT_EQ(test.get_u8(Offset::ID), SafeControlTable::DEFAULT_DEVICE_ID);
+        test.set(Offset::ID, uint8_t{9});
+        EXPECT_EQ(test.save(), Error::NONE);
+    }
+
+    // The file contains the header followed by the persistent bytes.
+    uint8_t buf[64];
+    ASSERT_EQ(
+        readFile(buf, LEN(buf)),
+        SafeFileStorage::HEADER_BYTES + SafeControlTable::NUM_PERSISTENT_BYTES);
+    EXPECT_EQ(buf[0], 'B');
+    EXPECT_EQ(buf[3], 'L');
+    EXPECT_EQ(buf[4], SafeControlTable::LAYOUT_VERSION);
+    EXPECT_EQ(buf[6], SafeControlTable::NUM_PERSISTENT_BYTES);
+    EXPECT_EQ(buf[SafeFileStorage::HEADER_BYTES + Offset::ID], 9);
+
+    // The temporary file was renamed over the original.
+    EXPECT_EQ(fopen("SafeFileStorageTest.ctl.tmp", "rb"), nullptr);
+
+    SafeControlTable test;
+    test.load();
+    EXPECT_EQ(test.get_u8(Offset::ID), 9);
+
+    remove(fileName);
+}
+
+TEST(SafeFileStorageTest, Invalid) {
+    remove(fileName);
+    {
+        SafeControlTable test;
+        test.load();
+        test.set(Offset::ID, uint8_t{9});
+        EXPECT_EQ(test.save(), Error::NONE);
+    }
+    uint8_t good[64];
+    size_t numBytes = readFile(good, LEN(good));
+
+    // A corrupted byte causes the initial values to be used.
+    uint8_t buf[64];
+    memcpy(buf, good, numBytes);
+    buf[SafeFileStorage::HEADER_BYTES + Offset::ID] ^= 1;
+    writeFile(buf, numBytes);
+    {
+        SafeControlTable test;
+        test.load();
+        EXPECT_EQ(test.get_u8(Offset::ID), SafeControlTable::DEFAULT_DEVICE_ID);
+    }
+
+    // As does a truncated file.
+    writeFile(good, numBytes - 1);
+    {
+        SafeControlTable test;
+        test.load();
+        EXPECT_EQ(test.get_u8(Offset::ID), SafeControlTable::DEFAULT_DEVICE_ID);
+    }
+
+    // As does a different layout version.
+    writeFile(good, numBytes);
+    {
+        SafeControlTable test{fileName, SafeControlTable::LAYOUT_VERSION + 1};
+        test.load();
+        EXPECT_EQ(test.get_u8(Offset::ID), SafeControlTable::DEFAULT_DEVICE_ID);
+    }
+
+    remove(fileName);
+}
+
+TEST(SafeFileStorageTest, CommitFail) {
+    SafeControlTable test{"no-such-directory/SafeFileStorageTest.ctl"};
+    test.load();
+    test.set(Offset::ID, uint8_t{9});
+
+    // Everything stays dirty, so that the next save retries.
+    EXPECT_EQ(test.save(), Error::FAILED);
+    EXPECT_TRUE(test.isDirty());
+}
@@ -0,0 +1,118 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   SeqLockTest.cpp
+ *
+ *   @brief  Tests the sequence lock protected control table.
+ *
+ ****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#include "ControlTable.h"
+#include "SeqLock.h"
+#include "TestUtil.h"
+#include "Util.h"
+
+//! @brief Control table protected by a sequence lock.
+class LockedControlTable : public bioloid::IControlTable {
+ public:
+    //! @brief Total number of bytes in the control table.
+    static constexpr uint8_t NUM_CTL_BYTES = 0x20;
+
+    //! @brief Offset of a 32-bit field used for testing.
+    static constexpr Offset::Type FIELD = 0x10;
+
+    LockedControlTable()
+        : IControlTable(NUM_CTL_BYTES, 0x08, this->m_ctlBytes, this->m_storage, &this->m_port) {
+        this->seqLock(&this->lock);
+        this->setToInitialValues();
+    }
+
+    bioloid::SeqLock lock;  //!< Sequence lock protecting the control table.
+
+ private:
+    uint8_t m_ctlBytes[NUM_CTL_BYTES];
+    NullStorage m_storage;
+    TestPort m_port;
+};
+
+TEST(SeqLockTest, SequenceAdvances) {
+    LockedControlTable test;
+
+    uint32_t sequence = test.lock.sequence();
+    EXPECT_EQ(sequence & 1, 0u);
+
+    test.set(LockedControlTable::FIELD, uint32_t{1});
+    EXPECT_EQ(test.lock.sequence(), sequence + 2);
+
+    uint8_t data[2] = {};
+    EXPECT_EQ(test.write(LockedControlTable::FIELD, data, LEN(data)), bioloid::Error::NONE);
+    EXPECT_EQ(test.lock.sequence(), sequence + 4);
+
+    // Rejected writes don't touch the sequence number.
+    EXPECT_EQ(test.write(LockedControlTable::NUM_CTL_BYTES - 1, data, LEN(data)),
+              bioloid::Error::RANGE);
+    EXPECT_EQ(test.lock.sequence(), sequence + 4);
+}
+
+TEST(SeqLockTest, ReadRetry) {
+    bioloid::SeqLock lock;
+
+    uint32_t sequence = lock.readBegin();
+    EXPECT_FALSE(lock.readRetry(sequence));
+
+    lock.writeBegin();
+    lock.writeEnd();
+    EXPECT_TRUE(lock.readRetry(sequence));
+}
+
+TEST(SeqLockTest, Snapshot) {
+    LockedControlTable test;
+
+    test.set(LockedControlTable::FIELD, uint32_t{0x11223344});
+    uint8_t buf[4];
+    EXPECT_EQ(test.readSnapshot(LockedControlTable::FIELD, LEN(buf), buf), bioloid::Error::NONE);
+    EXPECT_EQ(buf[0], 0x44);
+    EXPECT_EQ(buf[3], 0x11);
+
+    EXPECT_EQ(test.readSnapshot(LockedControlTable::NUM_CTL_BYTES - 1, LEN(buf), buf),
+              bioloid::Error::RANGE);
+}
+
+TEST(SeqLockTest, NoTornReads) {
+    LockedControlTable test;
+
+    // The writer stores values whose bytes are all the same, so a torn read would
+    // show up as a value with differing bytes.
+    std::atomic<bool> done{false};
+    std::thread writer([&test, &done]() {
+        for (uint32_t i = 0; i < 200'000; i++) {
+            uint32_t byte = i & 0xff;
+            test.set(LockedControlTable::FIELD, byte * 0x01010101u);
+        }
+        done = true;
+    });
+
+    uint32_t numTorn = 0;
+    while (!done) {
+        uint8_t buf[4];
+        test.readSnapshot(LockedControlTable::FIELD, LEN(buf), buf);
+        if (buf[0] != buf[1] || buf[0] != buf[2] || buf[0] != buf[3]) {
+            numTorn++;
+        }
+    }
+    writer.join();
+    EXPECT_EQ(numTorn, 0u);
+}
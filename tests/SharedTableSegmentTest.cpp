@@ -0,0 +1,98 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   SharedTableSegmentTest.cpp
+ *
+ *   @brief  Tests exporting a control table using POSIX shared memory.
+ *
+ ****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+
+#include "ControlTable.h"
+#include "SharedTableSegment.h"
+#include "TestUtil.h"
+#include "Util.h"
+
+//! Convenience aliases
+//! @{
+using Error = bioloid::Error;
+using SharedTableSegment = bioloid::SharedTableSegment;
+//! @}
+
+//! @brief Control table whose bytes are stored externally.
+class ExternalControlTable : public bioloid::IControlTable {
+ public:
+    //! @brief Total number of bytes in the control table.
+    static constexpr uint8_t NUM_CTL_BYTES = 0x20;
+
+    ExternalControlTable(uint8_t* ctlBytes)
+        : IControlTable(NUM_CTL_BYTES, 0x10, ctlBytes, this->m_storage, &this->m_port) {
+        this->setToInitialValues();
+    }
+
+ private:
+    NullStorage m_storage;
+    TestPort m_port;
+};
+
+using Offset = ExternalControlTable::Offset;  //!< Convenience alias
+
+//! @brief Returns a segment name which is unique to this process.
+//! @returns the name of the segment.
+static const char* segmentName() {
+    static char name[32];
+    snprintf(name, sizeof(name), "/bioloid-test.%d", static_cast<int>(getpid()));
+    return name;
+}
+
+TEST(SharedTableSegmentTest, Export) {
+    SharedTableSegment writer;
+    ASSERT_TRUE(writer.create(segmentName(), ExternalControlTable::NUM_CTL_BYTES));
+    ExternalControlTable ctlTable{writer.ctlBytes()};
+    ctlTable.seqLock(writer.seqLock());
+
+    SharedTableSegment reader;
+    ASSERT_TRUE(reader.open(segmentName()));
+    EXPECT_EQ(reader.numBytes(), ExternalControlTable::NUM_CTL_BYTES);
+    EXPECT_EQ(reader.ctlBytes(), nullptr);
+    EXPECT_EQ(reader.seqLock(), nullptr);
+
+    uint8_t id;
+    EXPECT_EQ(reader.read(Offset::ID, 1, &id), Error::NONE);
+    EXPECT_EQ(id, ExternalControlTable::DEFAULT_DEVICE_ID);
+
+    // Modifications are visible through the reader's mapping.
+    uint32_t sequence = reader.sequence();
+    ctlTable.set(Offset::LED, uint8_t{1});
+    EXPECT_NE(reader.sequence(), sequence);
+    uint8_t led;
+    EXPECT_EQ(reader.read(Offset::LED, 1, &led), Error::NONE);
+    EXPECT_EQ(led, 1);
+
+    uint8_t data[2];
+    EXPECT_EQ(reader.read(ExternalControlTable::NUM_CTL_BYTES - 1, 2, data), Error::RANGE);
+}
+
+TEST(SharedTableSegmentTest, Remove) {
+    SharedTableSegment reader;
+    {
+        SharedTableSegment writer;
+        ASSERT_TRUE(writer.create(segmentName(), 8));
+    }
+    // The segment is removed when the object which created it is destroyed.
+    EXPECT_FALSE(reader.open(segmentName()));
+    EXPECT_FALSE(reader.isOpen());
+}
@@ -0,0 +1,50 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   TestUtil.h
+ *
+ *   @brief  Port and storage shared by the control table tests.
+ *
+ ****************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+
+#include "ControlTable.h"
+#include "Packet.h"
+#include "Port.h"
+
+//! @brief Test port for testing the control table.
+class TestPort : public bioloid::IPort {
+    uint8_t available() override { return 0; }
+
+    uint8_t readByte() override { return 0xff; }
+
+    void writePacket(bioloid::Packet const& pkt) override { (void)pkt; }
+};
+
+//! @brief Storage which never persists anything.
+class NullStorage : public bioloid::IControlTableStorage {
+ public:
+    Error load(OffsetType offset, SizeType numBytes, void* data) override {
+        (void)offset;
+        (void)numBytes;
+        (void)data;
+        return Error::FAILED;
+    }
+
+    Error save(OffsetType offset, SizeType numBytes, const void* data) override {
+        (void)offset;
+        (void)numBytes;
+        (void)data;
+        return Error::NONE;
+    }
+};
@@ -0,0 +1,93 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   TypedControlTableTest.cpp
+ *
+ *   @brief  Tests the typed control table.
+ *
+ ****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+#include "TestUtil.h"
+#include "TypedControlTable.h"
+#include "Util.h"
+
+//! @brief Layout of the control table used for testing.
+struct ServoSchema {
+    static constexpr uint8_t NUM_CTL_BYTES = 0x32;         //!< Total number of bytes.
+    static constexpr uint8_t NUM_PERSISTENT_BYTES = 0x18;  //!< Number of persistent bytes.
+
+    //! @brief Fields within the control table.
+    struct Fields {
+        struct ID : bioloid::Field<0x03, uint8_t> {};             //!< Device ID
+        struct CwAngleLimit : bioloid::Field<0x06, uint16_t> {};  //!< CW angle limit
+        struct Trim : bioloid::Field<0x08, int16_t> {};           //!< Signed trim
+        struct Serial : bioloid::Field<0x0C, uint32_t> {};        //!< Serial number
+        struct GoalPosition : bioloid::Field<0x1E, uint16_t> {};  //!< Goal position
+    };
+};
+
+using Fields = ServoSchema::Fields;                            //!< Convenience alias
+using ServoControlTable = bioloid::ControlTable<ServoSchema>;  //!< Convenience alias
+
+TEST(TypedControlTableTest, GetSet) {
+    NullStorage storage;
+    TestPort port;
+    ServoControlTable test(storage, &port);
+    test.setToInitialValues();
+
+    test.set<Fields::GoalPosition>(0x1234);
+    test.set<Fields::Trim>(-2);
+    test.set<Fields::Serial>(0x11223344);
+
+    EXPECT_EQ(test.get<Fields::GoalPosition>(), 0x1234);
+    EXPECT_EQ(test.get<Fields::Trim>(), -2);
+    EXPECT_EQ(test.get<Fields::Serial>(), 0x11223344u);
+    EXPECT_EQ(test.get<Fields::ID>(), ServoControlTable::DEFAULT_DEVICE_ID);
+}
+
+TEST(TypedControlTableTest, SameLayoutAsIControlTable) {
+    NullStorage storage;
+    TestPort port;
+    ServoControlTable test(storage, &port);
+    test.setToInitialValues();
+
+    // Values set through the typed interface are seen by the IControlTable interface,
+    // which stores data in little endian order.
+    test.set<Fields::GoalPosition>(0x1234);
+    bioloid::IControlTable& ctlTable = test;
+    EXPECT_EQ(ctlTable.get_u16(Fields::GoalPosition::OFFSET), 0x1234);
+    EXPECT_EQ(ctlTable.ctlBytes()[Fields::GoalPosition::OFFSET], 0x34);
+
+    test.set(Fields::CwAngleLimit::OFFSET, uint16_t{0x3ff});
+    EXPECT_EQ(test.get<Fields::CwAngleLimit>(), 0x3ff);
+
+    uint8_t data[] = {0x07};
+    EXPECT_EQ(ctlTable.write(Fields::ID::OFFSET, data, LEN(data)), bioloid::Error::NONE);
+    EXPECT_EQ(test.get<Fields::ID>(), 0x07);
+}
+
+TEST(TypedControlTableTest, SetDoesBookkeeping) {
+    NullStorage storage;
+    TestPort port;
+    ServoControlTable test(storage, &port);
+    test.load();
+    EXPECT_EQ(test.save(), bioloid::IControlTableStorage::Error::NONE);
+    EXPECT_FALSE(test.isDirty());
+
+    // Persistent fields are marked dirty, volatile ones aren't.
+    test.set<Fields::GoalPosition>(0x100);
+    EXPECT_FALSE(test.isDirty());
+    test.set<Fields::CwAngleLimit>(0x100);
+    EXPECT_TRUE(test.isDirty());
+}
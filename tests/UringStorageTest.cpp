@@ -0,0 +1,172 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   UringStorageTest.cpp
+ *
+ *   @brief  Tests saving control tables asynchronously using io_uring.
+ *
+ ****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "ControlTable.h"
+#include "TestUtil.h"
+#include "UringStorage.h"
+#include "Util.h"
+
+//! Convenience aliases
+//! @{
+using Error = bioloid::IControlTableStorage::Error;
+using UringFileStorage = bioloid::UringFileStorage;
+using UringQueue = bioloid::UringQueue;
+//! @}
+
+//! @brief Control table saved using a UringQueue.
+class UringControlTable : public bioloid::IControlTable {
+ public:
+    static constexpr uint8_t NUM_CTL_BYTES = 0x20;         //!< Number of control bytes.
+    static constexpr uint8_t NUM_PERSISTENT_BYTES = 0x18;  //!< Number of persistent bytes.
+
+    UringControlTable(UringQueue& queue, const char* fileName, bool sync = false)
+        : IControlTable(
+              NUM_CTL_BYTES, NUM_PERSISTENT_BYTES, this->m_ctlBytes, this->storage,
+              &this->m_port),
+          storage{queue, fileName, NUM_PERSISTENT_BYTES, this->m_image, sync} {}
+
+    UringFileStorage storage;  //!< Storage for the control table.
+
+ private:
+    uint8_t m_ctlBytes[NUM_CTL_BYTES];
+    uint8_t m_image[NUM_PERSISTENT_BYTES];
+    TestPort m_port;
+};
+
+using Offset = UringControlTable::Offset;  //!< Convenience alias
+
+//! @brief Counts the completed saves.
+class CountingObserver : public bioloid::IAsyncSaveObserver {
+ public:
+    void saveCompleted(UringFileStorage& storage, Error error) override {
+        (void)storage;
+        if (error == Error::NONE) {
+            this->numSaved++;
+        } else {
+            this->numFailed++;
+        }
+    }
+
+    size_t numSaved = 0;   //!< Number of saves which succeeded.
+    size_t numFailed = 0;  //!< Number of saves which failed.
+};
+
+static constexpr size_t NUM_DEVICES = 32;  //!< Number of devices saved together.
+
+//! @brief Tests the queue, both with and without io_uring.
+class UringStorageTest : public ::testing::TestWithParam<bool> {
+ protected:
+    //! @brief Returns the name of the file used by a device.
+    //! @returns the file name.
+    const char* fileName(size_t device) {
+        snprintf(this->m_fileNames[device], sizeof(this->m_fileNames[device]),
+                 "UringStorageTest-%zu.ctl", device);
+        return this->m_fileNames[device];
+    }
+
+    void TearDown() override {
+        for (size_t device = 0; device < NUM_DEVICES; device++) {
+            remove(this->fileName(device));
+        }
+    }
+
+    CountingObserver m_observer;
+    UringQueue m_queue{64, &this->m_observer, GetParam()};
+
+ private:
+    char m_fileNames[NUM_DEVICES][32];
+};
+
+TEST_P(UringStorageTest, Batch) {
+    // The fallback is only expected if io_uring isn't wanted, or the kernel doesn't allow it.
+    if (GetParam() && !this->m_queue.isAsync()) {
+        GTEST_SKIP() << "io_uring isn't available";
+    }
+    for (size_t device = 0; device < NUM_DEVICES; device++) {
+        remove(this->fileName(device));
+    }
+    {
+        std::vector<std::unique_ptr<UringControlTable>> tables;
+        for (size_t device = 0; device < NUM_DEVICES; device++) {
+            tables.emplace_back(new UringControlTable{this->m_queue, this->fileName(device)});
+            tables.back()->load();
+            tables.back()->set(Offset::ID, static_cast<uint8_t>(device));
+            EXPECT_EQ(tables.back()->save(), Error::NONE);
+            EXPECT_TRUE(tables.back()->storage.isBusy());
+        }
+
+        // All of the saves are submitted together.
+        EXPECT_EQ(this->m_queue.submit(), NUM_DEVICES);
+        if (this->m_queue.isAsync()) {
+            EXPECT_EQ(this->m_queue.stats().numSyscalls, 1u);
+        } else {
+            EXPECT_EQ(this->m_queue.stats().numSyscalls, NUM_DEVICES);
+        }
+        while (this->m_queue.numInFlight() > 0) {
+            this->m_queue.complete(true);
+        }
+        EXPECT_EQ(this->m_observer.numSaved, NUM_DEVICES);
+        EXPECT_EQ(this->m_observer.numFailed, 0u);
+
+        for (const auto& table : tables) {
+            EXPECT_FALSE(table->storage.isBusy());
+        }
+    }
+
+    for (size_t device = 0; device < NUM_DEVICES; device++) {
+        UringControlTable test{this->m_queue, this->fileName(device)};
+        test.load();
+        EXPECT_EQ(test.get_u8(Offset::ID), device);
+    }
+}
+
+TEST_P(UringStorageTest, SaveWhileInFlight) {
+    remove(this->fileName(0));
+    UringControlTable test{this->m_queue, this->fileName(0), true};
+    test.load();
+    EXPECT_EQ(test.save(), Error::NONE);
+    EXPECT_EQ(this->m_queue.submit(), 1u);
+
+    // The second save is queued once the first one completes.
+    test.set(Offset::ID, uint8_t{9});
+    EXPECT_EQ(test.save(), Error::NONE);
+    EXPECT_TRUE(test.storage.isBusy());
+    this->m_queue.flush();
+    EXPECT_FALSE(test.storage.isBusy());
+    EXPECT_EQ(this->m_queue.stats().numSaves, 2u);
+    EXPECT_EQ(this->m_observer.numSaved, 2u);
+
+    UringControlTable reload{this->m_queue, this->fileName(0)};
+    reload.load();
+    EXPECT_EQ(reload.get_u8(Offset::ID), 9);
+}
+
+TEST_P(UringStorageTest, OpenFailure) {
+    UringControlTable test{this->m_queue, "no-such-dir/UringStorageTest.ctl"};
+    test.load();
+    EXPECT_EQ(test.save(), Error::FAILED);
+    EXPECT_TRUE(test.isDirty());
+    EXPECT_FALSE(test.storage.isBusy());
+}
+
+INSTANTIATE_TEST_SUITE_P(Uring, UringStorageTest, ::testing::Values(true, false));
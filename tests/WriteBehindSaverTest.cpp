@@ -0,0 +1,168 @@
+/****************************************************************************
+ *
+ *   @copyright Copyright (c) 2024 Dave Hylands     <dhylands@gmail.com>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the MIT License version as described in the
+ *   LICENSE file in the root of this repository.
+ *
+ ****************************************************************************/
+/**
+ *   @file   WriteBehindSaverTest.cpp
+ *
+ *   @brief  Tests the write-behind control table saver.
+ *
+ ****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#include "ControlTable.h"
+#include "TestUtil.h"
+#include "WriteBehindSaver.h"
+
+//! Convenience aliases
+//! @{
+using WriteBehindSaver = bioloid::WriteBehindSaver;
+using milliseconds = std::chrono::milliseconds;
+//! @}
+
+//! @brief Storage which counts the number of bytes saved.
+class CountingStorage : public bioloid::IControlTableStorage {
+ public:
+    Error load(OffsetType offset, SizeType numBytes, void* data) override {
+        (void)offset;
+        memset(data, 0, numBytes);
+        return Error::NONE;
+    }
+
+    Error save(OffsetType offset, SizeType numBytes, const void* data) override {
+        (void)offset;
+        (void)data;
+        this->numCalls++;
+        this->numBytesSaved += numBytes;
+        return Error::NONE;
+    }
+
+    std::atomic<uint32_t> numCalls{0};       //!< Number of times save was called.
+    std::atomic<uint32_t> numBytesSaved{0};  //!< Total number of bytes saved.
+};
+
+//! @brief Control table which uses CountingStorage.
+class CountingControlTable : public bioloid::IControlTable {
+ public:
+    //! @brief Total number of bytes in the control table.
+    static constexpr uint8_t NUM_CTL_BYTES = 0x20;
+
+    //! @brief Number of bytes which are persisted.
+    static constexpr uint8_t NUM_PERSISTENT_BYTES = 0x10;
+
+    CountingControlTable()
+        : IControlTable(
+              NUM_CTL_BYTES,
+              NUM_PERSISTENT_BYTES,
+              this->m_ctlBytes,
+              this->storage,
+              &this->m_port) {
+        this->load();
+    }
+
+    CountingStorage storage;  //!< Storage which counts saves.
+
+ private:
+    uint8_t m_ctlBytes[NUM_CTL_BYTES];
+    TestPort m_port;
+};
+
+//! @brief Waits for the saver to save the control table.
+//! @returns true if the control table was saved before the timeout.
+static bool waitForSaves(
+    WriteBehindSaver& saver,  //!< [in] Saver to wait for.
+    uint32_t numSaves,        //!< [in] Number of saves to wait for.
+    milliseconds timeout      //!< [in] Maximum time to wait.
+) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (saver.numSaves() < numSaves) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(milliseconds(1));
+    }
+    return true;
+}
+
+TEST(WriteBehindSaverTest, BurstIsCoalesced) {
+    CountingControlTable table;
+    WriteBehindSaver saver(table, {milliseconds(50), milliseconds(5000)});
+
+    for (uint8_t i = 0; i < 20; i++) {
+        std::lock_guard<std::mutex> lock(saver.tableMutex());
+        table.set(0x06, i);
+        table.set(0x08, i);
+    }
+    ASSERT_TRUE(waitForSaves(saver, 1, milliseconds(2000)));
+    EXPECT_FALSE(table.isDirty());
+
+    // Both fields are saved, but each only once.
+    EXPECT_EQ(table.storage.numCalls, 2u);
+    EXPECT_EQ(saver.numSaves(), 1u);
+}
+
+TEST(WriteBehindSaverTest, MaxDelay) {
+    CountingControlTable table;
+    WriteBehindSaver saver(table, {milliseconds(1000), milliseconds(20)});
+
+    // Keep modifying the table more often than the quiet period. The maximum delay
+    // forces a save anyways.
+    auto deadline = std::chrono::steady_clock::now() + milliseconds(2000);
+    while (saver.numSaves() == 0 && std::chrono::steady_clock::now() < deadline) {
+        {
+            std::lock_guard<std::mutex> lock(saver.tableMutex());
+            table.set(0x06, uint8_t{1});
+        }
+        std::this_thread::sleep_for(milliseconds(2));
+    }
+    EXPECT_GE(saver.numSaves(), 1u);
+}
+
+TEST(WriteBehindSaverTest, VolatileDoesNotSave) {
+    CountingControlTable table;
+    WriteBehindSaver saver(table, {milliseconds(1), milliseconds(1)});
+
+    {
+        std::lock_guard<std::mutex> lock(saver.tableMutex());
+        table.set(CountingControlTable::NUM_PERSISTENT_BYTES, uint8_t{1});
+    }
+    std::this_thread::sleep_for(milliseconds(20));
+    EXPECT_EQ(saver.numSaves(), 0u);
+}
+
+TEST(WriteBehindSaverTest, Flush) {
+    CountingControlTable table;
+    WriteBehindSaver saver(table, {milliseconds(5000), milliseconds(5000)});
+
+    {
+        std::lock_guard<std::mutex> lock(saver.tableMutex());
+        table.set(0x06, uint16_t{0x1234});
+    }
+    EXPECT_EQ(table.storage.numCalls, 0u);
+    EXPECT_EQ(saver.flush(), bioloid::IControlTableStorage::Error::NONE);
+    EXPECT_EQ(table.storage.numCalls, 1u);
+    EXPECT_EQ(table.storage.numBytesSaved, 2u);
+    EXPECT_FALSE(table.isDirty());
+}
+
+TEST(WriteBehindSaverTest, SavedAtShutdown) {
+    CountingControlTable table;
+    {
+        WriteBehindSaver saver(table, {milliseconds(5000), milliseconds(5000)});
+        std::lock_guard<std::mutex> lock(saver.tableMutex());
+        table.set(0x06, uint8_t{1});
+    }
+    EXPECT_EQ(table.storage.numCalls, 1u);
+    EXPECT_FALSE(table.isDirty());
+}
@@ -1,7 +1,29 @@
 # Note: DeathTest.cpp comes from DuinoUtil/tests
 
 TEST_SOURCES_CPP += \
+	AccessHeatmapTest.cpp \
+	ChangeJournalTest.cpp \
+	ColumnStoreTest.cpp \
+	ContainerStorageTest.cpp \
+	ControlTableDiffTest.cpp \
+	ControlTableObserversTest.cpp \
+	ControlTableSchemaTest.cpp \
 	ControlTableTest.cpp \
+	Crc32Test.cpp \
 	DeathTest.cpp \
+	DeviceTest.cpp \
+	FieldCacheTest.cpp \
 	FileStorageTest.cpp \
-	PacketTest.cpp
+	FlashSimStorageTest.cpp \
+	IndirectMapTest.cpp \
+	LayoutMigrationTest.cpp \
+	LogFileStorageTest.cpp \
+	MappedFileStorageTest.cpp \
+	PacketTest.cpp \
+	RedundantStorageTest.cpp \
+	SafeFileStorageTest.cpp \
+	SeqLockTest.cpp \
+	SharedTableSegmentTest.cpp \
+	TypedControlTableTest.cpp \
+	UringStorageTest.cpp \
+	WriteBehindSaverTest.cpp